@@ -4,6 +4,7 @@
    Distributed under the MIT License (https://opensource.org/licenses/MIT)
 =============================================================================*/
 #include "app.hpp"
+#include <vector>
 
 using namespace cycfi::artist;
 using cycfi::is_little_endian;
@@ -25,13 +26,12 @@ auto constexpr window_size = extent{
    static_cast<float>(rows * square_side)
 };
 
-void draw(canvas& cnv)
+std::vector<uint32_t> make_board()
 {
-   // Create a chess board
-   std::unique_ptr<uint32_t> pix_buf(new uint32_t[pix_buf_size]);
+   std::vector<uint32_t> pix_buf(pix_buf_size);
    for (int y = 0; y < rows; y++)
    {
-      uint32_t* row_slice = &(pix_buf.get()[y * rows * square_area]);
+      uint32_t* row_slice = &pix_buf[y * rows * square_area];
       uint32_t color = black();
       if (y % 2 != 0)
          color = white;
@@ -48,8 +48,16 @@ void draw(canvas& cnv)
          row_slice[x] = color;
       }
    }
+   return pix_buf;
+}
 
-   auto img = make_image<pixel_format::rgba32>(pix_buf.get(), {window_size.x, window_size.y});
+void draw(canvas& cnv)
+{
+   // Create a chess board, once. The image uses the board's pixels
+   // directly, so there is no copy per draw.
+   static auto pix_buf = make_board();
+   static auto img = make_image<pixel_format::rgba32>(
+      pix_buf.data(), {window_size.x, window_size.y}, 0);
    cnv.draw(img);
 }
 
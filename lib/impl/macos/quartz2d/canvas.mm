@@ -4,8 +4,15 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <artist/canvas.hpp>
+#include <artist/colormap.hpp>
+#include <artist/raster_cache.hpp>
+#include <artist/surface_pool.hpp>
+#include <artist/text_cache.hpp>
 #include <Quartz/Quartz.h>
+#include <algorithm>
+#include <cstring>
 #include <stack>
+#include <stdexcept>
 #include <variant>
 #include "osx_utils.hpp"
 
@@ -47,11 +54,23 @@ namespace cycfi::artist
       mode_enum         mode() const;
       void              mode(mode_enum mode_);
 
+      float             alpha() const                    { return current()->_alpha; }
+      void              alpha(float alpha_)              { current()->_alpha = alpha_; }
+
+      using sampling_enum = canvas::image_sampling_enum;
+
+      sampling_enum     image_sampling() const           { return current()->_image_sampling; }
+      void              image_sampling(sampling_enum mode_) { current()->_image_sampling = mode_; }
+
       using fill_rule_enum = path::fill_rule_enum;
 
       fill_rule_enum    fill_rule() const                { return _fill_rule; }
       void              fill_rule(fill_rule_enum rule)   { _fill_rule = rule; }
 
+      // Whether the current state began a transparency layer
+      bool              layer() const                    { return current()->_layer; }
+      void              layer(bool layer_)               { current()->_layer = layer_; }
+
       void              save();
       void              restore();
       float             scale() const                    { return _scale; }
@@ -73,6 +92,9 @@ namespace cycfi::artist
          class font     _font             = font_descr{"Helvetica Neue", 12};
          int            _text_align       = canvas::baseline;
          mode_enum      _mode             = source_over;
+         float          _alpha            = 1.0f;
+         sampling_enum  _image_sampling   = nearest;
+         bool           _layer            = false;
       };
 
       using state_info_ptr = std::unique_ptr<state_info>;
@@ -301,6 +323,47 @@ namespace cycfi::artist
       CGContextConcatCTM(ctx, {a, b, c, d, tx, ty});
    }
 
+   namespace
+   {
+      CGBlendMode to_cg_blend_mode(canvas::composite_op_enum mode)
+      {
+         CGBlendMode cg_mode;
+         switch (mode)
+         {
+            case canvas::source_over:          cg_mode = kCGBlendModeNormal; break;
+            case canvas::source_atop:          cg_mode = kCGBlendModeSourceAtop; break;
+            case canvas::source_in:            cg_mode = kCGBlendModeSourceIn; break;
+            case canvas::source_out:           cg_mode = kCGBlendModeSourceOut; break;
+
+            case canvas::destination_over:     cg_mode = kCGBlendModeDestinationOver; break;
+            case canvas::destination_atop:     cg_mode = kCGBlendModeDestinationAtop; break;
+            case canvas::destination_in:       cg_mode = kCGBlendModeDestinationIn; break;
+            case canvas::destination_out:      cg_mode = kCGBlendModeDestinationOut; break;
+
+            case canvas::lighter:              cg_mode = kCGBlendModePlusLighter; break;
+            case canvas::darker:               cg_mode = kCGBlendModePlusDarker; break;
+            case canvas::copy:                 cg_mode = kCGBlendModeCopy; break;
+            case canvas::xor_:                 cg_mode = kCGBlendModeXOR; break;
+
+            case canvas::difference:           cg_mode = kCGBlendModeDifference; break;
+            case canvas::exclusion:            cg_mode = kCGBlendModeExclusion; break;
+            case canvas::multiply:             cg_mode = kCGBlendModeMultiply; break;
+            case canvas::screen:               cg_mode = kCGBlendModeScreen; break;
+
+            case canvas::color_dodge:          cg_mode = kCGBlendModeColorDodge; break;
+            case canvas::color_burn:           cg_mode = kCGBlendModeColorBurn; break;
+            case canvas::soft_light:           cg_mode = kCGBlendModeSoftLight; break;
+            case canvas::hard_light:           cg_mode = kCGBlendModeHardLight; break;
+
+            case canvas::hue:                  cg_mode = kCGBlendModeHue; break;
+            case canvas::saturation:           cg_mode = kCGBlendModeSaturation; break;
+            case canvas::color_op:             cg_mode = kCGBlendModeColor; break;
+            case canvas::luminosity:           cg_mode = kCGBlendModeLuminosity; break;
+         };
+         return cg_mode;
+      }
+   }
+
    void canvas::save()
    {
       CGContextSaveGState(CGContextRef(_context));
@@ -313,6 +376,42 @@ namespace cycfi::artist
       _state->restore();
    }
 
+   void canvas::begin_layer(rect const& bounds, float opacity, composite_op_enum mode)
+   {
+      auto ctx = CGContextRef(_context);
+      auto bounds_ = CGRectMake(bounds.left, bounds.top, bounds.width(), bounds.height());
+      opacity = std::clamp(opacity, 0.0f, 1.0f);
+      CGContextSaveGState(ctx);
+      _state->save();
+      CGContextClipToRect(ctx, bounds_);
+      if (mode == source_over && opacity == 1.0f)
+      {
+         // Drawing directly looks the same, without the layer's allocation
+         _state->layer(false);
+         return;
+      }
+
+      // The layer is composited with the alpha and blend mode in effect
+      // when it begins. Within the layer, drawing goes on with the state's
+      // global alpha and composite operation, as on Skia, where these are
+      // part of the paint.
+      CGContextSetAlpha(ctx, opacity);
+      CGContextSetBlendMode(ctx, to_cg_blend_mode(mode));
+      CGContextBeginTransparencyLayerWithRect(ctx, bounds_, nullptr);
+      CGContextSetAlpha(ctx, _state->alpha());
+      CGContextSetBlendMode(ctx, to_cg_blend_mode(_state->mode()));
+      _state->layer(true);
+   }
+
+   void canvas::end_layer()
+   {
+      auto ctx = CGContextRef(_context);
+      if (_state->layer())
+         CGContextEndTransparencyLayer(ctx);
+      CGContextRestoreGState(ctx);
+      _state->restore();
+   }
+
    void canvas::begin_path()
    {
       CGContextBeginPath(CGContextRef(_context));
@@ -470,6 +569,22 @@ namespace cycfi::artist
       CGPathRelease(save);
    }
 
+   void canvas::clip(region const& r)
+   {
+      auto ctx = CGContextRef(_context);
+      if (r.is_empty())
+      {
+         CGContextClipToRect(ctx, CGRectZero);
+         return;
+      }
+
+      std::vector<CGRect> rects;
+      rects.reserve(r.size());
+      for (auto const& i : r)
+         rects.push_back(CGRectMake(i.left, i.top, i.width(), i.height()));
+      CGContextClipToRects(ctx, rects.data(), rects.size());
+   }
+
    bool canvas::point_in_path(point p) const
    {
       auto mode = _state->fill_rule() == path::fill_winding?
@@ -624,43 +739,22 @@ namespace cycfi::artist
    void canvas::global_composite_operation(composite_op_enum mode)
    {
       _state->mode(mode);
-      CGBlendMode cg_mode;
-      switch (mode)
-      {
-         case source_over:          cg_mode = kCGBlendModeNormal; break;
-         case source_atop:          cg_mode = kCGBlendModeSourceAtop; break;
-         case source_in:            cg_mode = kCGBlendModeSourceIn; break;
-         case source_out:           cg_mode = kCGBlendModeSourceOut; break;
-
-         case destination_over:     cg_mode = kCGBlendModeDestinationOver; break;
-         case destination_atop:     cg_mode = kCGBlendModeDestinationAtop; break;
-         case destination_in:       cg_mode = kCGBlendModeDestinationIn; break;
-         case destination_out:      cg_mode = kCGBlendModeDestinationOut; break;
-
-         case lighter:              cg_mode = kCGBlendModePlusLighter; break;
-         case darker:               cg_mode = kCGBlendModePlusDarker; break;
-         case copy:                 cg_mode = kCGBlendModeCopy; break;
-         case xor_:                 cg_mode = kCGBlendModeXOR; break;
-
-         case difference:           cg_mode = kCGBlendModeDifference; break;
-         case exclusion:            cg_mode = kCGBlendModeExclusion; break;
-         case multiply:             cg_mode = kCGBlendModeMultiply; break;
-         case screen:               cg_mode = kCGBlendModeScreen; break;
-
-         case color_dodge:          cg_mode = kCGBlendModeColorDodge; break;
-         case color_burn:           cg_mode = kCGBlendModeColorBurn; break;
-         case soft_light:           cg_mode = kCGBlendModeSoftLight; break;
-         case hard_light:           cg_mode = kCGBlendModeHardLight; break;
-
-         case canvas::hue:          cg_mode = kCGBlendModeHue; break;
-         case canvas::saturation:   cg_mode = kCGBlendModeSaturation; break;
-         case canvas::color_op:     cg_mode = kCGBlendModeColor; break;
-         case canvas::luminosity:   cg_mode = kCGBlendModeLuminosity; break;
-
-      };
+      auto cg_mode = to_cg_blend_mode(mode);
       CGContextSetBlendMode(CGContextRef(_context), cg_mode);
    }
 
+   void canvas::global_alpha(float alpha)
+   {
+      alpha = std::clamp(alpha, 0.0f, 1.0f);
+      _state->alpha(alpha);
+      CGContextSetAlpha(CGContextRef(_context), alpha);
+   }
+
+   float canvas::global_alpha() const
+   {
+      return _state->alpha();
+   }
+
    void canvas::fill_style(linear_gradient const& gr)
    {
       _state->fill_style(gr, gr.color_space);
@@ -681,6 +775,36 @@ namespace cycfi::artist
       _state->stroke_style(gr, gr.color_space);
    }
 
+   namespace
+   {
+      // Quartz has no 1D texture shader, so we sample the colormap into
+      // gradient stops. CGGradient interpolates linearly between them, and
+      // 256 stops are as many as an 8-bit per channel table can tell apart.
+      canvas::linear_gradient colormap_gradient(
+         colormap const& cmap, point start, point end)
+      {
+         constexpr int num_stops = 256;
+         canvas::linear_gradient gr{start, end};
+         gr.color_space.reserve(num_stops);
+         for (int i = 0; i != num_stops; ++i)
+         {
+            auto offset = float(i) / (num_stops - 1);
+            gr.add_color_stop(offset, cmap(offset));
+         }
+         return gr;
+      }
+   }
+
+   void canvas::fill_style(colormap const& cmap, point start, point end)
+   {
+      fill_style(colormap_gradient(cmap, start, end));
+   }
+
+   void canvas::stroke_style(colormap const& cmap, point start, point end)
+   {
+      stroke_style(colormap_gradient(cmap, start, end));
+   }
+
    void canvas::font(class font const& font_)
    {
       if (font_)
@@ -689,13 +813,18 @@ namespace cycfi::artist
 
    namespace detail
    {
-      CTLineRef measure_text(
-         font const& font_
-       , char const* f, char const* l
-       , CGFloat& width, CGFloat& ascent, CGFloat& descent, CGFloat& leading
-      )
+      // A line of text, with its measurements (see text_cache)
+      struct shaped_line
+      {
+         std::shared_ptr<__CTLine const> line;
+         CGFloat        width;
+         CGFloat        ascent;
+         CGFloat        descent;
+         CGFloat        leading;
+      };
+
+      shaped_line shape_line(NSFont* font, char const* f, char const* l)
       {
-         NSFont* font = (__bridge NSFont*) font_.impl();
          CFStringRef keys[] = {kCTFontAttributeName, kCTForegroundColorFromContextAttributeName};
          CFTypeRef   values[] = {(__bridge const void*)font, kCFBooleanTrue};
 
@@ -711,11 +840,35 @@ namespace cycfi::artist
             CFAttributedStringCreate(kCFAllocatorDefault, text, font_attributes);
          CFRelease(text);
 
+         shaped_line shaped;
          auto line = CTLineCreateWithAttributedString(attr_string);
-         width = CTLineGetTypographicBounds(line, &ascent, &descent, &leading);
+         shaped.line = {line, [](CTLineRef line_) { CFRelease(line_); }};
+         shaped.width = CTLineGetTypographicBounds(
+            line, &shaped.ascent, &shaped.descent, &shaped.leading);
          CFRelease(attr_string);
          CFRelease(font_attributes);
-         return line;
+         return shaped;
+      }
+
+      // Returns the line, which the caller releases. The line retains its
+      // font, so the font's address identifies it while the line is cached.
+      CTLineRef measure_text(
+         font const& font_
+       , char const* f, char const* l
+       , CGFloat& width, CGFloat& ascent, CGFloat& descent, CGFloat& leading
+      )
+      {
+         NSFont* font = (__bridge NSFont*) font_.impl();
+         auto shaped = shaped_text<shaped_line>(
+            reinterpret_cast<std::uintptr_t>(font_.impl()), [font pointSize]
+          , std::string_view(f, l-f)
+          , [&]{ return shape_line(font, f, l); }
+         );
+         width = shaped->width;
+         ascent = shaped->ascent;
+         descent = shaped->descent;
+         leading = shaped->leading;
+         return (CTLineRef) CFRetain(shaped->line.get());
       }
 
       CTLineRef prepare_text(
@@ -985,6 +1138,18 @@ namespace cycfi::artist
          case canvas::luminosity:   ns_mode = NSCompositingOperationLuminosity; break;
       };
 
+      // Quartz keeps its own reduced copies of images for minified draws,
+      // so there is no separate mip chain to build here.
+      CGInterpolationQuality quality = kCGInterpolationNone;
+      switch (_state->image_sampling())
+      {
+         case nearest:        quality = kCGInterpolationNone; break;
+         case linear:         quality = kCGInterpolationLow; break;
+         case mipmap_linear:  quality = kCGInterpolationMedium; break;
+         case cubic:          quality = kCGInterpolationHigh; break;
+      }
+      CGContextSetInterpolationQuality(CGContextRef(_context), quality);
+
       [img drawInRect   :  dest_
          fromRect       :  src_
          operation      :  ns_mode
@@ -994,6 +1159,58 @@ namespace cycfi::artist
       ];
    }
 
+   void canvas::draw_atlas(
+      image const& pic
+    , rect const src[]
+    , affine_transform const xf[]
+    , color const tint[]
+    , std::size_t n
+   )
+   {
+      // Quartz has no batched sprite drawing, so the sprites are drawn one
+      // by one. Tinted sprites are drawn in a transparency layer: the tint
+      // is multiplied in, then masked back to the sprite's shape.
+      auto ctx = CGContextRef(_context);
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         auto const& m = xf[i];
+         auto sprite = rect{0, 0, src[i].width(), src[i].height()};
+
+         save();
+         CGContextConcatCTM(ctx, CGAffineTransform{m.a, m.b, m.c, m.d, m.tx, m.ty});
+         if (tint)
+         {
+            CGContextSetAlpha(ctx, tint[i].alpha * _state->alpha());
+            CGContextBeginTransparencyLayerWithRect(
+               ctx, CGRectMake(0, 0, sprite.width(), sprite.height()), nullptr);
+            CGContextSetAlpha(ctx, 1.0f);
+            global_composite_operation(source_over);
+            draw(pic, src[i], sprite);
+            global_composite_operation(multiply);
+            fill_style(tint[i].opacity(1.0f));
+            fill_rect(sprite);
+            global_composite_operation(destination_in);
+            draw(pic, src[i], sprite);
+            CGContextEndTransparencyLayer(ctx);
+         }
+         else
+         {
+            draw(pic, src[i], sprite);
+         }
+         restore();
+      }
+   }
+
+   void canvas::image_sampling(image_sampling_enum mode)
+   {
+      _state->image_sampling(mode);
+   }
+
+   canvas::image_sampling_enum canvas::image_sampling() const
+   {
+      return _state->image_sampling();
+   }
+
    void canvas::add_round_rect_impl(const rect& r, float radius)
    {
       if (radius > 0.0f)
@@ -1002,4 +1219,47 @@ namespace cycfi::artist
          add_rect(r);
    }
 
+   namespace detail
+   {
+      image rasterize(extent size, canvas::draw_function const& draw)
+      {
+         std::size_t width = size.x;
+         std::size_t height = size.y;
+         auto row_bytes = width * sizeof(std::uint32_t);
+         auto buf = new pooled_buffer{surface_pool::acquire(row_bytes * height)};
+         auto pixels = buf->data();
+         std::memset(pixels, 0, row_bytes * height);           // Transparent
+         auto img = make_image<pixel_format::rgba32_premul>(
+            reinterpret_cast<std::uint32_t*>(pixels), size, row_bytes
+          , [buf]{ delete buf; }
+         );
+
+         auto space = CGColorSpaceCreateDeviceRGB();
+         auto ctx = CGBitmapContextCreate(
+            pixels, width, height, 8, row_bytes, space
+          , kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedLast
+         );
+         CGColorSpaceRelease(space);
+         if (!ctx)
+            throw std::runtime_error{"Error: Failed to create the raster context."};
+
+         // Top-down, like the other canvases
+         CGContextTranslateCTM(ctx, 0, height);
+         CGContextScaleCTM(ctx, 1, -1);
+         try
+         {
+            canvas cnv{(canvas_impl*) ctx};
+            draw(cnv);
+         }
+         catch (...)
+         {
+            CGContextRelease(ctx);
+            throw;
+         }
+         CGContextRelease(ctx);
+         img.pixels_changed();
+         return img;
+      }
+   }
+
 }
@@ -4,7 +4,14 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <artist/image.hpp>
+#include <artist/image_memory.hpp>
+#include <artist/surface_pool.hpp>
 #include <Quartz/Quartz.h>
+#include <ImageIO/ImageIO.h>
+#include <objc/runtime.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <string>
 #include <stdexcept>
 
@@ -21,7 +28,20 @@ namespace cycfi::artist
          case pixel_format::rgb32:
             return {CGColorSpaceCreateDeviceRGB(), kCGBitmapByteOrderDefault | kCGImageAlphaNone, 4, 8, 32};
          case pixel_format::rgba32:
+         case pixel_format::rgba32_premul:
             return {CGColorSpaceCreateDeviceRGB(), kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedLast, 4, 8, 32};
+         case pixel_format::bgra32:
+            return {CGColorSpaceCreateDeviceRGB(), kCGBitmapByteOrder32Little | kCGImageAlphaFirst, 4, 8, 32};
+         case pixel_format::bgra32_premul:
+            return {CGColorSpaceCreateDeviceRGB(), kCGBitmapByteOrder32Little | kCGImageAlphaPremultipliedFirst, 4, 8, 32};
+         case pixel_format::alpha8:
+            return {nullptr, kCGImageAlphaOnly, 1, 8, 8};   // A mask (see create_image)
+         case pixel_format::rgba_f16:
+            return {
+               CGColorSpaceCreateWithName(kCGColorSpaceExtendedSRGB)
+             , kCGBitmapByteOrder16Little | kCGBitmapFloatComponents | kCGImageAlphaPremultipliedLast
+             , 8, 16, 64
+            };
          default:
             throw std::runtime_error("Unsupported image format");
       }
@@ -29,6 +49,44 @@ namespace cycfi::artist
 
    namespace
    {
+      // alpha8 has no colors, so it is made an image mask, drawn in the
+      // fill color, as on Skia. Mask samples are inverse alpha; the decode
+      // array turns them around. Returns NULL on failure.
+      CGImageRef create_image(
+         pixel_format fmt, extent size, size_t row_bytes, CGDataProviderRef provider)
+      {
+         auto [colorSpaceRef, bitmapInfo, componentsPerPixel, bitsPerComponent, bitsPerPixel] = _map_img_fmt_to_info(fmt);
+         CGImageRef iref;
+         if (fmt == pixel_format::alpha8)
+         {
+            CGFloat const decode[] = {1, 0};
+            iref = CGImageMaskCreate(size.x,
+                                     size.y,
+                                     bitsPerComponent,
+                                     bitsPerPixel,
+                                     row_bytes,
+                                     provider,
+                                     decode,
+                                     YES);
+         }
+         else
+         {
+            iref = CGImageCreate(size.x,
+                                 size.y,
+                                 bitsPerComponent,
+                                 bitsPerPixel,
+                                 row_bytes,
+                                 colorSpaceRef,
+                                 bitmapInfo,
+                                 provider,
+                                 NULL,
+                                 YES,
+                                 kCGRenderingIntentDefault);
+         }
+         CGColorSpaceRelease(colorSpaceRef);
+         return iref;
+      }
+
       NSBitmapImageRep* get_bitmap(NSImage* image)
       {
          for (NSImageRep* rep in [image representations])
@@ -37,26 +95,187 @@ namespace cycfi::artist
          return nullptr;
       }
 
-      uint32_t* get_pixels(NSImage* image)
+      std::uint8_t* get_bytes(NSImage* image)
       {
          if (auto bitmap = get_bitmap(image))
-            return (uint32_t*) [bitmap bitmapData];
+            return (std::uint8_t*) [bitmap bitmapData];
          return nullptr;
       }
+
+      // Quartz decodes and caches images on its own, so every image is
+      // counted as a bitmap of its size (see image_memory).
+      image_memory_stats memory_used(image_impl_ptr impl)
+      {
+         image_memory_stats stats;
+         if (impl)
+         {
+            auto size = [(__bridge NSImage*) impl size];
+            stats.images = 1;
+            stats.bitmap_bytes = size_t(size.width) * size_t(size.height) * 4;
+         }
+         return stats;
+      }
+   }
+
+   namespace
+   {
+      char pooled_pixels_key;
+
+      // A transparent, premultiplied rgba32 bitmap with its pixels borrowed
+      // from the surface_pool. They go back to the pool when the bitmap is
+      // freed. Returns nil on failure.
+      NSBitmapImageRep* make_pooled_bitmap(extent size)
+      {
+         std::size_t width = size.x;
+         std::size_t height = size.y;
+         if (width == 0 || height == 0)
+            return nil;
+
+         auto row_bytes = width * 4;
+         auto buf = new pooled_buffer{surface_pool::acquire(row_bytes * height)};
+         auto pixels = buf->data();
+         std::memset(pixels, 0, row_bytes * height);
+         auto rep = [[NSBitmapImageRep alloc]
+            initWithBitmapDataPlanes : &pixels
+                          pixelsWide : width
+                          pixelsHigh : height
+                       bitsPerSample : 8
+                     samplesPerPixel : 4
+                            hasAlpha : YES
+                            isPlanar : NO
+                      colorSpaceName : NSDeviceRGBColorSpace
+                        bitmapFormat : 0
+                         bytesPerRow : row_bytes
+                        bitsPerPixel : 32];
+         if (!rep)
+         {
+            delete buf;
+            return nil;
+         }
+
+         // The bitmap does not own its pixels: this does, for as long as
+         // the bitmap lives
+         auto owner = [NSData dataWithBytesNoCopy : pixels
+                                           length : buf->size()
+                                      deallocator : ^(void*, NSUInteger) { delete buf; }];
+         objc_setAssociatedObject(rep, &pooled_pixels_key, owner, OBJC_ASSOCIATION_RETAIN);
+         return rep;
+      }
+
+      // True if the bitmap was made by make_pooled_bitmap, or has the
+      // same layout, so it can be drawn into with a CGBitmapContext.
+      bool is_drawable(NSBitmapImageRep* bm)
+      {
+         return bm && [bm bitmapData]
+            && ![bm isPlanar]
+            && [bm bitsPerSample] == 8
+            && [bm samplesPerPixel] == 4
+            && [bm bitsPerPixel] == 32
+            && [bm bitmapFormat] == 0;
+      }
    }
 
    image::image(extent size)
    {
       auto img_ = [[NSImage alloc] initWithSize : NSMakeSize(size.x, size.y)];
+      if (auto rep = make_pooled_bitmap(size))
+         [img_ addRepresentation : rep];
       _impl = (__bridge_retained image_impl_ptr) img_;
+      detail::update_image_memory({}, memory_used(_impl));
    }
 
    image::image(fs::path const& path_)
    {
       auto fs_path = find_file(path_);
       auto path = [NSString stringWithUTF8String : fs_path.c_str() ];
-      auto img_ = [[NSImage alloc] initWithContentsOfFile : path];
+      auto data = [NSData dataWithContentsOfFile : path
+                                         options : NSDataReadingMappedIfSafe
+                                           error : nil];
+      // The mapped data is kept by the NSImage, which decodes lazily
+      auto img_ = data? [[NSImage alloc] initWithData : data] : nil;
       _impl = (__bridge_retained image_impl_ptr) img_;
+      detail::update_image_memory({}, memory_used(_impl));
+   }
+
+   namespace
+   {
+      CGImageSourceRef image_source(fs::path const& path_)
+      {
+         auto fs_path = find_file(path_);
+         auto url = [NSURL fileURLWithPath : [NSString stringWithUTF8String : fs_path.c_str()]];
+         auto source = CGImageSourceCreateWithURL((__bridge CFURLRef) url, nullptr);
+         if (!source)
+            throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+         return source;
+      }
+
+      image_impl_ptr make_image_impl(CGImageRef iref)
+      {
+         auto size = NSMakeSize(CGImageGetWidth(iref), CGImageGetHeight(iref));
+         auto img_ = [[NSImage alloc] initWithCGImage : iref size : size];
+         CGImageRelease(iref);
+         return (__bridge_retained image_impl_ptr) img_;
+      }
+   }
+
+   image::image(fs::path const& path_, extent target)
+   {
+      // ImageIO makes thumbnails by downsampling while decoding
+      auto source = image_source(path_);
+      auto props = (__bridge_transfer NSDictionary*)
+         CGImageSourceCopyPropertiesAtIndex(source, 0, nullptr);
+      float width = [props[(__bridge NSString*) kCGImagePropertyPixelWidth] floatValue];
+      float height = [props[(__bridge NSString*) kCGImagePropertyPixelHeight] floatValue];
+      if (width <= 0 || height <= 0)
+      {
+         CFRelease(source);
+         throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+      }
+
+      auto scale = std::min({target.x / width, target.y / height, 1.0f});
+      auto max_size = std::ceil(std::max(width, height) * scale);
+      NSDictionary* options = @{
+         (__bridge NSString*) kCGImageSourceCreateThumbnailFromImageAlways : @YES,
+         (__bridge NSString*) kCGImageSourceShouldCacheImmediately : @YES,
+         (__bridge NSString*) kCGImageSourceThumbnailMaxPixelSize : @(max_size)
+      };
+      auto iref = CGImageSourceCreateThumbnailAtIndex(
+         source, 0, (__bridge CFDictionaryRef) options);
+      CFRelease(source);
+      if (!iref)
+         throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+      _impl = make_image_impl(iref);
+      detail::update_image_memory({}, memory_used(_impl));
+   }
+
+   image::image(fs::path const& path_, rect subset)
+   {
+      // ImageIO has no subset decoding. The cropped image references the
+      // full image, which is decoded when it is first drawn.
+      auto source = image_source(path_);
+      auto full = CGImageSourceCreateImageAtIndex(source, 0, nullptr);
+      CFRelease(source);
+      if (!full)
+         throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+
+      auto iref = CGImageCreateWithImageInRect(
+         full, CGRectMake(subset.left, subset.top, subset.width(), subset.height()));
+      CGImageRelease(full);
+      if (!iref)
+         throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+      _impl = make_image_impl(iref);
+      detail::update_image_memory({}, memory_used(_impl));
+   }
+
+   image::image(uint8_t const* encoded, size_t size)
+   {
+      // NSImage decodes lazily and keeps the data, so we have to copy it
+      auto data = [NSData dataWithBytes : encoded length : size];
+      auto img_ = [[NSImage alloc] initWithData : data];
+      if (!img_)
+         throw std::runtime_error{"Error: Failed to decode image data"};
+      _impl = (__bridge_retained image_impl_ptr) img_;
+      detail::update_image_memory({}, memory_used(_impl));
    }
 
    image::image(uint8_t const* data, pixel_format fmt, extent size)
@@ -64,29 +283,78 @@ namespace cycfi::artist
       if (fmt == pixel_format::invalid)
          throw std::runtime_error{"Error: Cannot initalize format: INVALID"};
       auto [colorSpaceRef, bitmapInfo, componentsPerPixel, bitsPerComponent, bitsPerPixel] = _map_img_fmt_to_info(fmt);
-      size_t bufferLength = size.x * size.y * componentsPerPixel;
-      CGDataProviderRef provider = CGDataProviderCreateWithData(nullptr, data, bufferLength, nullptr);
-      size_t bytesPerRow = componentsPerPixel * size.x;
-      CGColorRenderingIntent renderingIntent = kCGRenderingIntentDefault;
-
-      CGImageRef iref = CGImageCreate(size.x,
-                                      size.y,
-                                      bitsPerComponent,
-                                      bitsPerPixel,
-                                      bytesPerRow,
-                                      colorSpaceRef,
-                                      bitmapInfo,
-                                      provider,
-                                      NULL,
-                                      YES,
-                                      renderingIntent);
+      CGColorSpaceRelease(colorSpaceRef);
+      size_t bytesPerRow = (bitsPerPixel / 8) * size_t(size.x);
+
+      // Copy the pixels, so that the caller's buffer is not needed later
+      auto copy = CFDataCreate(nullptr, data, bytesPerRow * size_t(size.y));
+      CGDataProviderRef provider = CGDataProviderCreateWithCFData(copy);
+      CFRelease(copy);
+
+      CGImageRef iref = create_image(fmt, size, bytesPerRow, provider);
+      CGDataProviderRelease(provider);
+      if (!iref)
+         throw std::runtime_error{"Error: Failed to initialize image from pixel buffer"};
+
+      auto img_ = [[NSImage alloc] initWithCGImage:iref size:NSMakeSize(size.x, size.y)];
+      CGImageRelease(iref);
+      _impl = (__bridge_retained image_impl_ptr) img_;
+      detail::update_image_memory({}, memory_used(_impl));
+   }
+
+   image::image(
+      uint8_t* data, pixel_format fmt, extent size
+    , size_t row_bytes, image_release_function release
+   )
+   {
+      // release is called when the pixels are no longer referenced, or
+      // right away if we fail.
+      auto context = release? new image_release_function(std::move(release)) : nullptr;
+      auto release_data = [](void* info, void const* /* data */, size_t /* size */)
+      {
+         if (auto f = static_cast<image_release_function*>(info))
+         {
+            (*f)();
+            delete f;
+         }
+      };
+
+      if (fmt == pixel_format::invalid)
+      {
+         release_data(context, data, 0);
+         throw std::runtime_error{"Error: Cannot initalize format: INVALID"};
+      }
+
+      auto [colorSpaceRef, bitmapInfo, componentsPerPixel, bitsPerComponent, bitsPerPixel] = _map_img_fmt_to_info(fmt);
+      CGColorSpaceRelease(colorSpaceRef);
+      auto min_row_bytes = (bitsPerPixel / 8) * size_t(size.x);
+      if (row_bytes == 0)
+         row_bytes = min_row_bytes;
+      if (row_bytes < min_row_bytes)
+      {
+         release_data(context, data, 0);
+         throw std::runtime_error{"Error: Failed to initialize image from pixel buffer"};
+      }
+
+      // The data provider uses the caller's pixels directly, without copying
+      CGDataProviderRef provider = CGDataProviderCreateWithData(
+         context, data, row_bytes * size_t(size.y), release_data);
+
+      CGImageRef iref = create_image(fmt, size, row_bytes, provider);
+      // Without an image, this calls release
+      CGDataProviderRelease(provider);
+      if (!iref)
+         throw std::runtime_error{"Error: Failed to initialize image from pixel buffer"};
 
       auto img_ = [[NSImage alloc] initWithCGImage:iref size:NSMakeSize(size.x, size.y)];
+      CGImageRelease(iref);
       _impl = (__bridge_retained image_impl_ptr) img_;
+      detail::update_image_memory({}, memory_used(_impl));
    }
 
    image::~image()
    {
+      detail::update_image_memory(memory_used(_impl), {});
       CFBridgingRelease(_impl);
    }
 
@@ -101,60 +369,148 @@ namespace cycfi::artist
       return {float(size_.width), float(size_.height)};
    }
 
-   void image::save_png(std::string_view path_) const
-   {
-      auto path = [NSString stringWithUTF8String : std::string{path_}.c_str() ];
-      auto image = (__bridge NSImage*) _impl;
-
-      // Get the size of the original image
-      NSSize imageSize = [image size];
-
-      // Create an NSBitmapImageRep with the same dimensions as the original image
-      NSBitmapImageRep *bitmapRep = [[NSBitmapImageRep alloc]
-         initWithBitmapDataPlanes : NULL
-         pixelsWide : imageSize.width
-         pixelsHigh : imageSize.height
-         bitsPerSample : 8
-         samplesPerPixel : 4  // RGBA format
-         hasAlpha : YES
-         isPlanar : NO
-         colorSpaceName : NSDeviceRGBColorSpace
-         bytesPerRow : 0
-         bitsPerPixel : 0
-      ];
-
-      // Set the properties for the PNG file
-      NSDictionary *properties = @{
-         NSImageCompressionFactor :  @1.0, // Compression factor (1.0 means no compression)
-         NSImageColorSyncProfileData :  [NSNull null], // No color profile
-         NSImageInterlaced :  @NO // Non-interlaced
-      };
+   namespace
+   {
+      // Draws the image into a premultiplied rgba32 bitmap context, with
+      // its pixels borrowed from the surface_pool. The caller releases the
+      // context, before buf.
+      CGContextRef rasterize(NSImage* image, extent size, pooled_buffer& buf)
+      {
+         std::size_t width = size.x;
+         std::size_t height = size.y;
+         buf = surface_pool::acquire(width * height * 4);
+         auto space = CGColorSpaceCreateDeviceRGB();
+         auto ctx = CGBitmapContextCreate(
+            buf.data(), width, height, 8, width * 4, space
+          , kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedLast
+         );
+         CGColorSpaceRelease(space);
+         if (!ctx)
+            return nullptr;
+
+         [NSGraphicsContext saveGraphicsState];
+         [NSGraphicsContext setCurrentContext :
+            [NSGraphicsContext graphicsContextWithCGContext : ctx flipped : NO]];
+         [image drawInRect : NSMakeRect(0, 0, size.x, size.y)
+                  fromRect : NSZeroRect
+                 operation : NSCompositingOperationCopy
+                  fraction : 1.0];
+         [NSGraphicsContext restoreGraphicsState];
+         return ctx;
+      }
 
-      // Set the current graphics context to the NSBitmapImageRep
-      [NSGraphicsContext saveGraphicsState];
-      [NSGraphicsContext setCurrentContext : [NSGraphicsContext graphicsContextWithBitmapImageRep : bitmapRep]];
+      NSData* encode(NSImage* image, extent size, image_format format, int quality)
+      {
+         pooled_buffer buf;
+         auto ctx = rasterize(image, size, buf);
+         if (!ctx)
+            return nil;
 
-      // Draw the original image onto the NSBitmapImageRep
-      [image drawAtPoint : NSZeroPoint fromRect : NSZeroRect operation : NSCompositingOperationCopy fraction : 1.0];
+         NSData* result = nil;
+         if (format == image_format::raw)
+         {
+            // Copy the rows, without the bitmap context's row padding
+            auto width = CGBitmapContextGetWidth(ctx);
+            auto height = CGBitmapContextGetHeight(ctx);
+            auto row_bytes = CGBitmapContextGetBytesPerRow(ctx);
+            auto src = static_cast<std::uint8_t const*>(CGBitmapContextGetData(ctx));
+            auto data = [NSMutableData dataWithLength : width * height * 4];
+            auto dest = static_cast<std::uint8_t*>([data mutableBytes]);
+            for (size_t y = 0; y != height; ++y)
+               std::copy_n(src + y * row_bytes, width * 4, dest + y * width * 4);
+            result = data;
+         }
+         else
+         {
+            CFStringRef type = CFSTR("public.png");
+            switch (format)
+            {
+               case image_format::jpeg:   type = CFSTR("public.jpeg"); break;
+               case image_format::webp:   type = CFSTR("org.webmproject.webp"); break;
+               default:                   break;
+            }
 
-      // Restore the graphics state
-      [NSGraphicsContext restoreGraphicsState];
+            auto cg_image = CGBitmapContextCreateImage(ctx);
+            auto data = [NSMutableData data];
+            auto dest = CGImageDestinationCreateWithData(
+               (__bridge CFMutableDataRef) data, type, 1, nullptr);
+            if (cg_image && dest)
+            {
+               auto properties = @{
+                  (__bridge NSString*) kCGImageDestinationLossyCompressionQuality :
+                     @(std::clamp(quality, 0, 100) / 100.0)
+               };
+               CGImageDestinationAddImage(dest, cg_image, (__bridge CFDictionaryRef) properties);
+               if (CGImageDestinationFinalize(dest))
+                  result = data;
+            }
+            if (dest)
+               CFRelease(dest);
+            CGImageRelease(cg_image);
+         }
+         CGContextRelease(ctx);
+         return result;
+      }
+   }
 
-      // Convert the NSBitmapImageRep to NSData with PNG format
-      NSData* data = [bitmapRep representationUsingType : NSBitmapImageFileTypePNG properties : properties];
+   std::vector<std::uint8_t> image::encode(image_format format, int quality) const
+   {
+      // Note: ImageIO does not write webp, so that throws.
+      auto data = artist::encode((__bridge NSImage*) _impl, size(), format, quality);
+      if (!data)
+         throw std::runtime_error{"Error: Failed to encode image."};
+      auto p = static_cast<std::uint8_t const*>([data bytes]);
+      return {p, p + [data length]};
+   }
+
+   void image::save(fs::path const& path, image_format format, int quality) const
+   {
+      auto data = artist::encode((__bridge NSImage*) _impl, size(), format, quality);
+      auto path_ = [NSString stringWithUTF8String : path.c_str()];
+      if (!data || ![data writeToFile : path_ atomically : YES])
+         throw std::runtime_error{"Error: Failed to save file: " + path.string()};
+   }
 
-      // Write the data to the file
-     [data writeToFile : path atomically : YES];
+   void image::save_png(std::string_view path) const
+   {
+      save(fs::path{std::string{path}}, image_format::png);
    }
 
    uint32_t* image::pixels()
    {
-      return get_pixels((__bridge NSImage*) _impl);
+      return (uint32_t*) get_bytes((__bridge NSImage*) _impl);
    }
 
    uint32_t const* image::pixels() const
    {
-      return get_pixels((__bridge NSImage*) _impl);
+      return (uint32_t const*) get_bytes((__bridge NSImage*) _impl);
+   }
+
+   std::uint8_t* image::bytes()
+   {
+      return get_bytes((__bridge NSImage*) _impl);
+   }
+
+   std::uint8_t const* image::bytes() const
+   {
+      return get_bytes((__bridge NSImage*) _impl);
+   }
+
+   void image::pixels_changed()
+   {
+      // Drop NSImage's cached representations, so they are made again from
+      // the (changed) pixels.
+      [((__bridge NSImage*) _impl) recache];
+   }
+
+   void image::purgeable(bool /* flag */)
+   {
+      // NSImage purges and decodes its cached representations on its own
+   }
+
+   bool image::purgeable() const
+   {
+      return false;
    }
 
    extent image::bitmap_size() const
@@ -165,19 +521,87 @@ namespace cycfi::artist
       return {float(pixels_wide), float(pixels_high)};
    }
 
+   pixel_format image::format() const
+   {
+      auto bm = get_bitmap((__bridge NSImage*) _impl);
+      if (!bm || [bm isPlanar])
+         return pixel_format::invalid;
+
+      auto fmt = [bm bitmapFormat];
+      if ([bm bitsPerPixel] == 8 && [bm samplesPerPixel] == 1)
+         return pixel_format::gray8;
+      if ([bm bitsPerPixel] == 32 && [bm samplesPerPixel] == 4
+         && !(fmt & (NSBitmapFormatAlphaFirst | NSBitmapFormatAlphaNonpremultiplied
+            | NSBitmapFormatFloatingPointSamples)))
+         return pixel_format::rgba32_premul;
+      if ([bm bitsPerPixel] == 64 && [bm samplesPerPixel] == 4
+         && (fmt & NSBitmapFormatFloatingPointSamples)
+         && !(fmt & (NSBitmapFormatAlphaFirst | NSBitmapFormatAlphaNonpremultiplied)))
+         return pixel_format::rgba_f16;
+      return pixel_format::invalid;
+   }
+
+   std::size_t image::row_bytes() const
+   {
+      auto bm = get_bitmap((__bridge NSImage*) _impl);
+      return bm? [bm bytesPerRow] : 0;
+   }
+
+   // Images made with image(extent) are drawn into their own (pooled)
+   // pixels, through a bitmap context. Others are drawn with lockFocus,
+   // which gives the image a new representation to draw into.
+   struct offscreen_image::state
+   {
+      CGContextRef ctx = nullptr;
+   };
+
    offscreen_image::offscreen_image(image& pict)
     : _image(pict)
    {
-      [((__bridge NSImage*) _image.impl()) lockFocusFlipped : YES];
+      auto img = (__bridge NSImage*) _image.impl();
+      auto bm = get_bitmap(img);
+      if (is_drawable(bm))
+      {
+         std::size_t width = [bm pixelsWide];
+         std::size_t height = [bm pixelsHigh];
+         auto space = CGColorSpaceCreateDeviceRGB();
+         auto ctx = CGBitmapContextCreate(
+            [bm bitmapData], width, height, 8, [bm bytesPerRow], space
+          , kCGBitmapByteOrderDefault | kCGImageAlphaPremultipliedLast
+         );
+         CGColorSpaceRelease(space);
+         if (ctx)
+         {
+            // Top-down, in points, like lockFocusFlipped
+            auto size = [img size];
+            CGContextTranslateCTM(ctx, 0, height);
+            CGContextScaleCTM(ctx, width / size.width, -(height / size.height));
+            _state = new state{ctx};
+            return;
+         }
+      }
+      [img lockFocusFlipped : YES];
    }
 
-    offscreen_image::~offscreen_image()
+   offscreen_image::~offscreen_image()
    {
-      [((__bridge NSImage*) _image.impl()) unlockFocus];
+      auto img = (__bridge NSImage*) _image.impl();
+      if (_state)
+      {
+         CGContextRelease(_state->ctx);
+         delete _state;
+         [img recache];
+      }
+      else
+      {
+         [img unlockFocus];
+      }
    }
 
    canvas_impl* offscreen_image::context() const
    {
+      if (_state)
+         return (canvas_impl*) _state->ctx;
       return (canvas_impl*) NSGraphicsContext.currentContext.CGContext;
    }
 }
@@ -133,6 +133,41 @@ namespace cycfi::artist
       CGPathAddCurveToPoint(_impl, nullptr, cp1.x, cp1.y, cp2.x, cp2.y, end.x, end.y);
    }
 
+   void path::append(
+      path_verb const verbs[], std::size_t num_verbs
+    , point const points[], std::size_t /*num_points*/)
+   {
+      auto p = points;
+      for (std::size_t i = 0; i != num_verbs; ++i)
+      {
+         switch (verbs[i])
+         {
+            case path_verb::move:
+               CGPathMoveToPoint(_impl, nullptr, p[0].x, p[0].y);
+               p += 1;
+               break;
+            case path_verb::line:
+               CGPathAddLineToPoint(_impl, nullptr, p[0].x, p[0].y);
+               p += 1;
+               break;
+            case path_verb::quad:
+               CGPathAddQuadCurveToPoint(_impl, nullptr, p[0].x, p[0].y, p[1].x, p[1].y);
+               p += 2;
+               break;
+            case path_verb::cubic:
+               CGPathAddCurveToPoint(
+                  _impl, nullptr
+                , p[0].x, p[0].y, p[1].x, p[1].y, p[2].x, p[2].y
+               );
+               p += 3;
+               break;
+            case path_verb::close:
+               CGPathCloseSubpath(_impl);
+               break;
+         }
+      }
+   }
+
    void path::add_round_rect_impl(rect const& r, float radius)
    {
       CGPathAddRoundedRect(_impl, nullptr,
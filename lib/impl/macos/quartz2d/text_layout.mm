@@ -336,6 +336,38 @@ namespace cycfi::artist
       return _impl->get_text();
    }
 
+   // CoreText lays out the whole string again, so edits rebuild the
+   // layout with the edited text
+   void text_layout::insert(std::size_t pos, std::string_view utf8)
+   {
+      insert(pos, std::u32string_view{to_utf32(utf8)});
+   }
+
+   void text_layout::insert(std::size_t pos, std::u32string_view utf32)
+   {
+      std::u32string edited{_impl->get_text()};
+      edited.insert(std::min(pos, edited.size()), utf32);
+      text(std::u32string_view{edited});
+   }
+
+   void text_layout::erase(std::size_t pos, std::size_t count)
+   {
+      std::u32string edited{_impl->get_text()};
+      if (pos < edited.size())
+         edited.erase(pos, count);
+      text(std::u32string_view{edited});
+   }
+
+   void text_layout::append(std::string_view utf8)
+   {
+      insert(npos, utf8);
+   }
+
+   void text_layout::append(std::u32string_view utf32)
+   {
+      insert(npos, utf32);
+   }
+
    void text_layout::flow(float width, bool justify)
    {
       auto line_info_f = [width](float y)
@@ -5,6 +5,12 @@
 =============================================================================*/
 #include <infra/support.hpp>
 #include <artist/canvas.hpp>
+#include <artist/colormap.hpp>
+#include <artist/raster_cache.hpp>
+#include <artist/surface_pool.hpp>
+#include <artist/text_cache.hpp>
+#include <algorithm>
+#include <cstring>
 #include <stack>
 #include "opaque.hpp"
 
@@ -15,6 +21,8 @@
 #include <SkPicture.h>
 #include <SkSurface.h>
 #include <SkCanvas.h>
+#include <SkColorFilter.h>
+#include <SkRSXform.h>
 #include <SkPath.h>
 #include <SkGradientShader.h>
 #include <SkImageFilter.h>
@@ -43,7 +51,10 @@ namespace cycfi::artist
       SkPaint&          stroke_paint();
       class font&       font();
       int&              text_align();
+      image_sampling_enum& image_sampling();
+      float&            alpha();
       SkPaint&          clear_paint();
+      SkPaint const&    with_alpha(SkPaint const& paint);
 
       void              save();
       void              restore();
@@ -69,6 +80,8 @@ namespace cycfi::artist
          SkPaint        _stroke_paint;
          class font     _font;
          int            _text_align = 0;
+         image_sampling_enum _image_sampling = nearest;
+         float          _alpha = 1.0f;
       };
 
       using state_info_ptr = std::unique_ptr<state_info>;
@@ -79,6 +92,7 @@ namespace cycfi::artist
 
       state_info_stack  _stack;
       SkPaint           _clear_paint;
+      SkPaint           _alpha_paint;
       affine_transform  _inv_affine;
    };
 
@@ -115,11 +129,32 @@ namespace cycfi::artist
       return current()->_text_align;
    }
 
+   canvas::image_sampling_enum& canvas::canvas_state::image_sampling()
+   {
+      return current()->_image_sampling;
+   }
+
+   float& canvas::canvas_state::alpha()
+   {
+      return current()->_alpha;
+   }
+
    SkPaint& canvas::canvas_state::clear_paint()
    {
       return _clear_paint;
    }
 
+   // The paint, with the global alpha multiplied in
+   SkPaint const& canvas::canvas_state::with_alpha(SkPaint const& paint)
+   {
+      auto alpha = current()->_alpha;
+      if (alpha == 1.0f)
+         return paint;
+      _alpha_paint = paint;
+      _alpha_paint.setAlphaf(paint.getAlphaf() * alpha);
+      return _alpha_paint;
+   }
+
    void canvas::canvas_state::save()
    {
       _stack.push(std::make_unique<state_info>(*current()));
@@ -226,6 +261,47 @@ namespace cycfi::artist
       _context->setMatrix(mat);
    }
 
+   namespace
+   {
+      SkBlendMode to_sk_blend_mode(canvas::composite_op_enum mode)
+      {
+         SkBlendMode mode_ = SkBlendMode::kSrcOver;
+         switch (mode)
+         {
+            case canvas::source_over:       mode_ = SkBlendMode::kSrcOver;      break;
+            case canvas::source_atop:       mode_ = SkBlendMode::kSrcATop;      break;
+            case canvas::source_in:         mode_ = SkBlendMode::kSrcIn;        break;
+            case canvas::source_out:        mode_ = SkBlendMode::kSrcOut;       break;
+
+            case canvas::destination_over:  mode_ = SkBlendMode::kDstOver;      break;
+            case canvas::destination_atop:  mode_ = SkBlendMode::kDstATop;      break;
+            case canvas::destination_in:    mode_ = SkBlendMode::kDstIn;        break;
+            case canvas::destination_out:   mode_ = SkBlendMode::kDstOut;       break;
+
+            case canvas::lighter:           mode_ = SkBlendMode::kLighten;      break;
+            case canvas::darker:            mode_ = SkBlendMode::kDarken;       break;
+            case canvas::copy:              mode_ = SkBlendMode::kSrc;          break;
+            case canvas::xor_:              mode_ = SkBlendMode::kXor;          break;
+
+            case canvas::difference:        mode_ = SkBlendMode::kDifference;   break;
+            case canvas::exclusion:         mode_ = SkBlendMode::kExclusion;    break;
+            case canvas::multiply:          mode_ = SkBlendMode::kMultiply;     break;
+            case canvas::screen:            mode_ = SkBlendMode::kScreen;       break;
+
+            case canvas::color_dodge:       mode_ = SkBlendMode::kColorDodge;   break;
+            case canvas::color_burn:        mode_ = SkBlendMode::kColorBurn;    break;
+            case canvas::soft_light:        mode_ = SkBlendMode::kSoftLight;    break;
+            case canvas::hard_light:        mode_ = SkBlendMode::kHardLight;    break;
+
+            case canvas::hue:               mode_ = SkBlendMode::kHue;          break;
+            case canvas::saturation:        mode_ = SkBlendMode::kSaturation;   break;
+            case canvas::color_op:          mode_ = SkBlendMode::kColor;        break;
+            case canvas::luminosity:        mode_ = SkBlendMode::kLuminosity;   break;
+         };
+         return mode_;
+      }
+   }
+
    void canvas::save()
    {
       _context->save();
@@ -238,6 +314,32 @@ namespace cycfi::artist
       _state->restore();
    }
 
+   void canvas::begin_layer(rect const& bounds, float opacity, composite_op_enum mode)
+   {
+      auto bounds_ = SkRect{bounds.left, bounds.top, bounds.right, bounds.bottom};
+      opacity = std::clamp(opacity, 0.0f, 1.0f);
+      _state->save();
+      if (mode == source_over && opacity == 1.0f)
+      {
+         // Drawing directly looks the same, without the layer's allocation
+         _context->save();
+         _context->clipRect(bounds_, true);
+         return;
+      }
+
+      SkPaint paint;
+      paint.setAlphaf(opacity);
+      paint.setBlendMode(to_sk_blend_mode(mode));
+      _context->saveLayer(&bounds_, &paint);
+      _context->clipRect(bounds_, true);
+   }
+
+   void canvas::end_layer()
+   {
+      _context->restore();
+      _state->restore();
+   }
+
    void canvas::begin_path()
    {
       _state->path() = {};
@@ -256,7 +358,7 @@ namespace cycfi::artist
 
    void canvas::fill_preserve()
    {
-      _context->drawPath(_state->path(), _state->fill_paint());
+      _context->drawPath(_state->path(), _state->with_alpha(_state->fill_paint()));
    }
 
    void canvas::stroke()
@@ -267,7 +369,7 @@ namespace cycfi::artist
 
    void canvas::stroke_preserve()
    {
-      _context->drawPath(_state->path(), _state->stroke_paint());
+      _context->drawPath(_state->path(), _state->with_alpha(_state->stroke_paint()));
    }
 
    void canvas::clip()
@@ -281,6 +383,14 @@ namespace cycfi::artist
       _context->clipPath(*p.impl(), true);
    }
 
+   void canvas::clip(region const& r)
+   {
+      SkPath path;
+      for (auto const& i : r)
+         path.addRect({i.left, i.top, i.right, i.bottom});
+      _context->clipPath(path, true);
+   }
+
    rect canvas::clip_extent() const
    {
       SkRect r;
@@ -422,43 +532,21 @@ namespace cycfi::artist
 
    void canvas::global_composite_operation(composite_op_enum mode)
    {
-      SkBlendMode mode_ = SkBlendMode::kSrcOver;
-      switch (mode)
-      {
-         case source_over:       mode_ = SkBlendMode::kSrcOver;      break;
-         case source_atop:       mode_ = SkBlendMode::kSrcATop;      break;
-         case source_in:         mode_ = SkBlendMode::kSrcIn;        break;
-         case source_out:        mode_ = SkBlendMode::kSrcOut;       break;
-
-         case destination_over:  mode_ = SkBlendMode::kDstOver;      break;
-         case destination_atop:  mode_ = SkBlendMode::kDstATop;      break;
-         case destination_in:    mode_ = SkBlendMode::kDstIn;        break;
-         case destination_out:   mode_ = SkBlendMode::kDstOut;       break;
-
-         case lighter:           mode_ = SkBlendMode::kLighten;      break;
-         case darker:            mode_ = SkBlendMode::kDarken;       break;
-         case copy:              mode_ = SkBlendMode::kSrc;          break;
-         case xor_:              mode_ = SkBlendMode::kXor;          break;
-
-         case difference:        mode_ = SkBlendMode::kDifference;   break;
-         case exclusion:         mode_ = SkBlendMode::kExclusion;    break;
-         case multiply:          mode_ = SkBlendMode::kMultiply;     break;
-         case screen:            mode_ = SkBlendMode::kScreen;       break;
-
-         case color_dodge:       mode_ = SkBlendMode::kColorDodge;   break;
-         case color_burn:        mode_ = SkBlendMode::kColorBurn;    break;
-         case soft_light:        mode_ = SkBlendMode::kSoftLight;    break;
-         case hard_light:        mode_ = SkBlendMode::kHardLight;    break;
-
-         case hue:               mode_ = SkBlendMode::kHue;          break;
-         case saturation:        mode_ = SkBlendMode::kSaturation;   break;
-         case color_op:          mode_ = SkBlendMode::kColor;        break;
-         case luminosity:        mode_ = SkBlendMode::kLuminosity;   break;
-      };
+      auto mode_ = to_sk_blend_mode(mode);
       _state->stroke_paint().setBlendMode(mode_);
       _state->fill_paint().setBlendMode(mode_);
    }
 
+   void canvas::global_alpha(float alpha)
+   {
+      _state->alpha() = std::clamp(alpha, 0.0f, 1.0f);
+   }
+
+   float canvas::global_alpha() const
+   {
+      return _state->alpha();
+   }
+
    namespace
    {
       void convert_gradient(
@@ -523,6 +611,53 @@ namespace cycfi::artist
              , nullptr
             ));
       }
+
+      void set_colormap(colormap const& cmap, point start, point end, SkPaint& paint)
+      {
+         auto dx = end.x - start.x;
+         auto dy = end.y - start.y;
+         if (dx == 0 && dy == 0)
+         {
+            auto c = cmap(0);
+            paint.setColor4f({c.red, c.green, c.blue, c.alpha}, nullptr);
+            paint.setShader(nullptr);
+            return;
+         }
+
+         // The colormap as a size() x 1 image, sampled with bilinear
+         // filtering. The image and its shader are made once per colormap;
+         // only the local matrix is made per call. It puts the first and
+         // last pixel centers at start and end. The image's y axis
+         // (clamped) runs perpendicular to that.
+         auto n = cmap.size();
+         auto& style = cmap.style();
+         std::call_once(style.once,
+            [&]
+            {
+               auto info = SkImageInfo::Make(n, 1, kRGBA_8888_SkColorType, kUnpremul_SkAlphaType);
+               auto img = SkImage::MakeRasterData(
+                  info, SkData::MakeWithCopy(cmap.data(), n * 4), n * 4);
+               auto shader = img->makeShader(
+                  SkTileMode::kClamp, SkTileMode::kClamp
+                , SkSamplingOptions(SkFilterMode::kLinear)
+               );
+               style.style = std::shared_ptr<SkShader const>(
+                  shader.release(), [](SkShader const* p) { SkSafeUnref(p); });
+            }
+         );
+         auto shader = static_cast<SkShader const*>(style.style.get());
+
+         auto sx = dx / (n - 1);
+         auto sy = dy / (n - 1);
+         auto mat = SkMatrix::MakeAll(
+            sx, -dy, start.x - sx * 0.5f
+          , sy, dx, start.y - sy * 0.5f
+          , 0, 0, 1
+         );
+
+         paint.setColor(SkColorSetRGB(0, 0, 0));
+         paint.setShader(shader->makeWithLocalMatrix(mat));
+      }
    }
 
    void canvas::fill_style(linear_gradient const& gr)
@@ -545,6 +680,16 @@ namespace cycfi::artist
       set_radial(gr, _state->stroke_paint());
    }
 
+   void canvas::fill_style(colormap const& cmap, point start, point end)
+   {
+      set_colormap(cmap, start, end, _state->fill_paint());
+   }
+
+   void canvas::stroke_style(colormap const& cmap, point start, point end)
+   {
+      set_colormap(cmap, start, end, _state->stroke_paint());
+   }
+
    void canvas::font(class font const& font_)
    {
       _state->font() = font_;
@@ -559,14 +704,35 @@ namespace cycfi::artist
 
    namespace
    {
-      void prepare_text(
-         font const& font
-       , int text_align
-       , point& p, char const* f, char const* l
-      )
+      // Text shaped for drawing, with its measurements (see text_cache)
+      struct shaped_text
+      {
+         sk_sp<SkTextBlob>    blob;
+         float                width;
+         font::metrics_info   metrics;
+      };
+
+      std::shared_ptr<shaped_text const> shape_text(font const& font_, std::string_view utf8)
       {
-         auto metrics = font.metrics();
-         auto width = font.measure_text(std::string_view(f, l-f));
+         auto const& sk_font = *font_.impl();
+         auto typeface = sk_font.getTypefaceOrDefault();
+         return detail::shaped_text<shaped_text>(
+            typeface? typeface->uniqueID() : 0, sk_font.getSize(), utf8
+          , [&]
+            {
+               return shaped_text{
+                  SkTextBlob::MakeFromText(utf8.data(), utf8.size(), sk_font)
+                , font_.measure_text(utf8)
+                , font_.metrics()
+               };
+            }
+         );
+      }
+
+      void prepare_text(shaped_text const& shaped, int text_align, point& p)
+      {
+         auto const& metrics = shaped.metrics;
+         auto width = shaped.width;
          switch (text_align & 0x1C)
          {
             case canvas::top:    p.y += metrics.ascent; break;
@@ -586,31 +752,27 @@ namespace cycfi::artist
 
    void canvas::fill_text(std::string_view utf8, point p)
    {
-      auto text_blob = SkTextBlob::MakeFromText(
-         utf8.data(), utf8.size(), *_state->font().impl().get()
-      );
-      prepare_text(_state->font(), _state->text_align(), p, utf8.data(), utf8.data()+utf8.size());
-      _context->drawTextBlob(text_blob.get(), p.x, p.y, _state->fill_paint());
+      auto shaped = shape_text(_state->font(), utf8);
+      prepare_text(*shaped, _state->text_align(), p);
+      _context->drawTextBlob(shaped->blob.get(), p.x, p.y, _state->with_alpha(_state->fill_paint()));
    }
 
    void canvas::stroke_text(std::string_view utf8, point p)
    {
-      auto text_blob = SkTextBlob::MakeFromText(
-         utf8.data(), utf8.size(), *_state->font().impl().get()
-      );
-      prepare_text(_state->font(), _state->text_align(), p, utf8.data(), utf8.data()+ utf8.size());
-      _context->drawTextBlob(text_blob.get(), p.x, p.y, _state->stroke_paint());
+      auto shaped = shape_text(_state->font(), utf8);
+      prepare_text(*shaped, _state->text_align(), p);
+      _context->drawTextBlob(shaped->blob.get(), p.x, p.y, _state->with_alpha(_state->stroke_paint()));
    }
 
    canvas::text_metrics canvas::measure_text(std::string_view utf8)
    {
-      auto m = _state->font().metrics();
-      auto width = _state->font().measure_text(utf8);
+      auto shaped = shape_text(_state->font(), utf8);
+      auto const& m = shaped->metrics;
       return {
          m.ascent
        , m.descent
        , m.leading
-       , {width, m.ascent + m.descent + m.leading}
+       , {shaped->width, m.ascent + m.descent + m.leading}
       };
    }
 
@@ -629,6 +791,34 @@ namespace cycfi::artist
       _state->text_align() |= align;
    }
 
+   namespace
+   {
+      SkSamplingOptions sampling_options(canvas::image_sampling_enum mode, bool minified)
+      {
+         switch (mode)
+         {
+            case canvas::linear:
+               return SkSamplingOptions(SkFilterMode::kLinear);
+            case canvas::mipmap_linear:
+               if (minified)
+                  return SkSamplingOptions(SkFilterMode::kLinear, SkMipmapMode::kLinear);
+               return SkSamplingOptions(SkFilterMode::kLinear);
+            case canvas::cubic:
+               return SkSamplingOptions(SkCubicResampler::Mitchell());
+            default:
+               return SkSamplingOptions();
+         }
+      }
+
+      // True if xf only rotates, uniformly scales and translates, i.e. it
+      // can be an SkRSXform.
+      bool is_rs_xform(affine_transform const& xf)
+      {
+         constexpr auto epsilon = 1e-6;
+         return std::abs(xf.a - xf.d) < epsilon && std::abs(xf.b + xf.c) < epsilon;
+      }
+   }
+
    void canvas::draw(image const& pic, rect const& src, rect const& dest)
    {
       auto draw_picture =
@@ -643,16 +833,27 @@ namespace cycfi::artist
                SkMatrix mat;
                mat.setScale(dest.width()/src.width(), dest.height()/src.height());
                mat.setTranslate(dest.left-src.left, dest.top-src.top);
-               _context->drawPicture(that, &mat, &_state->fill_paint());
+               _context->drawPicture(that, &mat, &_state->with_alpha(_state->fill_paint()));
             }
             if constexpr(std::is_same_v<T, SkBitmap>)
             {
+               auto src_ = SkRect{src.left, src.top, src.right, src.bottom};
+               auto dest_ = SkRect{dest.left, dest.top, dest.right, dest.bottom};
+               auto mode = _state->image_sampling();
+
+               // Only minified draws need the mip chain
+               bool minified = false;
+               if (mode == mipmap_linear)
+               {
+                  auto device = _context->getTotalMatrix().mapRect(dest_);
+                  minified = device.width() < src_.width() || device.height() < src_.height();
+               }
+
                _context->drawImageRect(
-                  that.asImage(),
-                  SkRect{src.left, src.top, src.right, src.bottom},
-                  SkRect{dest.left, dest.top, dest.right, dest.bottom},
-                  SkSamplingOptions(),
-                  &_state->fill_paint(),
+                  minified? pic.impl()->mipmapped() : pic.impl()->snapshot(),
+                  src_, dest_,
+                  sampling_options(mode, minified),
+                  &_state->with_alpha(_state->fill_paint()),
                   SkCanvas::kStrict_SrcRectConstraint
                );
             }
@@ -661,9 +862,118 @@ namespace cycfi::artist
       return std::visit(draw_picture, pic.impl()->base());
    }
 
+   void canvas::draw_atlas(
+      image const& pic
+    , rect const src[]
+    , affine_transform const xf[]
+    , color const tint[]
+    , std::size_t n
+   )
+   {
+      auto to_sk_color =
+         [](color c)
+         {
+            return SkColor4f{c.red, c.green, c.blue, c.alpha}.toSkColor();
+         };
+
+      bool batch = std::holds_alternative<SkBitmap>(pic.impl()->base());
+      for (std::size_t i = 0; batch && i != n; ++i)
+         batch = is_rs_xform(xf[i]);
+
+      if (!batch)
+      {
+         // Pictures and general transforms: draw the sprites one by one
+         auto& paint = _state->fill_paint();
+         auto filter = paint.refColorFilter();
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto const& m = xf[i];
+            _context->save();
+            _context->concat(SkMatrix::MakeAll(
+               m.a, m.c, m.tx
+             , m.b, m.d, m.ty
+             , 0, 0, 1
+            ));
+            if (tint)
+               paint.setColorFilter(SkColorFilters::Blend(to_sk_color(tint[i]), SkBlendMode::kModulate));
+            draw(pic, src[i], rect{0, 0, src[i].width(), src[i].height()});
+            _context->restore();
+         }
+         paint.setColorFilter(filter);
+         return;
+      }
+
+      // Scratch buffers, kept per thread so that drawing the same number
+      // of sprites frame after frame does not allocate.
+      thread_local std::vector<SkRSXform> xforms;
+      thread_local std::vector<SkRect> tex;
+      thread_local std::vector<SkColor> colors;
+      xforms.resize(n);
+      tex.resize(n);
+      colors.resize(tint? n : 0);
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         xforms[i] = SkRSXform::Make(xf[i].a, xf[i].b, xf[i].tx, xf[i].ty);
+         tex[i] = SkRect{src[i].left, src[i].top, src[i].right, src[i].bottom};
+         if (tint)
+            colors[i] = to_sk_color(tint[i]);
+      }
+
+      // Sprites are usually drawn at many scales, so with mipmap_linear,
+      // the whole batch uses the mip chain.
+      auto mode = _state->image_sampling();
+      bool mipmapped = mode == mipmap_linear;
+      _context->drawAtlas(
+         (mipmapped? pic.impl()->mipmapped() : pic.impl()->snapshot()).get()
+       , xforms.data(), tex.data(), tint? colors.data() : nullptr, int(n)
+       , SkBlendMode::kModulate
+       , sampling_options(mode, mipmapped)
+       , nullptr
+       , &_state->with_alpha(_state->fill_paint())
+      );
+   }
+
+   void canvas::image_sampling(image_sampling_enum mode)
+   {
+      _state->image_sampling() = mode;
+   }
+
+   canvas::image_sampling_enum canvas::image_sampling() const
+   {
+      return _state->image_sampling();
+   }
+
    void canvas::add_round_rect_impl(rect const& r, float radius)
    {
       _state->path().addRoundRect({r.left, r.top, r.right, r.bottom}, radius, radius);
    }
 
+   namespace detail
+   {
+      image rasterize(extent size, canvas::draw_function const& draw)
+      {
+         constexpr auto fmt = kN32_SkColorType == kBGRA_8888_SkColorType?
+            pixel_format::bgra32_premul : pixel_format::rgba32_premul;
+
+         std::size_t width = size.x;
+         std::size_t height = size.y;
+         auto row_bytes = width * sizeof(std::uint32_t);
+         auto buf = new pooled_buffer{surface_pool::acquire(row_bytes * height)};
+         std::memset(buf->data(), 0, row_bytes * height);      // Transparent
+         auto img = make_image<fmt>(
+            reinterpret_cast<std::uint32_t*>(buf->data()), size, row_bytes
+          , [buf]{ delete buf; }
+         );
+         {
+            auto sk_canvas = make_pooled_canvas(std::get<SkBitmap>(img.impl()->base()).pixmap());
+            if (!sk_canvas)
+               throw std::runtime_error{"Error: Failed to create the raster canvas."};
+            canvas cnv{sk_canvas.get()};
+            draw(cnv);
+         }
+         img.pixels_changed();
+         return img;
+      }
+   }
+
 }
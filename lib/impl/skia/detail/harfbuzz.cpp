@@ -7,6 +7,9 @@
 #include <SkStream.h>
 #include <SkTypeface.h>
 #include <cmath>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #if defined(_MSC_VER) && _MSC_VER < 1800
 extern "C"
@@ -49,22 +52,22 @@ namespace cycfi::artist::detail
       hb_blob_make_immutable(_blob.get());
    }
 
-   hb_font::hb_font(SkTypeface* tf)
+   namespace
    {
-      int index;
-      hb_blob blob{std::unique_ptr<SkStreamAsset>(tf->openStream(&index))};
-      hb_face_t* face = hb_face_create(blob.get(), unsigned(index));
-      SkASSERT(face);
-      if (face)
+      std::shared_ptr<hb_font_t> make_hb_font(SkTypeface* tf)
       {
-         hb_face_set_index(face, unsigned(index));
-         hb_face_set_upem(face, tf->getUnitsPerEm());
-
-         _font = ptr_type(hb_font_create(face));
-         SkASSERT(_font.get());
-         if (_font)
+         std::shared_ptr<hb_font_t> font;
+         int index;
+         hb_blob blob{std::unique_ptr<SkStreamAsset>(tf->openStream(&index))};
+         hb_face_t* face = hb_face_create(blob.get(), unsigned(index));
+         SkASSERT(face);
+         if (face)
          {
-            hb_ot_font_set_funcs(_font.get());
+            hb_face_set_index(face, unsigned(index));
+            hb_face_set_upem(face, tf->getUnitsPerEm());
+
+            font = {hb_font_create(face), hb_font_destroy};
+            hb_ot_font_set_funcs(font.get());
             int axis_count = tf->getVariationDesignPosition(nullptr, 0);
             if (axis_count > 0)
             {
@@ -72,17 +75,105 @@ namespace cycfi::artist::detail
                if (tf->getVariationDesignPosition(axis_values, axis_count) == axis_count)
                {
                   hb_font_set_variations(
-                     _font.get()
+                     font.get()
                   , reinterpret_cast<hb_variation_t*>(axis_values.get())
                   , axis_count
                   );
                }
             }
+            hb_font_make_immutable(font.get());
+            hb_face_destroy(face);
+         }
+         return font;
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // The HarfBuzz fonts of the typefaces, by typeface ID (IDs are never
+      // reused). Typefaces do not all live for good: fallback typefaces,
+      // and those made from a name, are freed when no longer used. So each
+      // entry holds a weak reference to its typeface, and the entries of
+      // freed typefaces are dropped, with their font data, when a font is
+      // added. An hb_font still using one keeps it until it is done.
+      /////////////////////////////////////////////////////////////////////////
+      struct weak_unref
+      {
+         void operator()(SkTypeface const* tf) const { tf->weak_unref(); }
+      };
+
+      struct font_map
+      {
+         using font_ptr = std::shared_ptr<hb_font_t>;
+         using weak_typeface = std::unique_ptr<SkTypeface const, weak_unref>;
+
+         struct entry
+         {
+            weak_typeface     typeface;
+            font_ptr          font;
+         };
+
+         font_ptr             find(SkTypefaceID id);
+         font_ptr             add(SkTypeface const* tf, font_ptr font, std::vector<entry>& dropped);
+
+         std::mutex           mutex;
+         std::unordered_map<SkTypefaceID, entry> entries;
+      };
+
+      font_map::font_ptr font_map::find(SkTypefaceID id)
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         auto i = entries.find(id);
+         return i != entries.end()? i->second.font : font_ptr{};
+      }
+
+      // The dropped entries are freed by the caller, outside the lock
+      font_map::font_ptr font_map::add(
+         SkTypeface const* tf, font_ptr font, std::vector<entry>& dropped)
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         if (auto i = entries.find(tf->uniqueID()); i != entries.end())
+            return i->second.font;  // Another thread added it first
+
+         for (auto i = entries.begin(); i != entries.end();)
+         {
+            if (i->second.typeface->weak_expired())
+            {
+               dropped.push_back(std::move(i->second));
+               i = entries.erase(i);
+            }
+            else
+            {
+               ++i;
+            }
          }
-         hb_face_destroy(face);
+
+         tf->weak_ref();
+         auto& e = entries[tf->uniqueID()];
+         e.typeface.reset(tf);
+         e.font = std::move(font);
+         return e.font;
+      }
+
+      font_map& fonts()
+      {
+         static font_map map;
+         return map;
       }
    }
 
+   hb_font::hb_font(SkTypeface* tf)
+   {
+      auto id = tf->uniqueID();
+      if ((_font = fonts().find(id)))
+         return;
+
+      // Made outside the lock, as it reads the font file
+      auto font = make_hb_font(tf);
+      if (!font)
+         return;
+      std::vector<font_map::entry> dropped;
+      _font = fonts().add(tf, std::move(font), dropped);
+   }
+
    hb_buffer::hb_buffer(std::u32string_view utf32)
     : _buffer(ptr_type(hb_buffer_create()))
    {
@@ -111,6 +202,18 @@ namespace cycfi::artist::detail
       return hb_language_to_string(hb_buffer_get_language(_buffer.get()));
    }
 
+   hb_segment_properties_t hb_buffer::segment_properties() const
+   {
+      hb_segment_properties_t props;
+      hb_buffer_get_segment_properties(_buffer.get(), &props);
+      return props;
+   }
+
+   void hb_buffer::segment_properties(hb_segment_properties_t const& props)
+   {
+      hb_buffer_set_segment_properties(_buffer.get(), &props);
+   }
+
    void hb_buffer::shape(hb_font const& font)
    {
       hb_shape(font.get(), _buffer.get(), nullptr, 0);
@@ -123,13 +226,5 @@ namespace cycfi::artist::detail
       info.positions = hb_buffer_get_glyph_positions(_buffer.get(), &info.count);
       return info;
    }
-
-   int hb_buffer::glyphs_info::glyph_index(std::size_t index) const
-   {
-      for (int i = std::min<std::size_t>(index, count-1); i >=0; --i)
-         if (glyphs[i].cluster == index)
-            return &glyphs[i] - glyphs;
-      return -1;
-   }
 }
 
@@ -28,6 +28,11 @@ namespace cycfi::artist::detail
       ptr_type                _blob;
    };
 
+   // hb_font: The HarfBuzz font of a typeface. The face and font are made
+   // once per typeface, from its font data (without a copy when the data
+   // is in memory, e.g. memory-mapped), made immutable, and shared by every
+   // hb_font of the typeface, until the typeface is freed. HarfBuzz allows
+   // shaping with an immutable font on many threads at once.
    struct hb_font
    {
    public:
@@ -36,7 +41,7 @@ namespace cycfi::artist::detail
 
    private:
 
-      using ptr_type = std::unique_ptr<hb_font_t, deleter<hb_font_t, hb_font_destroy>>;
+      using ptr_type = std::shared_ptr<hb_font_t>;
 
       ptr_type                _font;
    };
@@ -50,11 +55,11 @@ namespace cycfi::artist::detail
       void                    script(hb_script_t scr);
       void                    language(char const* lang);
       char const*             language() const;
+      hb_segment_properties_t segment_properties() const;
+      void                    segment_properties(hb_segment_properties_t const& props);
 
       struct glyphs_info
       {
-         int                  glyph_index(std::size_t index) const;
-
          unsigned int         count;
          hb_glyph_info_t*     glyphs;
          hb_glyph_position_t* positions;
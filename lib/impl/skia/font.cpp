@@ -13,8 +13,15 @@
 #include <infra/support.hpp>
 
 # include <fontconfig/fontconfig.h>
+# include <algorithm>
+# include <atomic>
+# include <deque>
+# include <iterator>
 # include <map>
+# include <memory>
 # include <mutex>
+# include <unordered_map>
+# include <vector>
 
 # if defined(_WIN32)
 # include <Windows.h>
@@ -55,22 +62,228 @@ namespace cycfi::artist
          return (a * (1.0 - f)) + (b * f);
       }
 
+      // The typeface of a font file, loaded on first use. Entries are
+      // shared by all font map snapshots, so each file is loaded once.
+      struct lazy_typeface
+      {
+         std::once_flag    once;
+         sk_sp<SkTypeface> typeface;
+      };
+
       struct font_entry
       {
-         sk_sp<SkTypeface> cached_typeface;
+         std::shared_ptr<lazy_typeface> cached_typeface = std::make_shared<lazy_typeface>();
          std::string       file;
          int               index    = 0;
          uint8_t           weight   = font_constants::weight_normal;
          uint8_t           slant    = font_constants::slant_normal;
          uint8_t           stretch  = font_constants::stretch_normal;
+
+         sk_sp<SkTypeface> typeface() const
+         {
+            std::call_once(cached_typeface->once,
+               [this]
+               {
+                  if (!file.empty())
+                     cached_typeface->typeface = SkTypeface::MakeFromFile(file.c_str(), index);
+               });
+            return cached_typeface->typeface;
+         }
+      };
+
+      using font_list = std::vector<font_entry>;
+      using font_map_type = std::map<std::string, std::shared_ptr<font_list const>>;
+      using font_map_ptr = std::shared_ptr<font_map_type const>;
+      using resolved_map = std::unordered_map<std::string, sk_sp<SkTypeface>>;
+
+      /////////////////////////////////////////////////////////////////////////
+      // The fonts, as an immutable snapshot, published through an atomic
+      // pointer. Writers (when a font_descr is resolved for the first time)
+      // copy it, add to the copy, and publish the copy, one writer at a
+      // time. The copies share the font map unless it changes, and then
+      // still share the font lists of the families that did not change.
+      //
+      // Readers may still be using the snapshot that was replaced, so it is
+      // retired, and freed once no reader can be using it (epoch based
+      // reclamation). Each reading thread marks the epoch it started
+      // reading in, in a slot of its own: readers take no lock and share no
+      // reference count. A snapshot retired in epoch e is freed, by the
+      // next writer, once every slot is idle or marks e or later.
+      /////////////////////////////////////////////////////////////////////////
+      struct font_snapshot
+      {
+         font_map_ptr      fonts;
+         resolved_map      resolved;   // Typefaces, by descr_key
+      };
+
+      using font_snapshot_ptr = std::unique_ptr<font_snapshot const>;
+
+      constexpr std::uint64_t idle_epoch = std::uint64_t(-1);
+
+      struct reader_slot
+      {
+         std::atomic<std::uint64_t> epoch{idle_epoch};   // Reading since
+         std::atomic<bool> in_use{true};                 // By a thread
+      };
+
+      struct retired_snapshot
+      {
+         font_snapshot_ptr snapshot;
+         std::uint64_t     epoch;
+      };
+
+      font_map_type init_font_map();
+
+      struct font_snapshots
+      {
+                           font_snapshots();
+
+         reader_slot&      acquire_slot();
+         void              reclaim(std::vector<retired_snapshot>& freed);
+
+         std::atomic<font_snapshot const*> current;
+         std::atomic<std::uint64_t> epoch{0};
+
+         std::mutex        writer_mutex;
+         font_snapshot_ptr owned;      // The current
+         std::vector<retired_snapshot> retired;
+
+         std::mutex        slots_mutex;
+         std::deque<reader_slot> slots;
+      };
+
+      font_snapshots::font_snapshots()
+      {
+         owned = std::make_unique<font_snapshot const>(
+            font_snapshot{std::make_shared<font_map_type const>(init_font_map()), {}});
+         current = owned.get();
+      }
+
+      // A slot for a new thread, reusing those of threads that ended
+      reader_slot& font_snapshots::acquire_slot()
+      {
+         std::lock_guard<std::mutex> lock(slots_mutex);
+         for (auto& slot : slots)
+         {
+            bool free = false;
+            if (slot.in_use.compare_exchange_strong(free, true))
+               return slot;
+         }
+         return slots.emplace_back();
+      }
+
+      // Moves the retired snapshots no reader can be using to freed. Called
+      // by the writer, with writer_mutex held.
+      void font_snapshots::reclaim(std::vector<retired_snapshot>& freed)
+      {
+         auto oldest = idle_epoch;
+         {
+            std::lock_guard<std::mutex> lock(slots_mutex);
+            for (auto const& slot : slots)
+               oldest = std::min(oldest, slot.epoch.load());
+         }
+         auto i = std::partition(retired.begin(), retired.end(),
+            [oldest](auto const& r) { return r.epoch > oldest; });
+         std::move(i, retired.end(), std::back_inserter(freed));
+         retired.erase(i, retired.end());
+      }
+
+      // Never destroyed: threads that end at exit still give back their
+      // slots
+      font_snapshots& snapshots()
+      {
+         static auto* snapshots_ = new font_snapshots;
+         return *snapshots_;
+      }
+
+      struct thread_slot
+      {
+         ~thread_slot()
+         {
+            if (slot)
+               slot->in_use.store(false, std::memory_order_release);
+         }
+
+         reader_slot*      slot = nullptr;
+      };
+
+      reader_slot& this_thread_slot()
+      {
+         thread_local thread_slot local;
+         if (!local.slot)
+            local.slot = &snapshots().acquire_slot();
+         return *local.slot;
+      }
+
+      // The current snapshot, kept from being freed while this lives. The
+      // slot is marked before the snapshot is loaded, so a writer that
+      // finds the slot idle has already published a newer one.
+      class snapshot_reader : non_copyable
+      {
+      public:
+                           snapshot_reader();
+                           ~snapshot_reader();
+
+         font_snapshot const* operator->() const { return _snapshot; }
+         font_snapshot const& operator*() const { return *_snapshot; }
+
+      private:
+
+         reader_slot&      _slot;
+         bool              _outer;        // Not nested in another reader
+         font_snapshot const* _snapshot;
       };
 
-      using font_map_type = std::map<std::string, std::vector<font_entry>>;
-      std::pair<font_map_type&, std::mutex&> get_font_map()
+      snapshot_reader::snapshot_reader()
+       : _slot{this_thread_slot()}
+       , _outer{_slot.epoch.load(std::memory_order_relaxed) == idle_epoch}
+      {
+         auto& s = snapshots();
+         if (_outer)
+            _slot.epoch.store(s.epoch.load());
+         _snapshot = s.current.load();
+      }
+
+      snapshot_reader::~snapshot_reader()
       {
-         static font_map_type font_map_;
-         static std::mutex mutex_;
-         return {font_map_, mutex_};
+         if (_outer)
+            _slot.epoch.store(idle_epoch, std::memory_order_release);
+      }
+
+      void publish(
+         std::string const& key, sk_sp<SkTypeface> typeface
+       , std::string const* family = nullptr, font_entry const* entry = nullptr)
+      {
+         std::vector<retired_snapshot> freed;  // Freed outside the lock
+         auto& s = snapshots();
+         std::lock_guard<std::mutex> lock(s.writer_mutex);
+
+         auto next = std::make_unique<font_snapshot>(*s.owned);
+         next->resolved[key] = std::move(typeface);
+         if (family && entry)
+         {
+            auto fonts = std::make_shared<font_map_type>(*next->fonts);
+            auto& list = (*fonts)[*family];
+            auto added = list? std::make_shared<font_list>(*list) : std::make_shared<font_list>();
+            added->push_back(*entry);
+            list = std::move(added);
+            next->fonts = std::move(fonts);
+         }
+
+         s.current.store(next.get());
+         auto retired_in = s.epoch.fetch_add(1) + 1;
+         s.retired.push_back({std::move(s.owned), retired_in});
+         s.owned = std::move(next);
+         s.reclaim(freed);
+      }
+
+      std::string descr_key(font_descr descr)
+      {
+         return std::string{descr._families}
+            + '|' + std::to_string(descr._weight)
+            + '|' + std::to_string(descr._slant)
+            + '|' + std::to_string(descr._stretch)
+            ;
       }
 
       constexpr auto font_map_default_font_family = "";
@@ -123,7 +336,7 @@ namespace cycfi::artist
       using fc_object_set_ptr = std::unique_ptr<FcObjectSet, deleter<FcObjectSet, FcObjectSetDestroy>>;
       using fc_font_set_ptr = std::unique_ptr<FcFontSet, deleter<FcFontSet, FcFontSetDestroy>>;
 
-      void init_font_map()
+      font_map_type init_font_map()
       {
          FcInit();
          FcConfig* config = FcConfigGetCurrent();
@@ -137,9 +350,7 @@ namespace cycfi::artist
                      };
          auto fs = fc_font_set_ptr{FcFontList(config, pat.get(), os.get())};
 
-         // The lock is not needed, since this is run on static initialization.
-         auto [font_map, font_map_mutex] = get_font_map();
-
+         std::map<std::string, font_list> font_lists;
          for (int i=0; fs && i < fs->nfont; ++i)
          {
             FcPattern* font = fs->fonts[i];
@@ -151,7 +362,6 @@ namespace cycfi::artist
             )
             {
                font_entry entry;
-               entry.cached_typeface = nullptr;
                entry.file = (const char*) file;
                entry.index = index;
 
@@ -170,22 +380,18 @@ namespace cycfi::artist
                std::string key = (const char*) family;
                trim(key);
 
-               font_map[key].push_back(std::move(entry));
+               font_lists[key].push_back(std::move(entry));
             }
          }
+
+         font_map_type font_map;
+         for (auto& [family, list] : font_lists)
+            font_map.emplace(family, std::make_shared<font_list const>(std::move(list)));
+         return font_map;
       }
 
-      font_entry* match(font_map_type& font_map, font_descr descr)
+      font_entry const* match(font_map_type const& font_map, font_descr descr)
       {
-         struct font_init
-         {
-            font_init()
-            {
-               init_font_map();
-            }
-         };
-         static font_init init;
-
          std::istringstream str(
             std::string{descr._families} + ", " + font_map_default_font_family);
          std::string family;
@@ -194,9 +400,10 @@ namespace cycfi::artist
             trim(family);
             if (auto i = font_map.find(family); i != font_map.end())
             {
+               auto const& list = *i->second;
                int min = 10000;
-               std::vector<font_entry>::iterator best_match = i->second.end();
-               for (auto j = i->second.begin(); j != i->second.end(); ++j)
+               auto best_match = list.end();
+               for (auto j = list.begin(); j != list.end(); ++j)
                {
                   auto const& item = *j;
 
@@ -216,7 +423,7 @@ namespace cycfi::artist
                         break;
                   }
                }
-               if (best_match != i->second.end())
+               if (best_match != list.end())
                   return &*best_match;
             }
          }
@@ -231,27 +438,21 @@ namespace cycfi::artist
 
    font::font(font_descr descr)
    {
-      auto [font_map, font_map_mutex] = get_font_map();
-      std::lock_guard<std::mutex> lock(font_map_mutex);
-
-      auto match_ptr = match(font_map, descr);
-      if (match_ptr)
+      // Fast path: this font_descr was resolved before
+      snapshot_reader snapshot;
+      auto key = descr_key(descr);
+      if (auto i = snapshot->resolved.find(key); i != snapshot->resolved.end())
       {
-         if (match_ptr->cached_typeface)
-         {
-            _ptr = std::make_shared<SkFont>(match_ptr->cached_typeface, descr._size);
-         }
-         else
-         {
-            auto face = SkTypeface::MakeFromFile(match_ptr->file.c_str(), match_ptr->index);
-            _ptr = std::make_shared<SkFont>(face, descr._size);
-            if (_ptr)
-               match_ptr->cached_typeface = sk_ref_sp(_ptr->getTypeface());
-         }
+         _ptr = std::make_shared<SkFont>(i->second, descr._size);
+         return;
       }
 
-      if (_ptr)
+      if (auto match_ptr = match(*snapshot->fonts, descr))
+      {
+         _ptr = std::make_shared<SkFont>(match_ptr->typeface(), descr._size);
+         publish(key, sk_ref_sp(_ptr->getTypeface()));
          return;
+      }
 
       using namespace font_constants;
       int stretch = int(descr._stretch) / 10;
@@ -284,12 +485,14 @@ namespace cycfi::artist
       }
 
       font_entry entry;
-      entry.cached_typeface = sk_ref_sp(_ptr->getTypeface());
+      auto typeface = sk_ref_sp(_ptr->getTypeface());
+      std::call_once(entry.cached_typeface->once,
+         [&]{ entry.cached_typeface->typeface = typeface; });
       entry.weight = descr._weight;
       entry.slant = descr._slant;
       entry.stretch = descr._stretch;
 
-      font_map[family].push_back(std::move(entry));
+      publish(key, typeface, &family, &entry);
    }
 
    font::font(font const& rhs)
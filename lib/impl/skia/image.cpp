@@ -4,8 +4,10 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <artist/image.hpp>
+#include <artist/surface_pool.hpp>
 
 #include "SkBitmap.h"
+#include "SkAndroidCodec.h"
 #include "SkCodec.h"
 #include "SkData.h"
 #include "SkImage.h"
@@ -13,13 +15,22 @@
 #include "SkSurface.h"
 #include "SkCanvas.h"
 #include "SkPictureRecorder.h"
+#include "SkRasterHandleAllocator.h"
 #include "SkStream.h"
+#include "SkImageEncoder.h"
 
 #include "opaque.hpp"
 #include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <map>
+#include <mutex>
+#include <new>
 #include <string>
+#include <unordered_set>
 #include <utility> // std::pair
+#include <vector>
 #include <iostream>
 
 using std::map;
@@ -39,6 +50,16 @@ namespace cycfi::artist
             return {SkAlphaType::kOpaque_SkAlphaType, SkColorType::kRGB_888x_SkColorType};
          case pixel_format::rgba32:
             return {SkAlphaType::kOpaque_SkAlphaType, SkColorType::kRGBA_8888_SkColorType};
+         case pixel_format::bgra32:
+            return {SkAlphaType::kUnpremul_SkAlphaType, SkColorType::kBGRA_8888_SkColorType};
+         case pixel_format::bgra32_premul:
+            return {SkAlphaType::kPremul_SkAlphaType, SkColorType::kBGRA_8888_SkColorType};
+         case pixel_format::rgba32_premul:
+            return {SkAlphaType::kPremul_SkAlphaType, SkColorType::kRGBA_8888_SkColorType};
+         case pixel_format::alpha8:
+            return {SkAlphaType::kPremul_SkAlphaType, SkColorType::kAlpha_8_SkColorType};
+         case pixel_format::rgba_f16:
+            return {SkAlphaType::kPremul_SkAlphaType, SkColorType::kRGBA_F16_SkColorType};
          default:
             return {SkAlphaType::kUnknown_SkAlphaType, SkColorType::kUnknown_SkColorType};
       }
@@ -46,29 +67,258 @@ namespace cycfi::artist
 
    image::image(extent size)
     : _impl{new artist::image_impl(size)}
-   {}
+   {
+      _impl->account();
+   }
 
-   image::image(fs::path const& path_)
-    : _impl{new artist::image_impl(SkBitmap{})}
+   namespace
    {
-      auto path = find_file(path_);
-      auto fail = [&path_]()
+      bool decode(sk_sp<SkData> data, SkBitmap& bitmap)
       {
-         throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+         std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(std::move(data));
+         if (!codec)
+            return false;
+         SkImageInfo info = codec->getInfo().makeColorType(kN32_SkColorType);
+
+         if (!bitmap.tryAllocPixels(info))
+            return false;
+
+         return codec->getPixels(info, bitmap.getPixels(), bitmap.rowBytes()) == SkCodec::kSuccess;
+      }
+
+      // Decode at reduced resolution and/or only a part of the image. This
+      // goes through SkAndroidCodec, which can downsample any format while
+      // decoding (JPEG, for one, scales in the DCT), and decode subsets
+      // without decoding, or allocating, the whole image first.
+      //
+      // If target is not empty, we use the largest sample size that still
+      // gives an image at least as big as the image scaled to fit target.
+      // If subset is not empty, only that part (in image coordinates) is
+      // decoded, at full resolution.
+      bool decode(sk_sp<SkData> data, SkBitmap& bitmap, extent target, rect subset)
+      {
+         auto codec = SkAndroidCodec::MakeFromData(std::move(data));
+         if (!codec)
+            return false;
+
+         auto const& src_info = codec->getInfo();
+         auto bounds = src_info.bounds();
+         SkAndroidCodec::AndroidOptions options;
+
+         SkIRect want = bounds;
+         SkIRect supported = bounds;
+         if (!subset.is_empty())
+         {
+            want = SkIRect::MakeLTRB(
+               std::floor(subset.left), std::floor(subset.top)
+             , std::ceil(subset.right), std::ceil(subset.bottom)
+            );
+            if (!want.intersect(bounds))
+               return false;
+
+            // The codec may need a slightly bigger subset (e.g. even
+            // offsets for WebP). We trim that off below.
+            supported = want;
+            if (!codec->getSupportedSubset(&supported))
+               return false;
+            options.fSubset = &supported;
+         }
+         else if (target.x > 0 && target.y > 0)
+         {
+            auto scale = std::min(target.x / bounds.width(), target.y / bounds.height());
+            if (scale < 1.0f)
+            {
+               SkISize size{
+                  std::max(1, int(std::ceil(bounds.width() * scale)))
+                , std::max(1, int(std::ceil(bounds.height() * scale)))
+               };
+               options.fSampleSize = codec->computeSampleSize(&size);
+            }
+         }
+
+         auto size = options.fSubset?
+            codec->getSampledSubsetDimensions(options.fSampleSize, supported) :
+            codec->getSampledDimensions(options.fSampleSize);
+         auto info = src_info.makeDimensions(size).makeColorType(kN32_SkColorType);
+
+         if (!bitmap.tryAllocPixels(info))
+            return false;
+
+         auto result = codec->getAndroidPixels(
+            info, bitmap.getPixels(), bitmap.rowBytes(), &options);
+         if (result != SkCodec::kSuccess)
+            return false;
+
+         if (want != supported)
+         {
+            SkBitmap trimmed;
+            if (!bitmap.extractSubset(&trimmed, want.makeOffset(-supported.left(), -supported.top())))
+               return false;
+            bitmap = trimmed;
+         }
+         return true;
+      }
+
+      // Decodes the file at path, as the image constructors do: whole if
+      // target and subset are empty, else as decode(data, bitmap, target,
+      // subset). MakeFromFileName memory-maps the file, so the codec reads
+      // the encoded bytes in place, without copying them into a buffer
+      // first.
+      image_impl::reload_function file_source(fs::path path, extent target, rect subset)
+      {
+         return
+            [path = std::move(path), target, subset](SkBitmap& bitmap)
+            {
+               sk_sp<SkData> data{SkData::MakeFromFileName(path.string().c_str())};
+               if (!data)
+                  return false;
+               if (subset.is_empty() && !(target.x > 0 && target.y > 0))
+                  return decode(std::move(data), bitmap);
+               return decode(std::move(data), bitmap, target, subset);
+            };
+      }
+
+      void load(image_impl& impl, fs::path const& path_, extent target, rect subset)
+      {
+         impl._source = file_source(find_file(path_), target, subset);
+         if (!impl._source(std::get<SkBitmap>(impl)))
+            throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+         impl.account();
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // The purgeable images, and the image_memory evictor that purges
+      // them, least recently drawn first (see image::purgeable).
+      /////////////////////////////////////////////////////////////////////////
+      struct purgeable_images
+      {
+                                 purgeable_images();
+                                 ~purgeable_images();
+
+         void                    evict(std::size_t bytes);
+
+         std::mutex              mutex;
+         std::unordered_set<image_impl*> images;
+         std::size_t             evictor_id;
       };
 
-      sk_sp<SkData> data{SkData::MakeFromFileName(path.string().c_str())};
-      std::unique_ptr<SkCodec> codec = SkCodec::MakeFromData(data);
-      if (!codec)
-         fail();
-      SkImageInfo info = codec->getInfo().makeColorType(kN32_SkColorType);
+      purgeable_images::purgeable_images()
+       : evictor_id{add_image_evictor([this](std::size_t bytes) { evict(bytes); })}
+      {
+      }
 
-      auto& bitmap = std::get<SkBitmap>(*_impl);
-      if (!bitmap.tryAllocPixels(info))
-         fail();
+      purgeable_images::~purgeable_images()
+      {
+         remove_image_evictor(evictor_id);
+      }
 
-      if (codec->getPixels(info, bitmap.getPixels(), bitmap.rowBytes()) != SkCodec::kSuccess)
-         fail();
+      void purgeable_images::evict(std::size_t bytes)
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         std::vector<image_impl*> by_use(images.begin(), images.end());
+         std::sort(by_use.begin(), by_use.end(),
+            [](image_impl const* a, image_impl const* b)
+            {
+               return a->_last_use < b->_last_use;
+            }
+         );
+
+         std::size_t purged = 0;
+         for (auto impl : by_use)
+         {
+            if (purged >= bytes)
+               break;
+            purged += impl->purge();
+         }
+      }
+
+      purgeable_images& purgeables()
+      {
+         static purgeable_images images;
+         return images;
+      }
+
+      // Before the image is destroyed or replaced
+      void forget_purgeable(image_impl& impl)
+      {
+         if (impl._purgeable)
+         {
+            auto& registry = purgeables();
+            std::lock_guard<std::mutex> lock{registry.mutex};
+            registry.images.erase(&impl);
+         }
+      }
+
+      // A purgeable image keeps its pixels in the snapshot alone (see
+      // image_impl::snapshot); the bitmap keeps its info. Making it not
+      // purgeable again decodes it if needed, and copies the pixels back
+      // into the bitmap, where they can be written.
+      void make_purgeable(image_impl& impl, bool flag)
+      {
+         auto bitmap = std::get_if<SkBitmap>(&impl.base());
+         if (!bitmap || !impl._source || impl._purgeable == flag)
+            return;
+
+         if (flag)
+         {
+            {
+               std::lock_guard<std::mutex> lock{impl._cache_mutex};
+               bitmap->setImmutable();
+               impl._snapshot = bitmap->asImage(); // Shares the pixels
+               impl._mipmaps.reset();              // Made from a copy
+               bitmap->setPixelRef(nullptr, 0, 0);
+               impl._purgeable = true;
+            }
+            auto& registry = purgeables();
+            std::lock_guard<std::mutex> lock{registry.mutex};
+            registry.images.insert(&impl);
+         }
+         else
+         {
+            forget_purgeable(impl);
+            std::lock_guard<std::mutex> lock{impl._cache_mutex};
+            impl.reload();
+            SkBitmap pixels;
+            if (impl._snapshot && pixels.tryAllocPixels(bitmap->info(), bitmap->rowBytes()))
+               impl._snapshot->readPixels(pixels.pixmap(), 0, 0);
+            else
+               pixels.setInfo(bitmap->info(), bitmap->rowBytes());
+            *bitmap = pixels;
+            impl._snapshot.reset();
+            impl._mipmaps.reset();
+            impl._purgeable = false;
+         }
+         impl.account();
+      }
+   }
+
+   image::image(fs::path const& path_)
+    : _impl{new artist::image_impl(SkBitmap{})}
+   {
+      load(*_impl, path_, {}, {});
+   }
+
+   image::image(fs::path const& path_, extent target)
+    : _impl{new artist::image_impl(SkBitmap{})}
+   {
+      load(*_impl, path_, target, {});
+   }
+
+   image::image(fs::path const& path_, rect subset)
+    : _impl{new artist::image_impl(SkBitmap{})}
+   {
+      if (subset.is_empty())
+         throw std::runtime_error{"Error: Failed to load file: " + path_.string()};
+      load(*_impl, path_, {}, subset);
+   }
+
+   image::image(uint8_t const* encoded, size_t size)
+    : _impl{new artist::image_impl(SkBitmap{})}
+   {
+      // We decode right away, so the encoded bytes need not be copied
+      if (!decode(SkData::MakeWithoutCopy(encoded, size), std::get<SkBitmap>(*_impl)))
+         throw std::runtime_error{"Error: Failed to decode image data"};
+      _impl->account();
    }
 
    image::image(uint8_t const* data, pixel_format fmt, extent size)
@@ -91,13 +341,68 @@ namespace cycfi::artist
          throw std::runtime_error{"Error: Failed to initialize image from pixel buffer"};
 
       memcpy(bitmap.getPixels(), data, _pixmap_size(fmt, size));
+      _impl->account();
+   }
+
+   image::image(
+      uint8_t* data, pixel_format fmt, extent size
+    , size_t row_bytes, image_release_function release
+   )
+    : _impl{new artist::image_impl(SkBitmap{})}
+   {
+      // release is called when the pixels are no longer referenced, or
+      // right away if we fail.
+      auto context = release? new image_release_function(std::move(release)) : nullptr;
+      auto release_proc = [](void* /* pixels */, void* context)
+      {
+         if (auto f = static_cast<image_release_function*>(context))
+         {
+            (*f)();
+            delete f;
+         }
+      };
+
+      auto fail = [this]()
+      {
+         delete _impl;
+         throw std::runtime_error{"Error: Failed to initialize image from pixel buffer"};
+      };
+
+      auto [alpha_fmt, byte_fmt] = _map_img_fmt_to_api_type(fmt);
+      if (byte_fmt == kUnknown_SkColorType)
+      {
+         release_proc(data, context);
+         fail();
+      }
+
+      auto info = SkImageInfo::Make(size.x, size.y, byte_fmt, alpha_fmt);
+      if (row_bytes == 0)
+         row_bytes = info.minRowBytes();
+
+      auto& bitmap = std::get<SkBitmap>(*_impl);
+      if (!bitmap.installPixels(info, data, row_bytes, release_proc, context))
+         fail();
+      _impl->_borrowed = true;
+      _impl->account();
    }
 
    image::~image()
    {
+      if (_impl)
+         forget_purgeable(*_impl);
       delete _impl;
    }
 
+   void image::purgeable(bool flag)
+   {
+      make_purgeable(*_impl, flag);
+   }
+
+   bool image::purgeable() const
+   {
+      return _impl->_purgeable;
+   }
+
    image_impl_ptr image::impl() const
    {
       return _impl;
@@ -127,79 +432,226 @@ namespace cycfi::artist
       return std::visit(get_size, _impl->base());
    }
 
-   void image::save_png(std::string_view path_) const
+   namespace
    {
-      std::string path{path_};
-      auto fail = [&path]()
+      // Writes straight into a vector, so the encoded bytes are not copied
+      // again from an SkData.
+      class vector_wstream : public SkWStream
       {
-         throw std::runtime_error{"Error: Failed to save file: " + path};
+      public:
+
+         vector_wstream(std::vector<std::uint8_t>& out)
+          : _out{out}
+         {}
+
+         bool write(void const* buffer, size_t size) override
+         {
+            auto p = static_cast<std::uint8_t const*>(buffer);
+            _out.insert(_out.end(), p, p + size);
+            return true;
+         }
+
+         size_t bytesWritten() const override
+         {
+            return _out.size();
+         }
+
+      private:
+
+         std::vector<std::uint8_t>& _out;
       };
 
-      auto size_ = size();
-      sk_sp<SkSurface> surface = SkSurface::MakeRasterN32Premul(size_.x, size_.y);
-      SkCanvas* sk_canvas = surface->getCanvas();
+      // Gives the layers of a raster canvas pixels borrowed from the
+      // surface_pool. Skia does not clear the pixels of layers it did not
+      // allocate itself, so they are cleared here.
+      class pooled_layer_allocator : public SkRasterHandleAllocator
+      {
+      public:
 
-      auto draw_picture =
-         [&](auto const& that)
+         bool allocHandle(SkImageInfo const& info, Rec* rec) override
          {
-            using T = std::decay_t<decltype(that)>;
-            if constexpr(std::is_same_v<T, extent>)
+            auto row_bytes = info.minRowBytes();
+            auto bytes = info.computeByteSize(row_bytes);
+            if (info.isEmpty() || SkImageInfo::ByteSizeOverflowed(bytes))
+               return false;
+
+            pooled_buffer* buf;
+            try
             {
+               buf = new pooled_buffer{surface_pool::acquire(bytes)};
             }
-            if constexpr(std::is_same_v<T, sk_sp<SkPicture>>)
+            catch (std::bad_alloc const&)
             {
-               sk_canvas->drawPicture(that);
+               return false;
             }
-            if constexpr(std::is_same_v<T, SkBitmap>)
+            std::memset(buf->data(), 0, bytes);
+            rec->fReleaseProc = [](void*, void* ctx)
+            {
+               delete static_cast<pooled_buffer*>(ctx);
+            };
+            rec->fReleaseCtx = buf;
+            rec->fPixels = buf->data();
+            rec->fRowBytes = row_bytes;
+            rec->fHandle = buf;
+            return true;
+         }
+
+         void updateHandle(Handle, SkMatrix const&, SkIRect const&) override
+         {
+         }
+      };
+
+      // Installs pixels borrowed from the surface_pool into the bitmap.
+      // They go back to the pool when the bitmap's pixel ref is freed.
+      bool alloc_pooled_pixels(SkBitmap& bitmap, extent size)
+      {
+         auto info = SkImageInfo::MakeN32Premul(size.x, size.y);
+         if (info.isEmpty())
+            return false;
+         auto buf = new pooled_buffer{surface_pool::acquire(info.computeMinByteSize())};
+         return bitmap.installPixels(
+            info, buf->data(), info.minRowBytes()
+          , [](void*, void* ctx)
             {
-               sk_canvas->drawImage(that.asImage(), 0, 0);
+               delete static_cast<pooled_buffer*>(ctx);
             }
-         };
+          , buf
+         );
+      }
 
-      std::visit(draw_picture, _impl->base());
+      // The image as raster pixels. Bitmaps are shared as they are (no
+      // copy), as are the pixels of purgeable images, decoded again if
+      // needed. Pictures are played back into a bitmap, with its pixels
+      // borrowed from the surface_pool.
+      SkBitmap raster(image_impl& impl, extent size)
+      {
+         auto get_bitmap =
+            [&](auto const& that) -> SkBitmap
+            {
+               using T = std::decay_t<decltype(that)>;
+               if constexpr(std::is_same_v<T, SkBitmap>)
+               {
+                  if (!impl._purgeable)
+                     return that;
+                  SkBitmap bitmap;
+                  if (auto img = impl.snapshot())
+                     img->asLegacyBitmap(&bitmap);
+                  return bitmap;
+               }
+               else
+               {
+                  SkBitmap bitmap;
+                  if (!alloc_pooled_pixels(bitmap, size))
+                     return {};
+                  bitmap.eraseColor(SK_ColorTRANSPARENT);
+                  if constexpr(std::is_same_v<T, sk_sp<SkPicture>>)
+                  {
+                     auto cnv = make_pooled_canvas(bitmap.pixmap());
+                     if (!cnv)
+                        return {};
+                     cnv->drawPicture(that);
+                  }
+                  return bitmap;
+               }
+            };
+
+         return std::visit(get_bitmap, impl.base());
+      }
 
-      // Make a PNG encoded image using the canvas
-      sk_sp<SkImage> image(surface->makeImageSnapshot());
-      if (!image)
-         fail();
+      bool encode(
+         image_impl& impl, extent size, image_format format
+       , int quality, SkWStream& out)
+      {
+         auto bitmap = raster(impl, size);
+         SkPixmap pixmap;
+         if (!bitmap.peekPixels(&pixmap))
+            return false;
 
-      sk_sp<SkData> png(image->encodeToData());
-      if (!png)
-         fail();
+         if (format == image_format::raw)
+         {
+            auto info = SkImageInfo::Make(
+               pixmap.width(), pixmap.height(), kRGBA_8888_SkColorType, kPremul_SkAlphaType);
+            std::vector<std::uint8_t> pixels(info.computeMinByteSize());
+            if (!pixmap.readPixels(info, pixels.data(), info.minRowBytes()))
+               return false;
+            return out.write(pixels.data(), pixels.size());
+         }
 
-      // write the data to the file specified by filePath
-      SkFILEWStream out(path.c_str());
-      out.write(png->data(), png->size());
+         SkEncodedImageFormat fmt = SkEncodedImageFormat::kPNG;
+         switch (format)
+         {
+            case image_format::jpeg:   fmt = SkEncodedImageFormat::kJPEG; break;
+            case image_format::webp:   fmt = SkEncodedImageFormat::kWEBP; break;
+            default:                   break;
+         }
+         return SkEncodeImage(&out, pixmap, fmt, std::clamp(quality, 0, 100));
+      }
    }
 
-   uint32_t* image::pixels()
+   std::unique_ptr<SkCanvas> make_pooled_canvas(SkPixmap const& pixels)
    {
-      auto get_pixels =
-         [&](auto const& that) -> uint32_t*
-         {
-            using T = std::decay_t<decltype(that)>;
-            if constexpr(std::is_same_v<T, SkBitmap>)
-               return reinterpret_cast<uint32_t*>(that.getPixels());
-            else
-               return nullptr;
-         };
+      if (!pixels.addr())
+         return nullptr;
+
+      // The base layer is the caller's: it is not released
+      SkRasterHandleAllocator::Rec base;
+      base.fReleaseProc = [](void*, void*) {};
+      base.fReleaseCtx = nullptr;
+      base.fPixels = pixels.writable_addr();
+      base.fRowBytes = pixels.rowBytes();
+      base.fHandle = pixels.writable_addr();
+      return SkRasterHandleAllocator::MakeCanvas(
+         std::make_unique<pooled_layer_allocator>(), pixels.info(), &base);
+   }
+
+   std::vector<std::uint8_t> image::encode(image_format format, int quality) const
+   {
+      std::vector<std::uint8_t> data;
+      vector_wstream out{data};
+      if (!artist::encode(*_impl, size(), format, quality, out))
+         throw std::runtime_error{"Error: Failed to encode image."};
+      return data;
+   }
+
+   void image::save(fs::path const& path, image_format format, int quality) const
+   {
+      SkFILEWStream out(path.string().c_str());
+      if (!out.isValid() || !artist::encode(*_impl, size(), format, quality, out))
+         throw std::runtime_error{"Error: Failed to save file: " + path.string()};
+   }
+
+   void image::save_png(std::string_view path) const
+   {
+      save(fs::path{std::string{path}}, image_format::png);
+   }
 
-      return std::visit(get_pixels, _impl->base());
+   uint32_t* image::pixels()
+   {
+      return reinterpret_cast<uint32_t*>(bytes());
    }
 
    uint32_t const* image::pixels() const
    {
-      auto get_pixels =
-         [&](auto const& that) -> uint32_t const*
-         {
-            using T = std::decay_t<decltype(that)>;
-            if constexpr(std::is_same_v<T, SkBitmap>)
-               return reinterpret_cast<uint32_t const*>(that.getPixels());
-            else
-               return nullptr;
-         };
+      return reinterpret_cast<uint32_t const*>(bytes());
+   }
 
-      return std::visit(get_pixels, _impl->base());
+   std::uint8_t* image::bytes()
+   {
+      make_purgeable(*_impl, false);
+      auto bitmap = std::get_if<SkBitmap>(&_impl->base());
+      return bitmap? static_cast<std::uint8_t*>(bitmap->getPixels()) : nullptr;
+   }
+
+   std::uint8_t const* image::bytes() const
+   {
+      make_purgeable(*_impl, false);
+      auto bitmap = std::get_if<SkBitmap>(&_impl->base());
+      return bitmap? static_cast<std::uint8_t const*>(bitmap->getPixels()) : nullptr;
+   }
+
+   void image::pixels_changed()
+   {
+      _impl->pixels_changed();
    }
 
    extent image::bitmap_size() const
@@ -217,17 +669,58 @@ namespace cycfi::artist
       return std::visit(get_size, _impl->base());
    }
 
+   pixel_format image::format() const
+   {
+      auto bitmap = std::get_if<SkBitmap>(&_impl->base());
+      if (!bitmap)
+         return pixel_format::invalid;
+
+      // The reverse of _map_img_fmt_to_api_type
+      auto alpha = bitmap->alphaType();
+      switch (bitmap->colorType())
+      {
+         case kGray_8_SkColorType:     return pixel_format::gray8;
+         case kRGB_565_SkColorType:    return pixel_format::rgb16;
+         case kRGB_888x_SkColorType:   return pixel_format::rgb32;
+         case kAlpha_8_SkColorType:    return pixel_format::alpha8;
+         case kRGBA_F16_SkColorType:   return pixel_format::rgba_f16;
+         case kRGBA_8888_SkColorType:
+            if (alpha == kOpaque_SkAlphaType)
+               return pixel_format::rgba32;
+            if (alpha == kPremul_SkAlphaType)
+               return pixel_format::rgba32_premul;
+            return pixel_format::invalid;
+         case kBGRA_8888_SkColorType:
+            return alpha == kUnpremul_SkAlphaType?
+               pixel_format::bgra32 : pixel_format::bgra32_premul;
+         default:
+            return pixel_format::invalid;
+      }
+   }
+
+   std::size_t image::row_bytes() const
+   {
+      auto bitmap = std::get_if<SkBitmap>(&_impl->base());
+      return bitmap? bitmap->rowBytes() : 0;
+   }
+
    size_t image::_pixmap_size(pixel_format fmt, extent size)
    {
       size_t fmt_bytes_per_pixel = ([&fmt]() {
          switch (fmt) {
             case pixel_format::gray8:
+            case pixel_format::alpha8:
                return 1;
             case pixel_format::rgb16:
                return 2;
             case pixel_format::rgb32:
             case pixel_format::rgba32:
+            case pixel_format::bgra32:
+            case pixel_format::bgra32_premul:
+            case pixel_format::rgba32_premul:
                return 4;
+            case pixel_format::rgba_f16:
+               return 8;
             default:
                return 0;
          }
@@ -251,7 +744,15 @@ namespace cycfi::artist
 
    offscreen_image::~offscreen_image()
    {
-      *(_image.impl()) = _state->recorder.finishRecordingAsPicture();
+      auto& impl = *_image.impl();
+      forget_purgeable(impl);
+      impl._purgeable = false;
+      impl._source = nullptr;
+      impl.base() = _state->recorder.finishRecordingAsPicture();
+      impl._borrowed = false;
+      impl._snapshot.reset();
+      impl._mipmaps.reset();
+      impl.account();
       delete _state;
    }
 
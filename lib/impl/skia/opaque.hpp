@@ -8,6 +8,16 @@
 
 #include "SkImage.h"
 #include "SkBitmap.h"
+#include "SkCanvas.h"
+#include "SkPixelRef.h"
+#include "SkPicture.h"
+#include "SkPixmap.h"
+#include <artist/image_memory.hpp>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <variant>
 
 namespace cycfi::artist
@@ -20,10 +30,203 @@ namespace cycfi::artist
 
       using base_type = image_impl_variant;
       using base_type::base_type;
+      using reload_function = std::function<bool(SkBitmap&)>;
+                        ~image_impl();
 
       base_type&        base() { return *this; }
       base_type const&  base() const { return *this; }
+
+      sk_sp<SkImage>    snapshot();
+      sk_sp<SkImage>    mipmapped();
+      void              pixels_changed();
+      void              account();
+      std::size_t       purge();
+      bool              reload();
+
+      bool              _borrowed = false;    // Pixels are caller owned
+      bool              _purgeable = false;   // Pixels are only in _snapshot
+      reload_function   _source;              // Decodes the file again
+      std::atomic<std::uint64_t> _last_use{0};  // Of a purgeable image
+      sk_sp<SkImage>    _snapshot;
+      sk_sp<SkImage>    _mipmaps;
+      image_memory_stats _accounted;          // As last reported
+      std::mutex        _cache_mutex;         // For drawing from many threads
    };
+
+   // A raster canvas that draws into the given pixels. The pixels of its
+   // layers (see canvas::begin_layer) are borrowed from the surface_pool,
+   // instead of being allocated by Skia for each saveLayer. Returns null
+   // if the pixels cannot be drawn into.
+   std::unique_ptr<SkCanvas> make_pooled_canvas(SkPixmap const& pixels);
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline image_impl::~image_impl()
+   {
+      detail::update_image_memory(_accounted, {});
+   }
+
+   // Returns an SkImage for drawing the bitmap. asImage() copies bitmaps
+   // that own their (mutable) pixels, every time, so that writes through
+   // image::pixels() always show. Borrowed pixels are shared, without a
+   // copy, and the SkImage is kept until pixels_changed(). The SkImage
+   // holds a reference to the pixels, so the caller's release function is
+   // not called while anything still draws from it.
+   //
+   // The pixels of purgeable images (see image::purgeable) are kept in
+   // the SkImage alone, and decoded again from their file after purge().
+   //
+   // The cached SkImages are guarded by _cache_mutex, so the same image
+   // may be drawn by several threads at once.
+   inline sk_sp<SkImage> image_impl::snapshot()
+   {
+      auto const& bitmap = std::get<SkBitmap>(*this);
+      if (!_borrowed && !_purgeable)
+         return bitmap.asImage();
+
+      bool reloaded = false;
+      sk_sp<SkImage> snapshot;
+      {
+         std::lock_guard<std::mutex> lock{_cache_mutex};
+         if (_purgeable)
+         {
+            static std::atomic<std::uint64_t> clock{0};
+            _last_use = ++clock;
+            reloaded = reload();
+         }
+         else if (!_snapshot)
+         {
+            auto pixel_ref = SkSafeRef(bitmap.pixelRef());
+            _snapshot = SkImage::MakeFromRaster(
+               bitmap.pixmap()
+             , [](void const*, SkImage::ReleaseContext ctx)
+               {
+                  static_cast<SkPixelRef*>(ctx)->unref();
+               }
+             , pixel_ref
+            );
+            if (!_snapshot)
+               SkSafeUnref(pixel_ref);
+         }
+         snapshot = _snapshot;
+      }
+      if (reloaded)
+         account();
+      return snapshot;
+   }
+
+   // Decodes a purged image again. The bitmap keeps the image info only.
+   // Called with _cache_mutex held. Returns true if it decoded.
+   inline bool image_impl::reload()
+   {
+      if (_snapshot || !_source)
+         return false;
+
+      SkBitmap decoded;
+      if (!_source(decoded))
+         return false;
+      decoded.setImmutable();       // So that asImage shares the pixels
+      _snapshot = decoded.asImage();
+      return _snapshot != nullptr;
+   }
+
+   // Drops the decoded pixels (and mip chain) of a purgeable image, unless
+   // it is being drawn or changed right now. Memory is given back once
+   // anything still drawing from them is done. Returns the bytes dropped.
+   inline std::size_t image_impl::purge()
+   {
+      std::size_t bytes = 0;
+      {
+         std::unique_lock<std::mutex> lock{_cache_mutex, std::try_to_lock};
+         if (!lock.owns_lock() || !_purgeable || !_snapshot)
+            return 0;
+         bytes = std::get<SkBitmap>(*this).computeByteSize();
+         if (_mipmaps)
+            bytes += bytes / 3;
+         _snapshot.reset();
+         _mipmaps.reset();
+      }
+      account();
+      return bytes;
+   }
+
+   // Returns an SkImage of the bitmap with its mip chain. Building the
+   // chain costs about a third of the image size again, so it is done on
+   // first use and kept until pixels_changed().
+   inline sk_sp<SkImage> image_impl::mipmapped()
+   {
+      {
+         std::lock_guard<std::mutex> lock{_cache_mutex};
+         if (_mipmaps)
+            return _mipmaps;
+      }
+
+      auto img = snapshot();
+      auto mipmaps = img? img->withDefaultMipmaps() : nullptr;
+      {
+         std::lock_guard<std::mutex> lock{_cache_mutex};
+         if (_purgeable && !_snapshot)
+            return mipmaps;   // Purged meanwhile: use it this time only
+         if (!_mipmaps)       // Else another thread built it first
+            _mipmaps = std::move(mipmaps);
+         mipmaps = _mipmaps;
+      }
+      account();
+      return mipmaps;
+   }
+
+   // The pixels of a purgeable image are in _snapshot alone, and are not
+   // written: bytes() makes the image an ordinary one first. So they are
+   // kept, with their mip chain.
+   inline void image_impl::pixels_changed()
+   {
+      if (_purgeable)
+         return;
+      if (auto bitmap = std::get_if<SkBitmap>(this))
+      {
+         bitmap->notifyPixelsChanged();
+         bool had_cached;
+         {
+            std::lock_guard<std::mutex> lock{_cache_mutex};
+            had_cached = _mipmaps != nullptr;
+            _snapshot.reset();
+            _mipmaps.reset();
+         }
+         if (had_cached)
+            account();
+      }
+   }
+
+   // Reports the memory held by this image (see image_memory). The
+   // snapshot of borrowed pixels shares them, so it costs nothing; that of
+   // a purgeable image holds its only pixels. The mip chain costs a third
+   // of the pixels, plus a full copy of them when the snapshot does not
+   // share them (see snapshot).
+   inline void image_impl::account()
+   {
+      image_memory_stats before, now;
+      now.images = 1;
+      {
+         std::lock_guard<std::mutex> lock{_cache_mutex};
+         if (auto bitmap = std::get_if<SkBitmap>(this))
+         {
+            bool has_pixels = _purgeable? _snapshot != nullptr : !bitmap->drawsNothing();
+            auto bytes = has_pixels? bitmap->computeByteSize() : 0;
+            (_borrowed? now.borrowed_bytes : now.bitmap_bytes) = bytes;
+            if (_mipmaps)
+               now.cached_bytes = (_borrowed || _purgeable? 0 : bytes) + bytes / 3;
+         }
+         else if (auto picture = std::get_if<sk_sp<SkPicture>>(this))
+         {
+            if (*picture)
+               now.picture_bytes = (*picture)->approximateBytesUsed();
+         }
+         before = _accounted;
+         _accounted = now;
+      }
+      detail::update_image_memory(before, now);
+   }
 }
 
 #endif
\ No newline at end of file
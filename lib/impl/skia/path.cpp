@@ -127,6 +127,31 @@ namespace cycfi::artist
       _impl->cubicTo(cp1.x, cp1.y, cp2.x, cp2.y, end.x, end.y);
    }
 
+   void path::append(
+      path_verb const verbs[], std::size_t num_verbs
+    , point const points[], std::size_t num_points)
+   {
+      static_assert(sizeof(point) == sizeof(SkPoint));
+      static_assert(sizeof(path_verb) == sizeof(uint8_t));
+      static_assert(int(path_verb::move) == int(SkPathVerb::kMove));
+      static_assert(int(path_verb::line) == int(SkPathVerb::kLine));
+      static_assert(int(path_verb::quad) == int(SkPathVerb::kQuad));
+      static_assert(int(path_verb::cubic) == int(SkPathVerb::kCubic));
+      static_assert(int(path_verb::close) == int(SkPathVerb::kClose));
+
+      auto data = SkPath::Make(
+         reinterpret_cast<SkPoint const*>(points), int(num_points)
+       , reinterpret_cast<uint8_t const*>(verbs), int(num_verbs)
+       , nullptr, 0
+       , _impl->getFillType()
+      );
+
+      if (_impl->isEmpty())
+         *_impl = std::move(data);
+      else
+         _impl->addPath(data);
+   }
+
    void path::fill_rule(fill_rule_enum rule)
    {
       _impl->setFillType(rule == fill_winding? SkPathFillType::kWinding : SkPathFillType::kEvenOdd);
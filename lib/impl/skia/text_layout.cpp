@@ -9,6 +9,8 @@
 #include <artist/canvas.hpp>
 #include <infra/utf8_utils.hpp>
 #include <vector>
+#include <algorithm>
+#include <optional>
 #include <SkFont.h>
 #include <SkTextBlob.h>
 #include <SkCanvas.h>
@@ -44,11 +46,14 @@ namespace cycfi::artist
          break_enum              word : 4;
       };
 
+      void                       flow(float width, bool justify);
       void                       flow(get_line_info const& glf, flow_info finfo);
       void                       draw(canvas& cnv, point p, color c);
       point                      caret_point(std::size_t index) const;
       std::size_t                caret_index(point p) const;
 
+      void                       replace(std::size_t pos, std::size_t count, std::u32string_view utf32);
+
       std::size_t                num_lines() const;
       font&                      get_font();
       std::u32string_view        get_text() const;
@@ -60,21 +65,106 @@ namespace cycfi::artist
 
       using line_vector = std::vector<row_info>;
 
+      struct glyph_info
+      {
+         SkGlyphID               id;
+         std::size_t             cluster;       // Index into _text
+         float                   advance;
+         float                   offset;
+      };
+
+      // Paragraphs end with a '\n', or at the end of the text. They are
+      // shaped and broken separately, so that edits need only redo the
+      // paragraphs they touch.
+      struct paragraph_info
+      {
+         std::size_t             text_start;
+         std::size_t             glyph_start;
+      };
+
+      struct analysis
+      {
+         std::vector<glyph_info>       glyphs;
+         std::vector<std::size_t>      glyph_indices;
+         std::vector<break_info>       breaks;
+         std::vector<paragraph_info>   paragraphs;
+      };
+
+      // The glyphs changed since the last flow: [glyph_start, glyph_end)
+      // replaced what were glyph_delta fewer glyphs. The rows of the last
+      // flow are kept here, out of _rows, until the next flow reuses them;
+      // they no longer match the glyphs.
+      struct edit_info
+      {
+         std::size_t             glyph_start;
+         std::size_t             glyph_end;
+         std::ptrdiff_t          glyph_delta;
+         line_vector             rows;
+      };
+
+      struct flow_params
+      {
+         float                   width;
+         bool                    justify;
+      };
+
+      void                       analyze(
+                                    std::size_t first, std::size_t last
+                                  , std::size_t glyph_start, analysis& result) const;
+      bool                       reflow(
+                                    get_line_info const& glf, flow_info finfo
+                                  , std::size_t first, std::size_t last);
+      std::size_t                paragraph_index(std::size_t pos) const;
+      std::size_t                glyph_index(std::size_t index) const;
+      bool                       update_properties();
+
       class font                 _font;
       detail::hb_font            _hb_font;
       std::u32string             _text;
-      detail::hb_buffer          _buff;
+      std::vector<glyph_info>    _glyphs;
+      std::vector<std::size_t>   _glyph_indices;   // By text index, -1 inside clusters
+      std::vector<paragraph_info> _paragraphs;
+      hb_segment_properties_t    _props;           // Of the whole text
       line_vector                _rows;
       SkPaint                    _paint;
       std::vector<break_info>    _breaks;
+      std::optional<edit_info>   _edit;
+      std::optional<flow_params> _flowed;
    };
 
+   namespace
+   {
+      // The segment properties HarfBuzz would guess for the whole text:
+      // those of its first character with a script of its own (see
+      // hb_buffer_guess_segment_properties)
+      hb_segment_properties_t guess_properties(std::u32string_view text)
+      {
+         auto funcs = hb_unicode_funcs_get_default();
+         auto i = std::find_if(text.begin(), text.end(),
+            [funcs](char32_t ch)
+            {
+               auto script = hb_unicode_script(funcs, ch);
+               return script != HB_SCRIPT_COMMON
+                  && script != HB_SCRIPT_INHERITED
+                  && script != HB_SCRIPT_UNKNOWN;
+            }
+         );
+         auto first = (i == text.end())? text.substr(0, 0) : text.substr(i - text.begin(), 1);
+         return detail::hb_buffer{first}.segment_properties();
+      }
+
+      template <typename T>
+      void splice(std::vector<T>& v, std::size_t first, std::size_t last, std::vector<T> const& with)
+      {
+         v.erase(v.begin() + first, v.begin() + last);
+         v.insert(v.begin() + first, with.begin(), with.end());
+      }
+   }
+
    text_layout::impl::impl(font const& font_, std::u32string_view utf32)
     : _font{font_}
     , _hb_font(_font.impl()->getTypeface())
     , _text{utf32}
-    , _buff{_text}
-    , _breaks{utf32.size(), break_info{}}
    {
       struct init_linebreak_
       {
@@ -89,62 +179,287 @@ namespace cycfi::artist
       _paint.setAntiAlias(true);
       _paint.setStyle(SkPaint::kFill_Style);
 
-      _buff.shape(_hb_font);
+      _props = guess_properties(_text);
+      analysis result;
+      analyze(0, _text.size(), 0, result);
+      _glyphs = std::move(result.glyphs);
+      _glyph_indices = std::move(result.glyph_indices);
+      _breaks = std::move(result.breaks);
+      _paragraphs = std::move(result.paragraphs);
+   }
 
-      std::string lbrks(_text.size(), 0);
-      set_linebreaks_utf32(
-         (utf32_t const*)_text.data()
-         , _text.size(), _buff.language(), lbrks.data()
-      );
+   text_layout::impl::~impl()
+   {
+   }
 
-      std::string wbrks(_text.size(), 0);
-      set_wordbreaks_utf32(
-         (utf32_t const*)_text.data()
-         , _text.size(), _buff.language(), wbrks.data()
-      );
+   // Shapes and breaks the paragraphs in _text[first, last). The glyphs
+   // and paragraphs start at glyph_start.
+   void text_layout::impl::analyze(
+      std::size_t first, std::size_t last
+    , std::size_t glyph_start, analysis& result) const
+   {
+      int hb_scalex, hb_scaley;
+      hb_font_get_scale(_hb_font.get(), &hb_scalex, &hb_scaley);
+      auto sc_font = _font.impl();
+      float scalex = (sc_font->getSize() / hb_scalex) * sc_font->getScaleX();
 
-      for (std::size_t i = 0; i != _breaks.size(); ++i)
+      result.glyph_indices.assign(last - first, -1);
+      result.breaks.reserve(last - first);
+      for (auto start = first; start != last;)
       {
-         auto info = break_info{};
-         switch (lbrks[i])
+         auto end = _text.find(U'\n', start);
+         end = (end < last)? end + 1 : last;
+         std::u32string_view para{_text.data() + start, end - start};
+         result.paragraphs.push_back({start, glyph_start + result.glyphs.size()});
+
+         // With the script and direction of the whole text, not guessed
+         // for the paragraph alone
+         detail::hb_buffer buff{para};
+         buff.segment_properties(_props);
+         buff.shape(_hb_font);
+         auto glyphs_info = buff.glyphs();
+         for (unsigned i = 0; i != glyphs_info.count; ++i)
          {
-            case LINEBREAK_MUSTBREAK:  info.line = must_break;    break;
-            case LINEBREAK_ALLOWBREAK: info.line = allow_break;   break;
-            case LINEBREAK_NOBREAK:    info.line = no_break;      break;
-            default:                   info.line = indeterminate; break;
+            auto cluster = start + glyphs_info.glyphs[i].cluster;
+            result.glyph_indices[cluster - first] = glyph_start + result.glyphs.size();
+            result.glyphs.push_back(
+               glyph_info{
+                  SkGlyphID(glyphs_info.glyphs[i].codepoint)
+                  , cluster
+                  , glyphs_info.positions[i].x_advance * scalex
+                  , glyphs_info.positions[i].x_offset * scalex
+               }
+            );
          }
-         switch (wbrks[i])
+
+         std::string lbrks(para.size(), 0);
+         set_linebreaks_utf32(
+            (utf32_t const*)para.data()
+            , para.size(), buff.language(), lbrks.data()
+         );
+
+         std::string wbrks(para.size(), 0);
+         set_wordbreaks_utf32(
+            (utf32_t const*)para.data()
+            , para.size(), buff.language(), wbrks.data()
+         );
+
+         for (std::size_t i = 0; i != para.size(); ++i)
          {
-            case WORDBREAK_BREAK:      info.word = allow_break;   break;
-            case WORDBREAK_NOBREAK:    info.word = no_break;      break;
-            default:                   info.word = indeterminate; break;
+            auto info = break_info{};
+            switch (lbrks[i])
+            {
+               case LINEBREAK_MUSTBREAK:  info.line = must_break;    break;
+               case LINEBREAK_ALLOWBREAK: info.line = allow_break;   break;
+               case LINEBREAK_NOBREAK:    info.line = no_break;      break;
+               default:                   info.line = indeterminate; break;
+            }
+            switch (wbrks[i])
+            {
+               case WORDBREAK_BREAK:      info.word = allow_break;   break;
+               case WORDBREAK_NOBREAK:    info.word = no_break;      break;
+               default:                   info.word = indeterminate; break;
+            }
+            result.breaks.push_back(info);
          }
-         _breaks[i] = info;
+
+         // The '\n' is a hard break, unless it ends the text. Broken on
+         // its own, the paragraph sees it as the end.
+         if (end != _text.size())
+            result.breaks.back().line = must_break;
+         start = end;
       }
    }
 
-   text_layout::impl::~impl()
+   // Returns the paragraph with the text index pos, or the last one
+   std::size_t text_layout::impl::paragraph_index(std::size_t pos) const
+   {
+      auto i = std::upper_bound(_paragraphs.begin(), _paragraphs.end(), pos,
+         [](std::size_t pos, auto const& para)
+         {
+            return pos < para.text_start;
+         }
+      );
+      return (i == _paragraphs.begin())? 0 : (i - _paragraphs.begin()) - 1;
+   }
+
+   // Returns the glyph of the cluster starting at the text index, or -1
+   std::size_t text_layout::impl::glyph_index(std::size_t index) const
+   {
+      return (index < _glyph_indices.size())? _glyph_indices[index] : -1;
+   }
+
+   // Guesses the segment properties of the text again. Returns true if
+   // they changed, and every paragraph must be shaped again.
+   bool text_layout::impl::update_properties()
+   {
+      auto props = guess_properties(_text);
+      if (hb_segment_properties_equal(&props, &_props))
+         return false;
+      _props = props;
+      return true;
+   }
+
+   void text_layout::impl::replace(std::size_t pos, std::size_t count, std::u32string_view utf32)
+   {
+      auto old_size = _text.size();
+      pos = std::min(pos, old_size);
+      count = std::min(count, old_size - pos);
+
+      // The paragraphs touched: the ones with pos and pos+count (an edit
+      // at the end also touches the paragraph before, whose '\n' is no
+      // longer, or now is, the end of the text)
+      auto first = paragraph_index(pos);
+      auto last = _paragraphs.empty()? 0 : paragraph_index(pos + count) + 1;
+      if (first != 0 && utf32.empty() && pos + count == old_size
+         && _paragraphs[first].text_start == pos)
+         --first;
+
+      // All of them, when the edit changes the script or direction of the
+      // whole text
+      _text.replace(pos, count, utf32);
+      if (update_properties())
+      {
+         first = 0;
+         last = _paragraphs.size();
+      }
+
+      auto text_start = _paragraphs.empty()? 0 : _paragraphs[first].text_start;
+      auto text_end = (last < _paragraphs.size())? _paragraphs[last].text_start : old_size;
+      auto glyph_start = _paragraphs.empty()? 0 : _paragraphs[first].glyph_start;
+      auto glyph_end = (last < _paragraphs.size())? _paragraphs[last].glyph_start : _glyphs.size();
+      auto text_delta = std::ptrdiff_t(utf32.size()) - std::ptrdiff_t(count);
+
+      analysis result;
+      analyze(text_start, text_end + text_delta, glyph_start, result);
+      auto glyph_delta =
+         std::ptrdiff_t(result.glyphs.size()) - std::ptrdiff_t(glyph_end - glyph_start);
+
+      // Splice the new paragraphs in, and move the ones after
+      splice(_glyphs, glyph_start, glyph_end, result.glyphs);
+      splice(_glyph_indices, text_start, text_end, result.glyph_indices);
+      splice(_breaks, text_start, text_end, result.breaks);
+      splice(_paragraphs, first, last, result.paragraphs);
+      for (auto i = glyph_start + result.glyphs.size(); i != _glyphs.size(); ++i)
+         _glyphs[i].cluster += text_delta;
+      for (auto i = text_start + result.glyph_indices.size(); i != _glyph_indices.size(); ++i)
+      {
+         if (_glyph_indices[i] != std::size_t(-1))
+            _glyph_indices[i] += glyph_delta;
+      }
+      for (auto i = first + result.paragraphs.size(); i != _paragraphs.size(); ++i)
+      {
+         _paragraphs[i].text_start += text_delta;
+         _paragraphs[i].glyph_start += glyph_delta;
+      }
+
+      // Merge with the edits not flowed yet
+      auto new_glyph_end = glyph_start + result.glyphs.size();
+      if (_edit)
+      {
+         _edit->glyph_start = std::min(_edit->glyph_start, glyph_start);
+         _edit->glyph_end = (_edit->glyph_end >= glyph_end)?
+            _edit->glyph_end + glyph_delta : new_glyph_end;
+         _edit->glyph_delta += glyph_delta;
+      }
+      else
+      {
+         _edit = edit_info{glyph_start, new_glyph_end, glyph_delta, std::move(_rows)};
+         _rows.clear();
+      }
+   }
+
+   void text_layout::impl::flow(float width, bool justify)
    {
+      auto line_info_f = [width](float /*y*/)
+      {
+         return line_info{0, width};
+      };
+
+      auto lh = _font.line_height();
+      flow_info finfo{justify, lh, lh};
+      auto flow_all =
+         [&]
+         {
+            flow(line_info_f, finfo);
+            _flowed = flow_params{width, justify};
+         };
+
+      if (!_flowed || _flowed->width != width || _flowed->justify != justify)
+         return flow_all();
+      if (!_edit)
+         return;  // Nothing changed
+
+      // Keep the rows before the edit, and the rows after it, moved
+      auto edit = std::move(*_edit);
+      _edit.reset();
+      _rows = std::move(edit.rows);
+      auto old_glyph_end = edit.glyph_end - edit.glyph_delta;
+      auto row_at =
+         [&](std::size_t glyph_idx)
+         {
+            return std::lower_bound(_rows.begin(), _rows.end(), glyph_idx,
+               [](auto const& row, std::size_t idx)
+               {
+                  return row.glyph_index < idx;
+               }
+            );
+         };
+
+      auto first = row_at(edit.glyph_start);
+      auto last = row_at(old_glyph_end);
+      if ((first != _rows.end() && first->glyph_index != edit.glyph_start)
+         || (last != _rows.end() && last->glyph_index != old_glyph_end))
+         return flow_all();
+
+      line_vector tail{std::make_move_iterator(last), std::make_move_iterator(_rows.end())};
+      _rows.erase(first, _rows.end());
+      if (!reflow(line_info_f, finfo, edit.glyph_start, edit.glyph_end))
+         return flow_all();
+
+      if (tail.size())
+      {
+         auto y = _rows.size()? _rows.back().pos.y + lh : 0;
+         auto dy = y - tail.front().pos.y;
+         for (auto& row : tail)
+         {
+            row.pos.y += dy;
+            row.glyph_index += edit.glyph_delta;
+            _rows.push_back(std::move(row));
+         }
+      }
    }
 
    void text_layout::impl::flow(get_line_info const& glf, flow_info finfo)
    {
+      _rows.clear();
+      _edit.reset();
+      _flowed.reset();
       if (_text.size() == 0)
          return;
-      _rows.clear();
 
-      auto glyphs_info = _buff.glyphs();
-      int hb_scalex, hb_scaley;
-      hb_font_get_scale(_hb_font.get(), &hb_scalex, &hb_scaley);
-      auto sc_font = _font.impl();
-      float scalex = (sc_font->getSize() / hb_scalex) * sc_font->getScaleX();
+      reflow(glf, finfo, 0, _glyphs.size());
+      if (_rows.size())
+      {
+         auto& last = _rows.back();
+         last.pos.y += finfo.last_line_height - finfo.line_height;
+         last.height = finfo.last_line_height;
+      }
+   }
 
+   // Flows the glyphs [first, last), from the start of a paragraph, adding
+   // rows after the ones in _rows. Returns false if the rows do not end
+   // at last.
+   bool text_layout::impl::reflow(
+      get_line_info const& glf, flow_info finfo
+    , std::size_t first, std::size_t last)
+   {
       std::vector<SkScalar> positions;
-      positions.reserve(glyphs_info.count);
-      auto linfo = glf(0);
-      float y = 0;
+      positions.reserve(last - first);
+      float y = _rows.size()? _rows.back().pos.y + finfo.line_height : 0;
+      auto linfo = glf(y);
       float x = 0;
-      std::size_t glyph_start = 0;
+      std::size_t glyph_start = first;
 
       auto num_spaces =
          [&](std::size_t glyph_idx) -> std::size_t
@@ -152,7 +467,7 @@ namespace cycfi::artist
             std::size_t count = 0;
             for (auto i = glyph_start; i != glyph_idx; ++i)
             {
-               auto cl = glyphs_info.glyphs[i].cluster;
+               auto cl = _glyphs[i].cluster;
                if (is_space(_text[cl]))
                   ++count;
             }
@@ -162,12 +477,11 @@ namespace cycfi::artist
       auto justify =
          [&](std::size_t glyph_idx, bool must_break) -> float
          {
-             while (glyph_idx >= glyph_start && glyphs_info.glyphs[glyph_idx].codepoint == 0)
+             while (glyph_idx >= glyph_start && _glyphs[glyph_idx].id == 0)
                 --glyph_idx;
 
             auto line_width =
-               positions[glyph_idx-glyph_start] +
-               (glyphs_info.positions[glyph_idx].x_advance * scalex)
+               positions[glyph_idx-glyph_start] + _glyphs[glyph_idx].advance
             ;
             if (finfo.justify && !must_break)
             {
@@ -179,7 +493,7 @@ namespace cycfi::artist
                   float offset = 0;
                   for (auto i = glyph_start; i != glyph_idx; ++i)
                   {
-                     auto cl = glyphs_info.glyphs[i].cluster;
+                     auto cl = _glyphs[i].cluster;
                      if (is_space(_text[cl]))
                         offset += extra;
                      positions[i-glyph_start] += offset;
@@ -195,7 +509,7 @@ namespace cycfi::artist
       auto new_line =
          [&](std::size_t text_idx, std::size_t& glyph_idx, bool must_break, bool indeterminate)
          {
-            glyph_idx = glyphs_info.glyph_index(text_idx);
+            glyph_idx = glyph_index(text_idx);
             auto glyph_count = glyph_idx - glyph_start;
             if (indeterminate)  // Is the last glyph indeterminate?
                ++glyph_count;
@@ -204,7 +518,7 @@ namespace cycfi::artist
 
             std::vector<SkGlyphID> line_glyphs(glyph_count);
             for (std::size_t j = 0; j != glyph_count; ++j)
-               line_glyphs[j] = glyphs_info.glyphs[glyph_start + j].codepoint;
+               line_glyphs[j] = _glyphs[glyph_start + j].id;
 
             auto text_blob = SkTextBlob::MakeFromPosTextH(
                line_glyphs.data()
@@ -235,11 +549,11 @@ namespace cycfi::artist
             x = 0;
          };
 
-      for (std::size_t glyph_idx = 0; glyph_idx != glyphs_info.count; ++glyph_idx)
+      for (std::size_t glyph_idx = first; glyph_idx < last; ++glyph_idx)
       {
-         positions.push_back(x + (glyphs_info.positions[glyph_idx].x_offset * scalex));
-         x += glyphs_info.positions[glyph_idx].x_advance * scalex;
-         auto idx = glyphs_info.glyphs[glyph_idx].cluster;
+         positions.push_back(x + _glyphs[glyph_idx].offset);
+         x += _glyphs[glyph_idx].advance;
+         auto idx = _glyphs[glyph_idx].cluster;
          bool indeterminate_ = _breaks[idx].line == indeterminate;
 
          if (_breaks[idx].line == must_break || indeterminate_)
@@ -251,8 +565,8 @@ namespace cycfi::artist
          {
             // We break the line when x exceeds the target width
             std::size_t len = positions.size();
-            auto start_line = glyphs_info.glyphs[glyph_start].cluster;
-            auto end_line = glyphs_info.glyphs[glyph_start+len].cluster;
+            auto start_line = _glyphs[glyph_start].cluster;
+            auto end_line = _glyphs[glyph_start+len].cluster;
             bool force_break = true;
 
             for (int i = end_line-1; i >= static_cast<int>(start_line); --i)
@@ -269,12 +583,7 @@ namespace cycfi::artist
                new_line(end_line, glyph_idx, false, false);
          }
       }
-      if (_rows.size())
-      {
-         auto& last = _rows.back();
-         last.pos.y += finfo.last_line_height - finfo.line_height;
-         last.height = finfo.last_line_height;
-      }
+      return glyph_start == last;
    }
 
    void  text_layout::impl::draw(canvas& cnv, point p, color c)
@@ -305,25 +614,23 @@ namespace cycfi::artist
       if (_rows.size() == 0)
          return {0, 0};
 
-      auto glyphs_info = _buff.glyphs();
-
       // Find the glyph index from string index
-      auto glyph_index = index;
+      auto glyph_idx = index;
       auto row_index = -1;
       if (index < _text.size())
       {
-         glyph_index = glyphs_info.glyph_index(index);
+         glyph_idx = glyph_index(index);
       }
       else
       {
-         glyph_index = glyphs_info.count;
+         glyph_idx = _glyphs.size();
          row_index = _rows.size() - 1;
       }
 
       // Find the row that includes the glyph index
       if (row_index == -1)
       {
-         auto i = std::lower_bound(_rows.begin(), _rows.end(), glyph_index,
+         auto i = std::lower_bound(_rows.begin(), _rows.end(), glyph_idx,
             [](auto const& row, std::size_t pos)
             {
                return (row.glyph_index + row.glyph_count) < pos;
@@ -336,7 +643,7 @@ namespace cycfi::artist
 
       // Now find the glyph position in the row
       auto const& row = _rows[row_index];
-      auto pos = glyph_index - row.glyph_index;
+      auto pos = glyph_idx - row.glyph_index;
       auto offset = (pos < row.positions.size())? row.positions[pos] : row.width;
       return {row.pos.x + offset, row.pos.y};
    }
@@ -346,7 +653,6 @@ namespace cycfi::artist
       if (_rows.size() == 0)
          return 0;
 
-      auto glyphs_info = _buff.glyphs();
       auto i = std::lower_bound(_rows.begin(), _rows.end(), p.y,
          [](auto const& row, float y)
          {
@@ -357,11 +663,11 @@ namespace cycfi::artist
          return npos;
 
       if (p.x <= i->pos.x)
-         return glyphs_info.glyphs[i->glyph_index].cluster;
+         return _glyphs[i->glyph_index].cluster;
 
       auto is_last_row = (i == _rows.end()-1);
       if (!is_last_row && p.x >= (i->pos.x + i->width))
-         return glyphs_info.glyphs[i->glyph_index + i->glyph_count].cluster;
+         return _glyphs[i->glyph_index + i->glyph_count].cluster;
 
       auto f = i->positions.begin();
       auto l = i->positions.end();
@@ -382,7 +688,7 @@ namespace cycfi::artist
             --j;
       }
       auto index = i->glyph_index + (j-f);
-      return glyphs_info.glyphs[index].cluster;
+      return _glyphs[index].cluster;
    }
 
    std::size_t text_layout::impl::num_lines() const
@@ -449,15 +755,34 @@ namespace cycfi::artist
       return _impl->get_text();
    }
 
-   void text_layout::flow(float width, bool justify)
+   void text_layout::insert(std::size_t pos, std::string_view utf8)
    {
-      auto line_info_f = [width](float /*y*/)
-      {
-         return line_info{0, width};
-      };
+      _impl->replace(pos, 0, to_utf32(utf8));
+   }
+
+   void text_layout::insert(std::size_t pos, std::u32string_view utf32)
+   {
+      _impl->replace(pos, 0, utf32);
+   }
+
+   void text_layout::erase(std::size_t pos, std::size_t count)
+   {
+      _impl->replace(pos, count, {});
+   }
 
-      auto lh = _impl->get_font().line_height();
-      flow(line_info_f, {justify, lh, lh});
+   void text_layout::append(std::string_view utf8)
+   {
+      _impl->replace(npos, 0, to_utf32(utf8));
+   }
+
+   void text_layout::append(std::u32string_view utf32)
+   {
+      _impl->replace(npos, 0, utf32);
+   }
+
+   void text_layout::flow(float width, bool justify)
+   {
+      _impl->flow(width, justify);
    }
 
    void text_layout::flow(get_line_info const& glf, flow_info finfo)
@@ -7,19 +7,32 @@
 #define ARTIST_AFFINE_TRANSFORM_APRIL_19_2020
 
 #include <cmath>
+#include <cstddef>
 #include <artist/point.hpp>
 
 namespace cycfi::artist
 {
-   struct affine_transform
+   ////////////////////////////////////////////////////////////////////////////
+   // basic_affine_transform: T is the precision of the matrix coefficients.
+   // affine_transform (double) is what the canvas uses. affine_transform_f
+   // (float) is meant for hot loops that transform large point sets.
+   //
+   // The in-place apply(p, n) overloads are constexpr and transform one
+   // point at a time. The ones that take separate source and destination
+   // arrays (or x and y arrays) go through transform_points (see below).
+   ////////////////////////////////////////////////////////////////////////////
+   template <typename T>
+   struct basic_affine_transform
    {
+      using value_type = T;
+
       constexpr bool                   is_identity() const;
-      constexpr affine_transform       translate(double tx, double ty) const;
-      constexpr affine_transform       scale(double sx, double sy) const;
-      constexpr affine_transform       scale(double sc) const;
-      inline affine_transform          rotate(double rad) const;
-      inline affine_transform          skew(double sx, double sy) const;
-      constexpr affine_transform       invert() const;
+      constexpr basic_affine_transform translate(T tx, T ty) const;
+      constexpr basic_affine_transform scale(T sx, T sy) const;
+      constexpr basic_affine_transform scale(T sc) const;
+      inline basic_affine_transform    rotate(T rad) const;
+      inline basic_affine_transform    skew(T sx, T sy) const;
+      constexpr basic_affine_transform invert() const;
 
       constexpr point                  apply(point p) const;
       constexpr point                  apply(float x, float y) const;
@@ -27,15 +40,28 @@ namespace cycfi::artist
                                        template <std::size_t N>
       constexpr void                   apply(point p[N]) const;
       constexpr void                   apply(point p[], std::size_t n) const;
+      void                             apply(point const src[], point dest[], std::size_t n) const;
+      void                             apply(float x[], float y[], std::size_t n) const;
+      void                             apply(
+                                          float const x[], float const y[]
+                                        , float x_out[], float y_out[]
+                                        , std::size_t n
+                                       ) const;
+
+                                       template <typename U>
+      constexpr explicit               operator basic_affine_transform<U>() const;
 
-      double a    = 1.0;
-      double b    = 0.0;
-      double c    = 0.0;
-      double d    = 1.0;
-      double tx   = 0.0;
-      double ty   = 0.0;
+      T a    = 1.0;
+      T b    = 0.0;
+      T c    = 0.0;
+      T d    = 1.0;
+      T tx   = 0.0;
+      T ty   = 0.0;
    };
 
+   using affine_transform = basic_affine_transform<double>;
+   using affine_transform_f = basic_affine_transform<float>;
+
    constexpr affine_transform affine_identity;
 
    constexpr affine_transform make_translation(double tx, double ty);
@@ -44,22 +70,61 @@ namespace cycfi::artist
    inline affine_transform make_rotation(double rad);
    inline affine_transform make_skew(double sx, double sy);
 
+   ////////////////////////////////////////////////////////////////////////////
+   // Batch transforms. `src` and `dest` (or the x/y arrays and their outputs)
+   // may be the same arrays, but must not otherwise overlap. These use the
+   // widest SIMD instruction set available at runtime (AVX2, SSE2, or a
+   // scalar fallback) and produce the same results as the per-point apply.
+   ////////////////////////////////////////////////////////////////////////////
+   void transform_points(
+      affine_transform const& mat
+    , point const src[], point dest[], std::size_t n
+   );
+
+   void transform_points(
+      affine_transform_f const& mat
+    , point const src[], point dest[], std::size_t n
+   );
+
+   void transform_points(
+      affine_transform const& mat
+    , float const x[], float const y[]
+    , float x_out[], float y_out[]
+    , std::size_t n
+   );
+
+   void transform_points(
+      affine_transform_f const& mat
+    , float const x[], float const y[]
+    , float x_out[], float y_out[]
+    , std::size_t n
+   );
+
    ///////////////////////////////////////////////////////////////////////////
    // Inlines and constexpr
    ///////////////////////////////////////////////////////////////////////////
-   constexpr bool operator==(affine_transform const& lhs, affine_transform const& rhs)
+   template <typename T>
+   constexpr bool operator==(
+      basic_affine_transform<T> const& lhs
+    , basic_affine_transform<T> const& rhs)
    {
       return lhs.a == rhs.a && lhs.b == rhs.b && lhs.c == rhs.c
          && lhs.d == rhs.d && lhs.tx == rhs.tx && lhs.ty == rhs.ty
          ;
    }
 
-   constexpr bool operator!=(affine_transform const& lhs, affine_transform const& rhs)
+   template <typename T>
+   constexpr bool operator!=(
+      basic_affine_transform<T> const& lhs
+    , basic_affine_transform<T> const& rhs)
    {
       return !(rhs == lhs);
    }
 
-   constexpr affine_transform operator*(affine_transform t1, affine_transform t2)
+   template <typename T>
+   constexpr basic_affine_transform<T> operator*(
+      basic_affine_transform<T> t1
+    , basic_affine_transform<T> t2)
    {
       return {
          t2.a * t1.a + t2.b * t1.c
@@ -71,12 +136,14 @@ namespace cycfi::artist
       };
    }
 
-   constexpr bool affine_transform::is_identity() const
+   template <typename T>
+   constexpr bool basic_affine_transform<T>::is_identity() const
    {
-      return *this == affine_identity;
+      return *this == basic_affine_transform{};
    }
 
-   constexpr point affine_transform::apply(point p) const
+   template <typename T>
+   constexpr point basic_affine_transform<T>::apply(point p) const
    {
       return {
          float(a * p.x + c * p.y + tx)
@@ -84,7 +151,8 @@ namespace cycfi::artist
       };
    }
 
-   constexpr point affine_transform::apply(float x, float y) const
+   template <typename T>
+   constexpr point basic_affine_transform<T>::apply(float x, float y) const
    {
       return {
          float(a * x + c * y + tx)
@@ -92,18 +160,50 @@ namespace cycfi::artist
       };
    }
 
+   template <typename T>
    template <std::size_t N>
-   constexpr void affine_transform::apply(point p[N]) const
+   constexpr void basic_affine_transform<T>::apply(point p[N]) const
    {
       apply(p, N);
    }
 
-   constexpr void affine_transform::apply(point p[], std::size_t n) const
+   template <typename T>
+   constexpr void basic_affine_transform<T>::apply(point p[], std::size_t n) const
    {
       for (std::size_t i = 0; i != n; ++i)
          p[i] = apply(p[i]);
    }
 
+   template <typename T>
+   inline void basic_affine_transform<T>::apply(
+      point const src[], point dest[], std::size_t n) const
+   {
+      transform_points(*this, src, dest, n);
+   }
+
+   template <typename T>
+   inline void basic_affine_transform<T>::apply(
+      float x[], float y[], std::size_t n) const
+   {
+      transform_points(*this, x, y, x, y, n);
+   }
+
+   template <typename T>
+   inline void basic_affine_transform<T>::apply(
+      float const x[], float const y[]
+    , float x_out[], float y_out[]
+    , std::size_t n) const
+   {
+      transform_points(*this, x, y, x_out, y_out, n);
+   }
+
+   template <typename T>
+   template <typename U>
+   constexpr basic_affine_transform<T>::operator basic_affine_transform<U>() const
+   {
+      return {U(a), U(b), U(c), U(d), U(tx), U(ty)};
+   }
+
    constexpr affine_transform make_translation(double tx, double ty)
    {
       return {1.0, 0.0, 0.0, 1.0, tx, ty};
@@ -131,34 +231,47 @@ namespace cycfi::artist
       return {1.0, std::tan(sx), std::tan(sy), 1.0, 0.0, 0.0};
    }
 
-   constexpr affine_transform affine_transform::translate(double tx_, double ty_) const
+   template <typename T>
+   constexpr basic_affine_transform<T>
+   basic_affine_transform<T>::translate(T tx_, T ty_) const
    {
-      return *this * make_translation(tx_, ty_);
+      return *this * basic_affine_transform{1, 0, 0, 1, tx_, ty_};
    }
 
-   constexpr affine_transform affine_transform::scale(double sx, double sy) const
+   template <typename T>
+   constexpr basic_affine_transform<T>
+   basic_affine_transform<T>::scale(T sx, T sy) const
    {
-      return *this * make_scale(sx, sy);
+      return *this * basic_affine_transform{sx, 0, 0, sy, 0, 0};
    }
 
-   constexpr affine_transform affine_transform::scale(double sc) const
+   template <typename T>
+   constexpr basic_affine_transform<T>
+   basic_affine_transform<T>::scale(T sc) const
    {
-      return *this * make_scale(sc);
+      return scale(sc, sc);
    }
 
-   inline affine_transform affine_transform::rotate(double rad) const
+   template <typename T>
+   inline basic_affine_transform<T>
+   basic_affine_transform<T>::rotate(T rad) const
    {
-      return *this * make_rotation(rad);
+      auto s = std::sin(rad);
+      auto c = std::cos(rad);
+      return *this * basic_affine_transform{c, s, -s, c, 0, 0};
    }
 
-   inline affine_transform affine_transform::skew(double sx, double sy) const
+   template <typename T>
+   inline basic_affine_transform<T>
+   basic_affine_transform<T>::skew(T sx, T sy) const
    {
-      return *this * make_skew(sx, sy);
+      return *this * basic_affine_transform{1, std::tan(sx), std::tan(sy), 1, 0, 0};
    }
 
-   constexpr affine_transform affine_transform::invert() const
+   template <typename T>
+   constexpr basic_affine_transform<T> basic_affine_transform<T>::invert() const
    {
-      double determinant = a * d - c * b;
+      T determinant = a * d - c * b;
       if (determinant == 0)
          return *this;
 
@@ -174,4 +287,3 @@ namespace cycfi::artist
 }
 
 #endif
-
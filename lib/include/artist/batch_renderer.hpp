@@ -0,0 +1,90 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_BATCH_RENDERER_OCTOBER_19_2026)
+#define ARTIST_BATCH_RENDERER_OCTOBER_19_2026
+
+#include <artist/canvas.hpp>
+#include <artist/image.hpp>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // batch_renderer: Headless rendering of many images, e.g. charts on a
+   // server, on a pool of worker threads. Needs no window and no GPU: on
+   // Linux, the Skia backend renders in software, with fonts from
+   // fontconfig.
+   //
+   // Each job draws a scene into a raster canvas of its own, on whichever
+   // worker takes it, and is then encoded (see image::encode). The scene
+   // is drawn by a callback, or played back from a display list: an image
+   // recorded with offscreen_image, which may be shared by any number of
+   // jobs. When both are given, the display list is drawn first. The
+   // pixels of the canvas are borrowed from the surface_pool, so workers
+   // reuse the same few buffers from one job to the next.
+   //
+   // Results are streamed to the output function as soon as each job is
+   // encoded, in the order the jobs finish (see result::index). The output
+   // function is called on the worker threads, one call at a time. Errors
+   // from a job are reported in its result; an exception thrown by the
+   // output function is rethrown by render, after the batch is done.
+   //
+   // render_time is the time taken to draw the scene into pixels, and
+   // encode_time the time taken to encode them.
+   ////////////////////////////////////////////////////////////////////////////
+   class batch_renderer
+   {
+   public:
+
+      using duration = std::chrono::duration<double>;
+      using scene_function = std::function<void(canvas& cnv)>;
+
+      struct job
+      {
+         extent                     size;
+         scene_function             scene;
+         image_ptr                  display_list;
+         image_format               format = image_format::png;
+         int                        quality = 90;
+      };
+
+      struct result
+      {
+         std::size_t                index = 0;  // Of the job, in render's jobs
+         std::vector<std::uint8_t>  encoded;
+         std::exception_ptr         error;      // Set if the job failed
+         duration                   render_time{};
+         duration                   encode_time{};
+      };
+
+      using output_function = std::function<void(result&& r)>;
+
+      explicit          batch_renderer(std::size_t num_threads = 0); // 0: one per core
+                        ~batch_renderer();
+
+                        batch_renderer(batch_renderer const&) = delete;
+      batch_renderer&   operator=(batch_renderer const&) = delete;
+
+      // Renders all the jobs, and returns when they are done. Calls from
+      // different threads are rendered one batch after the other.
+      void              render(std::vector<job> const& jobs, output_function output);
+
+      std::size_t       num_threads() const;
+
+   private:
+
+      struct state;
+      using state_ptr = std::unique_ptr<state>;
+
+      state_ptr         _state;
+   };
+}
+
+#endif
@@ -8,6 +8,7 @@
 
 #include <artist/color.hpp>
 #include <artist/rect.hpp>
+#include <artist/region.hpp>
 #include <artist/circle.hpp>
 #include <artist/image.hpp>
 #include <artist/font.hpp>
@@ -15,6 +16,7 @@
 #include <artist/text_layout.hpp>
 #include <artist/affine_transform.hpp>
 
+#include <functional>
 #include <vector>
 #include <memory>
 
@@ -33,6 +35,15 @@ namespace cycfi::artist
 //#endif
 #endif
 
+   class colormap;
+   class image_atlas;
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Thread safety: A canvas, like the surface or offscreen_image it draws
+   // into, is used by one thread at a time. Separate canvases may draw on
+   // separate threads at the same time, sharing fonts, paths and images
+   // (see their notes).
+   ////////////////////////////////////////////////////////////////////////////
    class canvas
    {
    public:
@@ -77,6 +88,7 @@ namespace cycfi::artist
 
       void              clip();
       void              clip(path const& p);
+      void              clip(region const& r);
       rect              clip_extent() const;
       bool              point_in_path(point p) const;
       bool              point_in_path(float x, float y) const;
@@ -203,6 +215,12 @@ namespace cycfi::artist
       void              global_composite_operation(composite_op_enum mode);
       void              composite_op(composite_op_enum mode);
 
+      // The opacity, from 0 to 1, that everything drawn (fills, strokes,
+      // text and images) is multiplied by. Like the composite operation,
+      // it is part of the state saved by save.
+      void              global_alpha(float alpha);
+      float             global_alpha() const;
+
       ///////////////////////////////////////////////////////////////////////////////////
       // Gradients
       struct color_stop
@@ -269,6 +287,10 @@ namespace cycfi::artist
       void              stroke_style(linear_gradient const& gr);
       void              stroke_style(radial_gradient const& gr);
 
+      // Colormap along the line from start to end, clamped at both ends
+      void              fill_style(colormap const& cmap, point start, point end);
+      void              stroke_style(colormap const& cmap, point start, point end);
+
       ///////////////////////////////////////////////////////////////////////////////////
       // Fill Rule
 
@@ -336,6 +358,39 @@ namespace cycfi::artist
       void              draw(image const& pic, float posx, float posy);
       void              draw(image const& pic, float posx, float posy, float scale);
 
+      // How images are sampled when drawn scaled. This is part of the
+      // state (see save and restore). nearest is the default. With
+      // mipmap_linear, images drawn smaller than their size use a mip
+      // chain, built on the first such draw and kept with the image.
+      enum image_sampling_enum
+      {
+         nearest,
+         linear,
+         mipmap_linear,
+         cubic
+      };
+
+      void              image_sampling(image_sampling_enum mode);
+      image_sampling_enum image_sampling() const;
+
+      ///////////////////////////////////////////////////////////////////////////////////
+      // Sprite Atlas
+
+      // Draws n sprites cut from pic in a single draw call. xf[i] maps
+      // sprite i from its own coordinates (the top-left of src[i] at 0, 0)
+      // to the canvas. tint[i], if tint is not null, multiplies the
+      // sprite's colors. Batches that only rotate, uniformly scale and
+      // translate are drawn at once; batches with other transforms (e.g.
+      // skew) are drawn sprite by sprite.
+      void              draw_atlas(
+                           image const& pic
+                         , rect const src[]
+                         , affine_transform const xf[]
+                         , color const tint[]
+                         , std::size_t n
+                        );
+      void              draw_atlas(image_atlas const& atlas);
+
       ///////////////////////////////////////////////////////////////////////////////////
       // States
       class state
@@ -358,6 +413,38 @@ namespace cycfi::artist
       void              save();
       void              restore();
 
+      ///////////////////////////////////////////////////////////////////////////////////
+      // Layers
+
+      // Everything drawn between begin_layer and end_layer is drawn into a
+      // transparent layer, which end_layer composites as a whole, with the
+      // given opacity and mode. Use layers to fade a group of drawings, or
+      // blend it, as one, e.g. a panel. Only the bounds (in user
+      // coordinates) are allocated, and drawing outside them is clipped,
+      // so keep them tight. Like save and restore, the layer saves the
+      // state, and end_layer restores it.
+      //
+      // A fully opaque source_over layer is skipped: it is the same as
+      // drawing directly, except that composite operations within act on
+      // what is under the layer instead of on the layer alone.
+      void              begin_layer(
+                           rect const& bounds
+                         , float opacity = 1.0f
+                         , composite_op_enum mode = source_over
+                        );
+      void              end_layer();
+
+      ///////////////////////////////////////////////////////////////////////////////////
+      // Raster Cache
+
+      // Draws static content through the raster cache (see raster_cache.hpp):
+      // draw_fn is called to draw the content, clipped to bounds (in user
+      // coordinates), until it has been stable for a few frames. From then
+      // on, a raster of it, made at the device scale, is drawn instead.
+      using draw_function = std::function<void(canvas& cnv)>;
+
+      void              cached(std::size_t key, rect const& bounds, draw_function const& draw_fn);
+
       class canvas_state;
       using canvas_state_ptr = std::unique_ptr<canvas_state>;
 
@@ -368,6 +455,15 @@ namespace cycfi::artist
 
       void              add_round_rect_impl(const rect& r, float radius);
    };
+
+   namespace detail
+   {
+      // Implemented by the backends: draws into a new, transparent, raster
+      // image of the given size in pixels, with its own canvas. The pixels
+      // are borrowed from the surface_pool, and go back to it when the
+      // image is destroyed.
+      image             rasterize(extent size, canvas::draw_function const& draw);
+   }
 }
 
 #include <artist/detail/canvas_impl.hpp>
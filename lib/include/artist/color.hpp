@@ -7,6 +7,7 @@
 #define ARTIST_POINT_APRIL_11_2016
 
 #include <cstdint>
+#include <cstddef>
 #include <algorithm>
 
 namespace cycfi::artist
@@ -39,6 +40,41 @@ namespace cycfi::artist
    constexpr color operator*(color const& a, float b);
    constexpr color operator*(float a, color const& b);
 
+   ////////////////////////////////////////////////////////////////////////////
+   // Batch conversions. These work on arrays of colors or pixels and use the
+   // widest SIMD instruction set available at runtime (AVX2, SSE2, or a
+   // scalar fallback).
+   //
+   // Packed 8-bit pixels are in memory byte order: rgba8 is R, G, B, A (as
+   // in pixel_format::rgba32) and bgra8 is B, G, R, A. When packing, the
+   // channels are clamped to 0.0 to 1.0 and rounded to the nearest value.
+   ////////////////////////////////////////////////////////////////////////////
+   void to_rgba8(color const src[], std::uint32_t dest[], std::size_t n);
+   void to_bgra8(color const src[], std::uint32_t dest[], std::size_t n);
+   void from_rgba8(std::uint32_t const src[], color dest[], std::size_t n);
+   void from_bgra8(std::uint32_t const src[], color dest[], std::size_t n);
+
+   // Multiply or divide red, green and blue by alpha, in place. Packed
+   // pixels may be rgba8 or bgra8 (alpha is the last byte in both).
+   // Unpremultiplying a zero alpha gives zero.
+   void premultiply(color c[], std::size_t n);
+   void unpremultiply(color c[], std::size_t n);
+   void premultiply(std::uint32_t c[], std::size_t n);
+   void unpremultiply(std::uint32_t c[], std::size_t n);
+
+   // Apply the sRGB transfer function (or its inverse) to red, green and
+   // blue, in place. Alpha is left alone. Inputs are clamped to 0.0 to 1.0.
+   // These use lookup tables with linear interpolation, accurate to about
+   // 2e-5.
+   void srgb_to_linear(color c[], std::size_t n);
+   void linear_to_srgb(color c[], std::size_t n);
+
+   // Batch hsl (see hsl(h, s, l) below)
+   void hsl(
+      float const h[], float const s[], float const l[]
+    , color dest[], std::size_t n
+   );
+
    ////////////////////////////////////////////////////////////////////////////
    // Inlines
    ////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,136 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_COLORMAP_OCTOBER_19_2026)
+#define ARTIST_COLORMAP_OCTOBER_19_2026
+
+#include <artist/canvas.hpp>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // colormap: Maps scalar values to colors through a lookup table, e.g. for
+   // heatmaps and spectrograms.
+   //
+   // The table is baked from a list of color stops (same as gradients) into
+   // size() evenly spaced entries. Colors are interpolated component-wise,
+   // unpremultiplied, in sRGB. Stop offsets are in 0.0 to 1.0. Before the
+   // first stop and after the last, the end colors are extended.
+   //
+   // Entries are packed rgba8 (see to_rgba8), so apply() can write straight
+   // into the pixels() of an image made with make_image<pixel_format::rgba32>.
+   //
+   // A colormap can also be used as a fill or stroke style (see
+   // canvas::fill_style). It then works like a linear gradient, except that
+   // the colors are exactly the colormap's. What the backend draws it with
+   // is made on first use and shared by the colormap's copies, so setting
+   // the same colormap as a style in every frame is cheap.
+   ////////////////////////////////////////////////////////////////////////////
+   namespace detail
+   {
+      // The backend's drawing object for a colormap, made once
+      struct colormap_style
+      {
+         std::once_flag                once;
+         std::shared_ptr<void const>   style;
+      };
+   }
+
+   class colormap
+   {
+   public:
+
+      using color_stop = canvas::color_stop;
+      static constexpr std::size_t default_size = 256;
+
+      explicit                colormap(
+                                 std::vector<color_stop> const& stops
+                               , std::size_t size = default_size
+                              );
+                              colormap(
+                                 std::initializer_list<color_stop> stops
+                               , std::size_t size = default_size
+                              );
+      explicit                colormap(
+                                 canvas::gradient const& gr
+                               , std::size_t size = default_size
+                              );
+
+      std::size_t             size() const;
+      std::uint32_t const*    data() const;
+
+      // The color of the entry nearest v, where v is in 0.0 to 1.0
+      color                   operator()(float v) const;
+
+      // Map n values to packed rgba8 pixels. Values are scaled from
+      // [low, high] to the table, clamped, and rounded to the nearest entry.
+      // NaNs get the first entry. This uses the widest SIMD instruction set
+      // available at runtime.
+      void                    apply(
+                                 float const values[], std::size_t n
+                               , std::uint32_t dest[]
+                               , float low = 0.0f, float high = 1.0f
+                              ) const;
+
+      // For the backends (see detail::colormap_style)
+      detail::colormap_style& style() const;
+
+   private:
+
+      using style_ptr = std::shared_ptr<detail::colormap_style>;
+
+      std::vector<std::uint32_t> _lut;
+      style_ptr                  _style = std::make_shared<detail::colormap_style>();
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Named colormaps. viridis and magma are the perceptually uniform maps
+   // from matplotlib, built from nine evenly spaced samples of each. grays
+   // goes from black to white.
+   ////////////////////////////////////////////////////////////////////////////
+   namespace colormaps
+   {
+      colormap viridis(std::size_t size = colormap::default_size);
+      colormap magma(std::size_t size = colormap::default_size);
+      colormap grays(std::size_t size = colormap::default_size);
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline colormap::colormap(
+      std::initializer_list<color_stop> stops
+    , std::size_t size
+   )
+    : colormap(std::vector<color_stop>(stops), size)
+   {
+   }
+
+   inline colormap::colormap(canvas::gradient const& gr, std::size_t size)
+    : colormap(gr.color_space, size)
+   {
+   }
+
+   inline std::size_t colormap::size() const
+   {
+      return _lut.size();
+   }
+
+   inline std::uint32_t const* colormap::data() const
+   {
+      return _lut.data();
+   }
+
+   inline detail::colormap_style& colormap::style() const
+   {
+      return *_style;
+   }
+}
+
+#endif
@@ -0,0 +1,287 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_DETAIL_ARC_TO_CURVE_OCTOBER_19_2026)
+#define ARTIST_DETAIL_ARC_TO_CURVE_OCTOBER_19_2026
+
+#include <infra/support.hpp>
+#include <artist/point.hpp>
+#include <cmath>
+
+namespace cycfi::artist::detail
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // constexpr math. The <cmath> functions are not constexpr (until C++26),
+   // so we roll our own for compile-time evaluation. These work in double
+   // and are accurate to a few ulps, more than enough for float results.
+   ////////////////////////////////////////////////////////////////////////////
+   namespace cx
+   {
+      constexpr double abs(double x)
+      {
+         return x < 0? -x : x;
+      }
+
+      constexpr double sqrt(double x)
+      {
+         if (x <= 0)
+            return 0;
+
+         // Newton-Raphson
+         double g = x < 1? 1 : x;
+         for (int i = 0; i != 1024; ++i)
+         {
+            double next = 0.5 * (g + x / g);
+            if (next >= g)
+               return g;
+            g = next;
+         }
+         return g;
+      }
+
+      constexpr double sin(double x)
+      {
+         // Reduce to [-pi, pi], then to [-pi/2, pi/2]
+         constexpr double two_pi = 2 * pi;
+         double k = x / two_pi;
+         long long n = static_cast<long long>(k < 0? k - 0.5 : k + 0.5);
+         x -= n * two_pi;
+         if (x > pi / 2)
+            x = pi - x;
+         else if (x < -pi / 2)
+            x = -pi - x;
+
+         // Taylor series
+         double term = x;
+         double sum = x;
+         double x2 = x * x;
+         for (int i = 1; i != 16; ++i)
+         {
+            term *= -x2 / ((2 * i) * (2 * i + 1));
+            sum += term;
+         }
+         return sum;
+      }
+
+      constexpr double cos(double x)
+      {
+         return sin(x + pi / 2);
+      }
+
+      constexpr double atan(double x)
+      {
+         if (x < 0)
+            return -atan(-x);
+         if (x > 1)
+            return pi / 2 - atan(1 / x);
+
+         // Halve the angle twice to speed up the series:
+         // atan(x) = 2 * atan(x / (1 + sqrt(1 + x^2)))
+         x = x / (1 + sqrt(1 + x * x));
+         x = x / (1 + sqrt(1 + x * x));
+
+         double x2 = x * x;
+         double term = x;
+         double sum = x;
+         for (int i = 1; i != 16; ++i)
+         {
+            term *= -x2;
+            sum += term / (2 * i + 1);
+         }
+         return 4 * sum;
+      }
+
+      constexpr double acos(double x)
+      {
+         if (x >= 1)
+            return 0;
+         if (x <= -1)
+            return pi;
+         return pi / 2 - atan(x / sqrt(1 - x * x));
+      }
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Math policies for arc_to_curve
+   ////////////////////////////////////////////////////////////////////////////
+   struct runtime_math
+   {
+      static float sin(float x)  { return std::sin(x); }
+      static float cos(float x)  { return std::cos(x); }
+      static float acos(float x) { return std::acos(x); }
+      static float sqrt(float x) { return std::sqrt(x); }
+      static float abs(float x)  { return std::abs(x); }
+   };
+
+   struct constexpr_math
+   {
+      static constexpr float sin(float x)  { return float(cx::sin(x)); }
+      static constexpr float cos(float x)  { return float(cx::cos(x)); }
+      static constexpr float acos(float x) { return float(cx::acos(x)); }
+      static constexpr float sqrt(float x) { return float(cx::sqrt(x)); }
+      static constexpr float abs(float x)  { return float(cx::abs(x)); }
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Convert an SVG elliptical arc to cubic bezier segments. Path is
+   // anything with line_to(x, y) and bezier_curve_to(x1, y1, x2, y2, x, y).
+   // This is shared by the runtime SVG path parser and static_path, so both
+   // produce the same curves.
+   //
+   // Arc calculation code based on canvg (https://code.google.com/p/canvg/)
+   // Ported to C++ by Joel de Gzman from C port by Mikko Mononen:
+   // https://github.com/memononen/nanosvg/blob/master/src/nanosvg.h
+   // Copyright (c) 2013-14 Mikko Mononen memon@inside.org
+   ////////////////////////////////////////////////////////////////////////////
+   namespace arc_impl
+   {
+      constexpr float sqr(float x) { return x*x; }
+
+      template <typename Math>
+      constexpr float vmag(float x, float y) { return Math::sqrt(x*x + y*y); }
+
+      constexpr void xform_point(float& dx, float& dy, float x, float y, float const* t)
+      {
+         dx = x*t[0] + y*t[2] + t[4];
+         dy = x*t[1] + y*t[3] + t[5];
+      }
+
+      constexpr void xform_vec(float& dx, float& dy, float x, float y, float const* t)
+      {
+         dx = x*t[0] + y*t[2];
+         dy = x*t[1] + y*t[3];
+      }
+
+      template <typename Math>
+      constexpr float vecrat(float ux, float uy, float vx, float vy)
+      {
+         return (ux*vx + uy*vy) / (vmag<Math>(ux,uy) * vmag<Math>(vx,vy));
+      }
+
+      template <typename Math>
+      constexpr float vecang(float ux, float uy, float vx, float vy)
+      {
+         float r = vecrat<Math>(ux,uy, vx,vy);
+         if (r < -1.0f) r = -1.0f;
+         if (r > 1.0f) r = 1.0f;
+         return ((ux*vy < uy*vx) ? -1.0f : 1.0f) * Math::acos(r);
+      }
+   }
+
+   template <typename Math, typename Path>
+   constexpr void arc_to_curve(
+      Path& path_
+    , point& p, point radius, float rotx_
+    , bool large_arc, bool sweep, point end
+   )
+   {
+      // Ported from canvg (https://code.google.com/p/canvg/)
+      using namespace arc_impl;
+
+      float rx    = Math::abs(radius.x);     // x radius
+      float ry    = Math::abs(radius.y);     // y radius
+      float rotx  = rotx_ / 180.0f * pi;     // x rotation angle
+      bool  fa    = large_arc;               // Large arc
+      bool  fs    = sweep;                   // Sweep direction
+      float x1    = p.x;                     // start point
+      float y1    = p.y;
+      float x2    = end.x;
+      float y2    = end.y;
+
+      float dx = x1 - x2;
+      float dy = y1 - y2;
+      float d = Math::sqrt(dx*dx + dy*dy);
+      if (d < 1e-6f || rx < 1e-6f || ry < 1e-6f)
+      {
+         // The arc degenerates to a line
+         path_.line_to(x2, y2);
+         p.x = x2;
+         p.y = y2;
+         return;
+      }
+
+      float sinrx = Math::sin(rotx);
+      float cosrx = Math::cos(rotx);
+
+      // Convert to center point parameterization.
+      // http://www.w3.org/TR/SVG11/implnote.html#ArcImplementationNotes
+      // 1) Compute x1', y1'
+      float x1p = cosrx * dx / 2.0f + sinrx * dy / 2.0f;
+      float y1p = -sinrx * dx / 2.0f + cosrx * dy / 2.0f;
+      d = sqr(x1p)/sqr(rx) + sqr(y1p)/sqr(ry);
+      if (d > 1)
+      {
+         d = Math::sqrt(d);
+         rx *= d;
+         ry *= d;
+      }
+      // 2) Compute cx', cy'
+      float s = 0.0f;
+      float sa = sqr(rx)*sqr(ry) - sqr(rx)*sqr(y1p) - sqr(ry)*sqr(x1p);
+      float sb = sqr(rx)*sqr(y1p) + sqr(ry)*sqr(x1p);
+      if (sa < 0.0f) sa = 0.0f;
+      if (sb > 0.0f)
+         s = Math::sqrt(sa / sb);
+      if (fa == fs)
+         s = -s;
+      float cxp = s * rx * y1p / ry;
+      float cyp = s * -ry * x1p / rx;
+
+      // 3) Compute cx,cy from cx',cy'
+      float cx = (x1 + x2)/2.0f + cosrx*cxp - sinrx*cyp;
+      float cy = (y1 + y2)/2.0f + sinrx*cxp + cosrx*cyp;
+
+      // 4) Calculate theta1, and delta theta.
+      float ux = (x1p - cxp) / rx;
+      float uy = (y1p - cyp) / ry;
+      float vx = (-x1p - cxp) / rx;
+      float vy = (-y1p - cyp) / ry;
+      float a1 = vecang<Math>(1.0f,0.0f, ux,uy);   // Initial angle
+      float da = vecang<Math>(ux,uy, vx,vy);       // Delta angle
+
+      // if (vecrat(ux,uy,vx,vy) <= -1.0f) da = pi;
+      // if (vecrat(ux,uy,vx,vy) >= 1.0f) da = 0;
+
+      if (fs == 0 && da > 0)
+         da -= 2 * pi;
+      else if (fs == 1 && da < 0)
+         da += 2 * pi;
+
+      // Approximate the arc using cubic spline segments.
+      float t[6] = {cosrx, sinrx, -sinrx, cosrx, cx, cy};
+
+      // Split arc into max 90 degree segments.
+      // The loop assumes an iteration per end point
+      // (including start and end), this +1.
+      int ndivs = int(Math::abs(da) / (pi*0.5f) + 1.0f);
+      float hda = (da / (float)ndivs) / 2.0f;
+      float kappa = Math::abs(4.0f / 3.0f * (1.0f - Math::cos(hda)) / Math::sin(hda));
+      if (da < 0.0f)
+         kappa = -kappa;
+
+      float px = 0, py = 0;
+      float ptanx = 0, ptany = 0;
+      for (int i = 0; i <= ndivs; i++)
+      {
+         float a = a1 + da * ((float)i/(float)ndivs);
+         dx = Math::cos(a);
+         dy = Math::sin(a);
+         float x = 0, y = 0;
+         xform_point(x, y, dx*rx, dy*ry, t); // position
+         float tanx = 0, tany = 0;
+         xform_vec(tanx, tany, -dy*rx * kappa, dx*ry * kappa, t); // tangent
+         if (i > 0)
+            path_.bezier_curve_to(px+ptanx, py+ptany, x-tanx, y-tany, x, y);
+         px = x;
+         py = y;
+         ptanx = tanx;
+         ptany = tany;
+      }
+      p.x = x2;
+      p.y = y2;
+   }
+}
+
+#endif
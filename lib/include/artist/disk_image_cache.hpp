@@ -0,0 +1,72 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_DISK_IMAGE_CACHE_OCTOBER_19_2026)
+#define ARTIST_DISK_IMAGE_CACHE_OCTOBER_19_2026
+
+#include <artist/image.hpp>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // disk_image_cache: Keeps decoded images in a directory, so that later
+   // runs (e.g. application start) do not decode the same files again.
+   //
+   // Each entry holds the decoded pixels, as they are in memory, in a file
+   // keyed by the source path, its modification time and size, and the
+   // decode target (see image(path, target)). On a hit, the image is made
+   // by memory-mapping the entry: there is no decode and no copy, and the
+   // operating system pages the pixels in as they are drawn. Mapped pixels
+   // are copy-on-write, so writing to pixels() never changes the entry.
+   //
+   // A changed source file misses (its time or size differs) and its entry
+   // is written again. Entries are written to a temporary file first, then
+   // renamed, so processes that share a directory never see partial
+   // entries. Entries are never deleted, except by clear().
+   //
+   // Images whose pixels are not accessible (see image::format) are
+   // returned as decoded, without an entry. load is thread safe.
+   //
+   // Each path is resolved once (see find_file) and remembered, so a hit
+   // costs one stat of the source file, for both its time and size (two
+   // when the file moved, and is searched for again).
+   ////////////////////////////////////////////////////////////////////////////
+   class disk_image_cache
+   {
+   public:
+
+      explicit          disk_image_cache(fs::path directory);
+
+      // Throws if the file cannot be loaded
+      image_ptr         load(fs::path const& path, extent target = {});
+
+      void              clear();
+      fs::path const&   directory() const;
+
+   private:
+
+      fs::path          resolve(fs::path const& path);
+      void              forget(fs::path const& path);
+
+      using path_map = std::unordered_map<std::string, fs::path>;
+
+      fs::path          _directory;
+      std::mutex        _mutex;
+      path_map          _resolved;     // By requested path
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline fs::path const& disk_image_cache::directory() const
+   {
+      return _directory;
+   }
+}
+
+#endif
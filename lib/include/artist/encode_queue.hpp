@@ -0,0 +1,67 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_ENCODE_QUEUE_OCTOBER_19_2026)
+#define ARTIST_ENCODE_QUEUE_OCTOBER_19_2026
+
+#include <artist/image.hpp>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // encode_queue: Encodes images (see image::encode) on a pool of worker
+   // threads, e.g. for exporting many rendered images without stalling the
+   // rendering thread.
+   //
+   // Queued images are kept alive until they are encoded. To bound memory,
+   // the queue counts the pixel bytes of the queued images; when adding an
+   // image would go over max_bytes, encode and save wait until enough
+   // queued images are done. (An image bigger than max_bytes is still
+   // queued, once the queue is empty.) Encoded results are owned by their
+   // futures and are not counted.
+   //
+   // Errors are reported through the futures. All member functions are
+   // thread safe. The destructor waits for all queued images.
+   ////////////////////////////////////////////////////////////////////////////
+   class encode_queue
+   {
+   public:
+
+      using encoded = std::vector<std::uint8_t>;
+
+      static constexpr std::size_t default_max_bytes = 256 * 1024 * 1024;
+
+      explicit          encode_queue(
+                           std::size_t max_bytes = default_max_bytes
+                         , std::size_t num_threads = 0 // 0: one per core
+                        );
+                        ~encode_queue();
+
+                        encode_queue(encode_queue const&) = delete;
+      encode_queue&     operator=(encode_queue const&) = delete;
+
+      std::future<encoded> encode(image_ptr img, image_format format, int quality = 90);
+      std::future<void> save(
+                           image_ptr img, fs::path const& path
+                         , image_format format, int quality = 90
+                        );
+
+      void              wait();           // Until the queue is empty
+      std::size_t       bytes_queued() const;
+      std::size_t       max_bytes() const;
+
+   private:
+
+      struct state;
+      using state_ptr = std::unique_ptr<state>;
+
+      state_ptr         _state;
+   };
+}
+
+#endif
@@ -104,6 +104,16 @@ namespace cycfi::artist
       uint8_t              _stretch = font_constants::stretch_normal;
    };
 
+   ////////////////////////////////////////////////////////////////////////////
+   // Thread safety: Fonts may be constructed on any number of threads at
+   // once. A font_descr that was seen before is resolved from an immutable
+   // snapshot of the font map, found with an atomic load, without taking a
+   // lock or sharing a reference count; only the first use of a
+   // font_descr, or of a font file, does more work. Replaced snapshots are
+   // freed once no thread is reading them. A font never changes
+   // after construction, so one font (and its copies) may be used by many
+   // threads at once.
+   ////////////////////////////////////////////////////////////////////////////
    class font
    {
    public:
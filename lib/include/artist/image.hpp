@@ -7,10 +7,14 @@
 #define ARTIST_IMAGE_SEPTEMBER_5_2016
 
 #include <artist/point.hpp>
+#include <artist/rect.hpp>
 #include <artist/resources.hpp>
 #include <string_view>
 #include <cstdint>
+#include <functional>
 #include <memory>
+#include <utility>
+#include <vector>
 
 #if defined(ARTIST_SKIA)
 class SkCanvas;
@@ -26,6 +30,9 @@ namespace cycfi::artist
    class image_impl;
    using image_impl_ptr = image_impl*;
 
+   // Pixel formats for make_image. Pixels in the backend's native order
+   // (e.g. bgra32_premul for Skia on little-endian machines) are drawn as
+   // they are, without conversion.
    enum class pixel_format
    {
       invalid = -1,
@@ -33,10 +40,69 @@ namespace cycfi::artist
       rgb16,
       rgb32,            // First byte is Alpha of 1, or ignored
       rgba32,
+      bgra32,           // B, G, R, A, unpremultiplied alpha
+      bgra32_premul,    // B, G, R, A, premultiplied alpha
+      rgba32_premul,    // R, G, B, A, premultiplied alpha
+      alpha8,           // Alpha only, e.g. masks
+      rgba_f16,         // R, G, B, A half floats, premultiplied alpha
+      rgb565 = rgb16
    };
 
+   // pixel_type<fmt>: The type make_image takes the pixels as, one per pixel
+   template <pixel_format fmt>
+   struct pixel_type;
+
+   template <> struct pixel_type<pixel_format::gray8>          { using type = std::uint8_t; };
+   template <> struct pixel_type<pixel_format::rgb16>          { using type = std::uint16_t; };
+   template <> struct pixel_type<pixel_format::rgb32>          { using type = std::uint32_t; };
+   template <> struct pixel_type<pixel_format::rgba32>         { using type = std::uint32_t; };
+   template <> struct pixel_type<pixel_format::bgra32>         { using type = std::uint32_t; };
+   template <> struct pixel_type<pixel_format::bgra32_premul>  { using type = std::uint32_t; };
+   template <> struct pixel_type<pixel_format::rgba32_premul>  { using type = std::uint32_t; };
+   template <> struct pixel_type<pixel_format::alpha8>         { using type = std::uint8_t; };
+   template <> struct pixel_type<pixel_format::rgba_f16>       { using type = std::uint64_t; };
+
+   // Encoded image formats (see image::encode). raw is the pixels as
+   // tightly packed, premultiplied rgba32, without a header.
+   enum class image_format
+   {
+      png,
+      jpeg,
+      webp,
+      raw
+   };
+
+   class image;
+
+   // Called when a zero-copy image no longer needs the caller's pixels
+   using image_release_function = std::function<void()>;
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Zero-copy images
+   //
+   // make_image(data, size, row_bytes, release) uses the caller's pixels
+   // directly, without copying them. Rows are row_bytes apart (0 means
+   // tightly packed). The pixels must stay valid until release is called,
+   // which happens when the image, and anything still drawing from it, is
+   // gone. If the image cannot be created, release is called right away
+   // before the exception is thrown.
+   //
+   // The pixels may be changed in place, e.g. with each new camera or video
+   // frame. Call image::pixels_changed() afterwards, so that cached copies
+   // (e.g. GPU textures and mip chains) are invalidated.
+   ////////////////////////////////////////////////////////////////////////////
+   template <pixel_format fmt>
+   image make_image(
+      typename pixel_type<fmt>::type* data, extent size, std::size_t row_bytes
+    , image_release_function release = {});
+
    ////////////////////////////////////////////////////////////////////////////
    // image
+   //
+   // Thread safety: One image may be drawn by many threads at once; copies
+   // the backend keeps for drawing are built once, under a lock. Writing
+   // its pixels(), calling pixels_changed() or drawing into it with an
+   // offscreen_image needs exclusive access to it.
    ////////////////////////////////////////////////////////////////////////////
    class image
    {
@@ -44,7 +110,22 @@ namespace cycfi::artist
 
       explicit          image(float sizex, float sizey);
       explicit          image(extent size);
+
+      // Load an encoded image (PNG, JPEG, etc.) from a file or from
+      // memory. Files are memory-mapped, not read into a buffer. The
+      // encoded bytes in memory are not needed once the constructor
+      // returns (Skia decodes them in place, Quartz keeps a copy).
       explicit          image(fs::path const& path_);
+                        image(std::uint8_t const* encoded, std::size_t size);
+
+      // Load a file at reduced resolution, e.g. for thumbnails. The image is
+      // downsampled while decoding, by as much as possible while staying at
+      // least as big as the image scaled to fit target. The result may be
+      // bigger than target, but never bigger than the image.
+                        image(fs::path const& path_, extent target);
+
+      // Load only the subset (in image pixel coordinates) of a file
+                        image(fs::path const& path_, rect subset);
 
                         image(image const& rhs) = delete;
                         image(image&& rhs) noexcept;
@@ -57,26 +138,58 @@ namespace cycfi::artist
       extent            size() const;
       void              save_png(std::string_view path) const;
 
+      // Encode the image to memory or a file. quality (0 to 100) is used by
+      // jpeg and webp; for webp, 100 means lossless. Bitmap backed images
+      // are encoded straight from their pixels. Throws if the format is
+      // not supported by the backend. Images may be encoded on any thread,
+      // as long as they are not being changed at the same time.
+      std::vector<std::uint8_t> encode(image_format format, int quality = 90) const;
+      void              save(fs::path const& path, image_format format, int quality = 90) const;
+
+      // After writing to pixels(), call pixels_changed() so that cached
+      // copies of the image (e.g. mip chains) are rebuilt. pixels() is
+      // meant for the 32 bit formats; bytes() is the same memory, for any
+      // format.
       uint32_t*         pixels();
       uint32_t const*   pixels() const;
+      std::uint8_t*     bytes();
+      std::uint8_t const* bytes() const;
       extent            bitmap_size() const;
+      void              pixels_changed();
+
+      // A purgeable image gives up its decoded pixels when images go over
+      // the memory budget (see image_memory_budget), least recently drawn
+      // first, and decodes them again from its file the next time it is
+      // drawn or encoded. The file must stay in place; if it can no longer
+      // be decoded, the image draws nothing. Only images loaded from a
+      // file can be purgeable. Reading or writing pixels() or bytes()
+      // makes the image not purgeable again. Like writing to the pixels,
+      // purgeable(flag) needs exclusive access to the image. On Quartz,
+      // which purges its own image caches, this does nothing.
+      void              purgeable(bool flag);
+      bool              purgeable() const;
+
+      // The layout of bytes(): its format, and the bytes from one row to
+      // the next. invalid and 0 if the image has no pixels() (or, on
+      // Quartz, a layout that has no pixel_format).
+      pixel_format      format() const;
+      std::size_t       row_bytes() const;
 
    private:
 
       template <pixel_format fmt>
-      friend typename std::enable_if<(fmt == pixel_format::gray8), image>::type
-      make_image(std::uint8_t const* data, extent size);
-
-      template <pixel_format fmt>
-      friend typename std::enable_if<(fmt == pixel_format::rgb16), image>::type
-      make_image(std::uint16_t const* data, extent size);
+      friend image      make_image(typename pixel_type<fmt>::type const* data, extent size);
 
       template <pixel_format fmt>
-      friend typename std::enable_if<
-         (fmt == pixel_format::rgb32 || fmt == pixel_format::rgba32), image>::type
-      make_image(std::uint32_t const* data, extent size);
+      friend image      make_image(
+                           typename pixel_type<fmt>::type* data, extent size
+                         , std::size_t row_bytes, image_release_function release);
 
       explicit          image(std::uint8_t const* data, pixel_format fmt, extent size);
+                        image(
+                           std::uint8_t* data, pixel_format fmt, extent size
+                         , std::size_t row_bytes, image_release_function release
+                        );
       size_t            _pixmap_size(pixel_format, extent size);
 
       image_impl_ptr    _impl;
@@ -110,25 +223,18 @@ namespace cycfi::artist
    // Inlines
    ////////////////////////////////////////////////////////////////////////////
    template <pixel_format fmt>
-   inline typename std::enable_if<(fmt == pixel_format::gray8), image>::type
-   make_image(std::uint8_t const* data, extent size)
-   {
-      return image(data, fmt, size);
-   }
-
-   template <pixel_format fmt>
-   inline typename std::enable_if<(fmt == pixel_format::rgb16), image>::type
-   make_image(std::uint16_t const* data, extent size)
+   inline image make_image(typename pixel_type<fmt>::type const* data, extent size)
    {
       return image(reinterpret_cast<std::uint8_t const*>(data), fmt, size);
    }
 
    template <pixel_format fmt>
-   inline typename std::enable_if<
-      (fmt == pixel_format::rgb32 || fmt == pixel_format::rgba32), image>::type
-   make_image(std::uint32_t const* data, extent size)
+   inline image make_image(
+      typename pixel_type<fmt>::type* data, extent size, std::size_t row_bytes
+    , image_release_function release)
    {
-      return image(reinterpret_cast<std::uint8_t const*>(data), fmt, size);
+      return image(
+         reinterpret_cast<std::uint8_t*>(data), fmt, size, row_bytes, std::move(release));
    }
 
    inline image::image(float sizex, float sizey)
@@ -144,11 +250,8 @@ namespace cycfi::artist
 
    inline image& image::operator=(image&& rhs) noexcept
    {
-      if (this != &rhs)
-      {
-         _impl = std::move(rhs._impl);
-         rhs._impl = nullptr;
-      }
+      // rhs takes our old image and destroys it
+      std::swap(_impl, rhs._impl);
       return *this;
    }
 }
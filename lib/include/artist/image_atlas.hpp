@@ -0,0 +1,179 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_IMAGE_ATLAS_OCTOBER_19_2026)
+#define ARTIST_IMAGE_ATLAS_OCTOBER_19_2026
+
+#include <artist/canvas.hpp>
+#include <artist/image.hpp>
+#include <stdexcept>
+#include <vector>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // image_atlas: A sprite sheet plus a list of sprites to draw from it, for
+   // drawing many small images in a single draw call (see
+   // canvas::draw_atlas).
+   //
+   // Sprites are rectangles (in sheet pixel coordinates) added with
+   // add_sprite, or cut from a uniform grid of cells. Each frame, clear()
+   // the draw list and add() the sprites to draw, each with a transform
+   // from the sprite's own coordinates (its top-left at 0, 0) to the
+   // canvas, and a tint that multiplies the sprite's colors. The lists
+   // keep their capacity across clear(), and canvas::draw_atlas keeps its
+   // own buffers per thread, so a steady frame loop does not allocate
+   // them again.
+   //
+   // The grid cell must not be empty (throws std::runtime_error).
+   ////////////////////////////////////////////////////////////////////////////
+   class image_atlas
+   {
+   public:
+
+      explicit                   image_atlas(image_ptr sheet);
+                                 image_atlas(image_ptr sheet, extent cell);
+
+      image const&               sheet() const;
+
+      // Sprites
+      std::size_t                add_sprite(rect const& src);
+      rect const&                sprite(std::size_t i) const;
+      std::size_t                num_sprites() const;
+
+      // Draw list
+      void                       add(
+                                    std::size_t sprite
+                                  , affine_transform const& xf
+                                  , color tint = colors::white
+                                 );
+      void                       add(std::size_t sprite, point pos, color tint = colors::white);
+      void                       clear();
+      std::size_t                size() const;
+      bool                       empty() const;
+      bool                       tinted() const;
+
+      rect const*                src() const;
+      affine_transform const*    transforms() const;
+      color const*               tints() const;
+
+   private:
+
+      image_ptr                  _sheet;
+      std::vector<rect>          _sprites;
+      std::vector<rect>          _src;
+      std::vector<affine_transform> _xf;
+      std::vector<color>         _tint;
+      bool                       _tinted = false;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline image_atlas::image_atlas(image_ptr sheet)
+    : _sheet{std::move(sheet)}
+   {
+   }
+
+   // Cuts the sheet into cells, row by row from the top-left. Partial
+   // cells at the right and bottom edges are left out.
+   inline image_atlas::image_atlas(image_ptr sheet, extent cell)
+    : _sheet{std::move(sheet)}
+   {
+      if (cell.x <= 0 || cell.y <= 0)
+         throw std::runtime_error{"Error: Empty image_atlas cell."};
+      auto size = _sheet->size();
+      auto cols = int(size.x / cell.x);
+      auto rows = int(size.y / cell.y);
+      _sprites.reserve(cols * rows);
+      for (int row = 0; row != rows; ++row)
+         for (int col = 0; col != cols; ++col)
+            _sprites.push_back(rect{col * cell.x, row * cell.y, cell});
+   }
+
+   inline image const& image_atlas::sheet() const
+   {
+      return *_sheet;
+   }
+
+   inline std::size_t image_atlas::add_sprite(rect const& src)
+   {
+      _sprites.push_back(src);
+      return _sprites.size() - 1;
+   }
+
+   inline rect const& image_atlas::sprite(std::size_t i) const
+   {
+      return _sprites[i];
+   }
+
+   inline std::size_t image_atlas::num_sprites() const
+   {
+      return _sprites.size();
+   }
+
+   inline void image_atlas::add(std::size_t sprite, affine_transform const& xf, color tint)
+   {
+      _src.push_back(_sprites[sprite]);
+      _xf.push_back(xf);
+      _tint.push_back(tint);
+      if (tint != colors::white)
+         _tinted = true;
+   }
+
+   inline void image_atlas::add(std::size_t sprite, point pos, color tint)
+   {
+      add(sprite, make_translation(pos.x, pos.y), tint);
+   }
+
+   inline void image_atlas::clear()
+   {
+      _src.clear();
+      _xf.clear();
+      _tint.clear();
+      _tinted = false;
+   }
+
+   inline std::size_t image_atlas::size() const
+   {
+      return _src.size();
+   }
+
+   inline bool image_atlas::empty() const
+   {
+      return _src.empty();
+   }
+
+   inline bool image_atlas::tinted() const
+   {
+      return _tinted;
+   }
+
+   inline rect const* image_atlas::src() const
+   {
+      return _src.data();
+   }
+
+   inline affine_transform const* image_atlas::transforms() const
+   {
+      return _xf.data();
+   }
+
+   inline color const* image_atlas::tints() const
+   {
+      return _tint.data();
+   }
+
+   inline void canvas::draw_atlas(image_atlas const& atlas)
+   {
+      draw_atlas(
+         atlas.sheet(), atlas.src(), atlas.transforms()
+       , atlas.tinted()? atlas.tints() : nullptr
+       , atlas.size()
+      );
+   }
+}
+
+#endif
@@ -0,0 +1,92 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_IMAGE_CACHE_OCTOBER_19_2026)
+#define ARTIST_IMAGE_CACHE_OCTOBER_19_2026
+
+#include <artist/image.hpp>
+#include <functional>
+#include <future>
+#include <memory>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // image_cache: Loads images on a pool of worker threads and keeps them in
+   // a cache, so the UI thread never waits for a decode, and an image that
+   // is used again is not decoded again.
+   //
+   // Images are keyed by their resolved path (see find_file) and decode
+   // target (see image(path, target); an empty target decodes at full
+   // resolution). Loads of an image that is already being decoded share
+   // that decode. Each path is resolved once, and remembered until clear()
+   // or until the file fails to load, so that loads and finds of cached
+   // images make no file system calls.
+   //
+   // The cache is bounded by a byte budget. When it is over budget, the
+   // least recently used images are dropped. An image bigger than the whole
+   // budget is still loaded, but not kept. Dropping an image only releases
+   // the cache's reference; image_ptrs held elsewhere stay valid. The
+   // cache also drops its least recently used images when the library-wide
+   // image memory budget is exceeded (see image_memory_budget).
+   //
+   // All member functions are thread safe. Callbacks are called on a worker
+   // thread (or right away on the calling thread, if the image is already
+   // in the cache), so UI code should hand the result back to the UI
+   // thread. When the cache is destroyed, loads that have not started are
+   // abandoned: their futures report std::future_error (broken_promise) and
+   // their callbacks are not called.
+   ////////////////////////////////////////////////////////////////////////////
+   class image_cache
+   {
+   public:
+
+      using image_future = std::shared_future<image_ptr>;
+      using load_callback = std::function<void(image_ptr img)>;
+
+      static constexpr std::size_t default_budget = 256 * 1024 * 1024;
+
+      explicit          image_cache(
+                           std::size_t budget = default_budget
+                         , std::size_t num_threads = 0 // 0: one per core
+                        );
+                        ~image_cache();
+
+                        image_cache(image_cache const&) = delete;
+      image_cache&      operator=(image_cache const&) = delete;
+
+      // Load an image. If loading fails, the future holds the exception
+      // and the callback gets a nullptr.
+      image_future      load(fs::path const& path, extent target = {});
+      void              load(fs::path const& path, load_callback callback);
+      void              load(fs::path const& path, extent target, load_callback callback);
+
+      // The image if it is already in the cache, else nullptr. This never
+      // waits for a load.
+      image_ptr         find(fs::path const& path, extent target = {}) const;
+
+      std::size_t       budget() const;
+      void              budget(std::size_t bytes);
+      std::size_t       bytes_used() const;
+      void              clear();
+
+   private:
+
+      struct state;
+      using state_ptr = std::unique_ptr<state>;
+
+      state_ptr         _state;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline void image_cache::load(fs::path const& path, load_callback callback)
+   {
+      load(path, {}, std::move(callback));
+   }
+}
+
+#endif
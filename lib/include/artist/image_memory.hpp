@@ -0,0 +1,107 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_IMAGE_MEMORY_OCTOBER_19_2026)
+#define ARTIST_IMAGE_MEMORY_OCTOBER_19_2026
+
+#include <cstddef>
+#include <functional>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // Image memory accounting: the bytes held by all live images, and by
+   // the library's caches of pixels and shaped text, library wide, by kind.
+   //
+   // bitmap_bytes are the pixels images own (decoded files and copied pixel
+   // buffers). borrowed_bytes are the caller's pixels used by zero-copy
+   // images (see make_image), including memory-mapped ones; they are
+   // reported, but not counted against the budget. picture_bytes are the
+   // recorded drawings of offscreen_image, as estimated by the backend.
+   // cached_bytes are copies the backend keeps for drawing, such as mip
+   // chains (see canvas::image_sampling).
+   //
+   // surface_pool_bytes are the idle buffers of the surface_pool (buffers
+   // in use are counted by the images using them). raster_cache_bytes are
+   // the rasters of the raster_cache, and text_cache_bytes an estimate of
+   // the shaped text in the text_cache. Each cache also has a cap of its
+   // own, for itself alone.
+   //
+   // On Quartz, whose images decode and cache on their own, every image is
+   // counted as bitmap_bytes, estimated at 4 bytes per pixel of its size.
+   ////////////////////////////////////////////////////////////////////////////
+   struct image_memory_stats
+   {
+      std::size_t       images = 0;
+      std::size_t       bitmap_bytes = 0;
+      std::size_t       borrowed_bytes = 0;
+      std::size_t       picture_bytes = 0;
+      std::size_t       cached_bytes = 0;
+      std::size_t       surface_pool_bytes = 0;
+      std::size_t       raster_cache_bytes = 0;
+      std::size_t       text_cache_bytes = 0;
+      std::size_t       budget = 0;
+      std::size_t       evictions = 0;    // Evictor calls so far
+
+      std::size_t       total_bytes() const; // All but borrowed_bytes
+   };
+
+   image_memory_stats   image_memory();
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Image memory budget: one budget for the images and the caches. Whenever
+   // an image or a cache goes over the budget (0, the default, means no
+   // budget), the evictors are called, in the order they were added, until
+   // total_bytes() is back within the budget, going over them again as
+   // long as they free memory. An evictor is asked to release at least the
+   // given number of bytes, by dropping what it can make again on demand:
+   // the image_cache registers one for its least recently used images,
+   // another purges purgeable images (see image::purgeable), and the
+   // surface_pool, raster_cache and text_cache each register one for
+   // their least recently used entries. Memory is given back as the images
+   // are destroyed or purged, so images still in use elsewhere free
+   // nothing.
+   //
+   // Evictors are called on the thread that went over the budget, by one
+   // thread at a time, and never from within an evictor. After
+   // remove_image_evictor returns, the evictor is no longer called. All
+   // functions are thread safe.
+   ////////////////////////////////////////////////////////////////////////////
+   using image_evictor = std::function<void(std::size_t bytes)>;
+
+   void                 image_memory_budget(std::size_t bytes);
+   std::size_t          add_image_evictor(image_evictor evictor);
+   void                 remove_image_evictor(std::size_t id);
+
+   namespace detail
+   {
+      // Called by the backends: an image's usage changed from `from` to
+      // `to`. The images count is 1 for a live image. May call evictors.
+      void              update_image_memory(
+                           image_memory_stats const& from
+                         , image_memory_stats const& to
+                        );
+
+      // Called by the caches, with their own lock held: the bytes they hold
+      // changed. This does not call the evictors, which lock the caches:
+      // call enforce_image_memory_budget once the lock is released.
+      void              update_cache_memory(
+                           image_memory_stats const& from
+                         , image_memory_stats const& to
+                        );
+      void              enforce_image_memory_budget();
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline std::size_t image_memory_stats::total_bytes() const
+   {
+      return bitmap_bytes + picture_bytes + cached_bytes
+         + surface_pool_bytes + raster_cache_bytes + text_cache_bytes;
+   }
+}
+
+#endif
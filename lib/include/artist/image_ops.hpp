@@ -0,0 +1,48 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_IMAGE_OPS_OCTOBER_19_2026)
+#define ARTIST_IMAGE_OPS_OCTOBER_19_2026
+
+#include <artist/image.hpp>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // image_ops: CPU image processing on the pixels() of bitmap images with
+   // four 8-bit channels (rgb32, rgba32, bgra32, bgra32_premul and
+   // rgba32_premul). Other images throw std::runtime_error.
+   //
+   // All channels, alpha included, are filtered the same way, so channel
+   // order does not matter. Filter premultiplied pixels for correct edges
+   // around transparent areas. Pixels past the edges of the image repeat
+   // the edge pixels.
+   //
+   // The filters use the widest SIMD instruction set available at
+   // runtime, and large images are split into bands of rows, one per
+   // core. The in-place operations call image::pixels_changed().
+   ////////////////////////////////////////////////////////////////////////////
+   namespace image_ops
+   {
+      enum class resize_filter
+      {
+         bilinear,
+         lanczos3
+      };
+
+      // Separable blurs. radius and sigma are in pixels; 0 does nothing.
+      void  box_blur(image& img, int radius);
+      void  gaussian_blur(image& img, float sigma);
+
+      // Convolve with a size x size kernel, given row by row. size must be
+      // odd, e.g. 3 or 5.
+      void  convolve(image& img, float const kernel[], int size);
+
+      // A resized copy of img, in the same pixel format
+      image resize(image const& img, extent size, resize_filter filter = resize_filter::lanczos3);
+   }
+}
+
+#endif
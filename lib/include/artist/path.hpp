@@ -12,6 +12,8 @@
 #include <algorithm>
 #include <string_view>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
 
 #if defined(ARTIST_QUARTZ_2D)
 using path_impl = struct CGPath;
@@ -21,6 +23,26 @@ using path_impl = class SkPath;
 
 namespace cycfi::artist
 {
+   ////////////////////////////////////////////////////////////////////////////
+   // Path verbs for bulk appending (see path::append). Each verb consumes
+   // points from the point array: move: 1, line: 1, quad: 2, cubic: 3,
+   // close: 0. The point count must agree with the verbs. The values match
+   // Skia's SkPathVerb so the arrays can be handed over as-is.
+   ////////////////////////////////////////////////////////////////////////////
+   enum class path_verb : std::uint8_t
+   {
+      move  = 0,
+      line  = 1,
+      quad  = 2,
+      cubic = 4,
+      close = 5
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Thread safety: path is a value. Its const member functions (and
+   // drawing it) may be called by many threads at once, but changing a
+   // path needs exclusive access to it.
+   ////////////////////////////////////////////////////////////////////////////
    class path
    {
    public:
@@ -90,6 +112,11 @@ namespace cycfi::artist
                            float x, float y
                         );
 
+      void              append(
+                           path_verb const verbs[], std::size_t num_verbs
+                         , point const points[], std::size_t num_points
+                        );
+
       enum fill_rule_enum
       {
          fill_winding,
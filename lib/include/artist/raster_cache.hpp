@@ -0,0 +1,64 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_RASTER_CACHE_OCTOBER_19_2026)
+#define ARTIST_RASTER_CACHE_OCTOBER_19_2026
+
+#include <artist/canvas.hpp>
+#include <cstddef>
+
+namespace cycfi::artist
+{
+   struct raster_cache_stats
+   {
+      std::size_t       entries = 0;         // Keys seen, rasterized or not
+      std::size_t       rasters = 0;         // Entries with a raster
+      std::size_t       bytes = 0;           // Held by the rasters
+      std::size_t       max_bytes = 0;
+      std::size_t       hits = 0;            // Draws that blitted a raster
+      std::size_t       misses = 0;          // Draws that drew directly
+      std::size_t       rasterizations = 0;
+      std::size_t       evictions = 0;       // Rasters dropped to stay under max_bytes
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // raster_cache: The library-wide cache behind canvas::cached.
+   //
+   // Content drawn with canvas::cached is drawn directly until it has been
+   // drawn in min_frames frames in a row with the same key, bounds and
+   // device scale. It is then rasterized once, at the device scale, and
+   // later draws blit the raster. Frames are counted by next_frame, which
+   // the application calls once per frame, after drawing it. Content that
+   // skips a frame starts counting again, and so does a change of bounds
+   // or scale, which also drops the raster. Content that changes needs a
+   // new key (e.g. one that includes a version number).
+   //
+   // Rasters no longer drawn are the first to be evicted when the rasters
+   // go over max_bytes, or the library over its memory budget (see
+   // image_memory_budget), which counts the rasters. Keys without a raster
+   // are forgotten once they miss a frame.
+   //
+   // Rasters are only used while the transform is a scale and translation;
+   // rotated or skewed content is drawn directly. Keys are library wide,
+   // shared by all canvases. All functions are thread safe.
+   ////////////////////////////////////////////////////////////////////////////
+   namespace raster_cache
+   {
+      constexpr std::size_t default_max_bytes = 32 * 1024 * 1024;
+      constexpr int default_min_frames = 3;
+
+      std::size_t          max_bytes();
+      void                 max_bytes(std::size_t bytes);
+      int                  min_frames();
+      void                 min_frames(int frames);
+      void                 next_frame();
+
+      void                 invalidate(std::size_t key);
+      void                 clear();
+      raster_cache_stats   stats();
+   }
+}
+
+#endif
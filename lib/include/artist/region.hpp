@@ -0,0 +1,194 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_REGION_OCTOBER_19_2026)
+#define ARTIST_REGION_OCTOBER_19_2026
+
+#include <artist/rect.hpp>
+#include <initializer_list>
+#include <vector>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // region: A set of non-overlapping rectangles, e.g. for damage tracking,
+   // clipping and occlusion.
+   //
+   // The rectangles are kept in y-x banded form: the region is split into
+   // horizontal bands, each band is a run of rectangles sharing the same top
+   // and bottom, sorted left to right. Bands are sorted top to bottom, and
+   // vertically adjacent bands with the same horizontal spans are merged.
+   // Because of this, two regions covering the same area always compare
+   // equal, and iteration yields the rectangles top to bottom, left to
+   // right.
+   //
+   // Rectangles are treated as half-open: [left, right) x [top, bottom).
+   // Empty (zero area) and invalid rectangles are ignored.
+   ////////////////////////////////////////////////////////////////////////////
+   class region
+   {
+   public:
+
+      using const_iterator = std::vector<rect>::const_iterator;
+
+                        region() = default;
+                        region(rect const& r);
+                        region(std::initializer_list<rect> rects);
+
+      bool              operator==(region const& other) const;
+      bool              operator!=(region const& other) const;
+
+      bool              is_empty() const;
+      std::size_t       size() const;
+      rect              bounds() const;
+      void              clear();
+
+      const_iterator    begin() const;
+      const_iterator    end() const;
+      rect const*       data() const;
+
+      bool              contains(point p) const;
+      bool              contains(rect const& r) const;
+      bool              intersects(rect const& r) const;
+
+      region&           operator|=(region const& other);    // union
+      region&           operator&=(region const& other);    // intersection
+      region&           operator-=(region const& other);    // difference
+      region&           operator^=(region const& other);    // xor
+
+      region&           move(float dx, float dy);
+
+      // Merge rectangles until there are at most max_rects, adding as little
+      // area as possible. The result always covers the original region. This
+      // is useful for damage tracking, where a few slightly larger repaint
+      // rectangles are cheaper than many tiny ones.
+      region&           simplify(std::size_t max_rects);
+
+   private:
+
+      enum op_enum { op_union, op_intersect, op_difference, op_xor };
+
+      static region     combine(region const& a, region const& b, op_enum op);
+      void              coalesce();
+
+      std::vector<rect> _rects;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Free Functions
+   ////////////////////////////////////////////////////////////////////////////
+   region               union_(region const& a, region const& b);
+   region               intersection(region const& a, region const& b);
+   region               difference(region const& a, region const& b);
+
+   region               operator|(region const& a, region const& b);
+   region               operator&(region const& a, region const& b);
+   region               operator-(region const& a, region const& b);
+   region               operator^(region const& a, region const& b);
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline bool region::operator==(region const& other) const
+   {
+      return _rects == other._rects;
+   }
+
+   inline bool region::operator!=(region const& other) const
+   {
+      return !(*this == other);
+   }
+
+   inline bool region::is_empty() const
+   {
+      return _rects.empty();
+   }
+
+   inline std::size_t region::size() const
+   {
+      return _rects.size();
+   }
+
+   inline void region::clear()
+   {
+      _rects.clear();
+   }
+
+   inline region::const_iterator region::begin() const
+   {
+      return _rects.begin();
+   }
+
+   inline region::const_iterator region::end() const
+   {
+      return _rects.end();
+   }
+
+   inline rect const* region::data() const
+   {
+      return _rects.data();
+   }
+
+   inline region& region::operator|=(region const& other)
+   {
+      return *this = combine(*this, other, op_union);
+   }
+
+   inline region& region::operator&=(region const& other)
+   {
+      return *this = combine(*this, other, op_intersect);
+   }
+
+   inline region& region::operator-=(region const& other)
+   {
+      return *this = combine(*this, other, op_difference);
+   }
+
+   inline region& region::operator^=(region const& other)
+   {
+      return *this = combine(*this, other, op_xor);
+   }
+
+   inline region union_(region const& a, region const& b)
+   {
+      return a | b;
+   }
+
+   inline region intersection(region const& a, region const& b)
+   {
+      return a & b;
+   }
+
+   inline region difference(region const& a, region const& b)
+   {
+      return a - b;
+   }
+
+   inline region operator|(region const& a, region const& b)
+   {
+      region r = a;
+      return r |= b;
+   }
+
+   inline region operator&(region const& a, region const& b)
+   {
+      region r = a;
+      return r &= b;
+   }
+
+   inline region operator-(region const& a, region const& b)
+   {
+      region r = a;
+      return r -= b;
+   }
+
+   inline region operator^(region const& a, region const& b)
+   {
+      region r = a;
+      return r ^= b;
+   }
+}
+
+#endif
@@ -0,0 +1,406 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_STATIC_PATH_OCTOBER_19_2026)
+#define ARTIST_STATIC_PATH_OCTOBER_19_2026
+
+#include <artist/path.hpp>
+#include <artist/detail/arc_to_curve.hpp>
+#include <cstddef>
+#include <stdexcept>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // basic_static_path: Fixed-size verb and point arrays, built at compile
+   // time by static_path (below). Converting to a path is a single bulk
+   // append.
+   ////////////////////////////////////////////////////////////////////////////
+   template <std::size_t MaxVerbs, std::size_t MaxPoints>
+   struct basic_static_path
+   {
+      constexpr bool    is_empty() const { return num_verbs == 0; }
+                        operator path() const;
+
+      path_verb         verbs[MaxVerbs] = {};
+      point             points[MaxPoints] = {};
+      std::size_t       num_verbs = 0;
+      std::size_t       num_points = 0;
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // static_path: Parse an SVG path string at compile time:
+   //
+   //    constexpr auto icon = static_path("M 0 0 L 10 10 Z");
+   //    path p = icon;
+   //
+   // The syntax is the same as path(std::string_view), and arcs go through
+   // the same arc_to_curve conversion, only with constexpr math. The array
+   // capacities are derived from the length of the literal, which is always
+   // enough. Unlike the runtime parser, malformed input (unknown commands,
+   // missing or bad numbers) is an error. In a constexpr context, that is a
+   // compile error. Otherwise, it throws std::runtime_error.
+   ////////////////////////////////////////////////////////////////////////////
+   template <std::size_t N>
+   constexpr auto static_path(char const (&svg_def)[N]);
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   template <std::size_t MaxVerbs, std::size_t MaxPoints>
+   inline basic_static_path<MaxVerbs, MaxPoints>::operator path() const
+   {
+      path r;
+      r.append(verbs, num_verbs, points, num_points);
+      return r;
+   }
+
+   namespace detail
+   {
+      constexpr bool is_svg_space(char c)
+      {
+         return c == ' ' || c == '\t' || c == '\n' || c == '\r'
+            || c == '\f' || c == '\v' || c == ','
+            ;
+      }
+
+      constexpr bool is_digit(char c)
+      {
+         return c >= '0' && c <= '9';
+      }
+
+      template <std::size_t MaxVerbs, std::size_t MaxPoints>
+      class static_path_builder
+      {
+      public:
+
+         using path_type = basic_static_path<MaxVerbs, MaxPoints>;
+
+         constexpr static_path_builder(path_type& path_)
+          : _path{path_}
+         {}
+
+         constexpr void move_to(point p)
+         {
+            add_verb(path_verb::move);
+            add_point(p);
+            _start = p;
+         }
+
+         constexpr void line_to(point p)
+         {
+            begin_contour();
+            add_verb(path_verb::line);
+            add_point(p);
+         }
+
+         constexpr void line_to(float x, float y)
+         {
+            line_to({x, y});
+         }
+
+         constexpr void quadratic_curve_to(point cp, point end)
+         {
+            begin_contour();
+            add_verb(path_verb::quad);
+            add_point(cp);
+            add_point(end);
+         }
+
+         constexpr void bezier_curve_to(point cp1, point cp2, point end)
+         {
+            begin_contour();
+            add_verb(path_verb::cubic);
+            add_point(cp1);
+            add_point(cp2);
+            add_point(end);
+         }
+
+         constexpr void bezier_curve_to(
+            float cp1x, float cp1y
+          , float cp2x, float cp2y
+          , float x, float y)
+         {
+            bezier_curve_to({cp1x, cp1y}, {cp2x, cp2y}, {x, y});
+         }
+
+         constexpr void close()
+         {
+            // Same as the backends: closing an empty or already closed
+            // contour does nothing.
+            if (_path.num_verbs != 0 && last_verb() != path_verb::close)
+               add_verb(path_verb::close);
+         }
+
+      private:
+
+         constexpr path_verb last_verb() const
+         {
+            return _path.verbs[_path.num_verbs-1];
+         }
+
+         // Drawing without a current contour starts a new one at the
+         // start of the last contour (or the origin), like the backends do.
+         constexpr void begin_contour()
+         {
+            if (_path.num_verbs == 0 || last_verb() == path_verb::close)
+            {
+               add_verb(path_verb::move);
+               add_point(_start);
+            }
+         }
+
+         constexpr void add_verb(path_verb v)
+         {
+            if (_path.num_verbs == MaxVerbs)
+               throw std::runtime_error{"Error: static_path verb capacity exceeded."};
+            _path.verbs[_path.num_verbs++] = v;
+         }
+
+         constexpr void add_point(point p)
+         {
+            if (_path.num_points == MaxPoints)
+               throw std::runtime_error{"Error: static_path point capacity exceeded."};
+            _path.points[_path.num_points++] = p;
+         }
+
+         path_type&     _path;
+         point          _start;
+      };
+
+      // This mirrors the runtime parser in svg_path.cpp
+      template <std::size_t MaxVerbs, std::size_t MaxPoints>
+      class static_svg_parser
+      {
+      public:
+
+         using builder_type = static_path_builder<MaxVerbs, MaxPoints>;
+
+         constexpr static_svg_parser(
+            char const* first, char const* last, builder_type& builder)
+          : _s{first}, _last{last}, _builder{builder}
+         {}
+
+         constexpr void parse()
+         {
+            char cmd = 0;
+            bool abs = true;
+            while (true)
+            {
+               skip_to_next();
+               if (_s == _last)
+                  break;
+               command(cmd, abs);
+               dispatch(cmd, abs);
+            }
+         }
+
+      private:
+
+         constexpr void skip_to_next()
+         {
+            while (_s != _last && is_svg_space(*_s))
+               ++_s;
+         }
+
+         constexpr float coord(bool abs = true, float base = 0)
+         {
+            skip_to_next();
+            auto s = _s;
+            bool neg = false;
+            if (s != _last && (*s == '+' || *s == '-'))
+               neg = *s++ == '-';
+
+            double mantissa = 0;
+            int scale = 0;
+            bool digits = false;
+            for (; s != _last && is_digit(*s); ++s, digits = true)
+               mantissa = mantissa * 10 + (*s - '0');
+            if (s != _last && *s == '.')
+            {
+               for (++s; s != _last && is_digit(*s); ++s, --scale, digits = true)
+                  mantissa = mantissa * 10 + (*s - '0');
+            }
+            if (!digits)
+               throw std::runtime_error{"Error: Invalid SVG path syntax: number expected."};
+
+            if (s != _last && (*s == 'e' || *s == 'E'))
+            {
+               auto e = s + 1;
+               bool exp_neg = false;
+               if (e != _last && (*e == '+' || *e == '-'))
+                  exp_neg = *e++ == '-';
+               if (e != _last && is_digit(*e))
+               {
+                  int exp = 0;
+                  for (; e != _last && is_digit(*e); ++e)
+                     exp = exp * 10 + (*e - '0');
+                  scale += exp_neg? -exp : exp;
+                  s = e;
+               }
+            }
+            _s = s;
+
+            double val = mantissa;
+            for (; scale > 0; --scale)
+               val *= 10;
+            for (; scale < 0; ++scale)
+               val /= 10;
+            auto r = float(neg? -val : val);
+            return abs? r : r + base;
+         }
+
+         constexpr bool flag()
+         {
+            skip_to_next();
+            if (_s == _last || !is_digit(*_s))
+               throw std::runtime_error{"Error: Invalid SVG path syntax: flag expected."};
+            bool r = false;
+            for (; _s != _last && is_digit(*_s); ++_s)
+               r = r || *_s != '0';
+            return r;
+         }
+
+         constexpr point coords(bool abs, point base)
+         {
+            auto x = coord(abs, base.x);
+            auto y = coord(abs, base.y);
+            return {x, y};
+         }
+
+         constexpr void command(char& cmd, bool& abs)
+         {
+            auto c = *_s;
+            auto uc = (c >= 'a' && c <= 'z')? char(c - 'a' + 'A') : c;
+            switch (uc)
+            {
+               case 'M': case 'L': case 'H':
+               case 'V': case 'C': case 'S':
+               case 'Q': case 'T': case 'A':
+               case 'Z':
+               {
+                  abs = uc == c;
+                  cmd = uc;
+                  ++_s;
+                  return;
+               }
+            }
+
+            // Not a command. This is an implicit repeat of the previous
+            // command, which must be there and must take arguments.
+            if (cmd == 0 || cmd == 'Z')
+               throw std::runtime_error{"Error: Invalid SVG path syntax: command expected."};
+         }
+
+         constexpr void dispatch(char cmd, bool abs)
+         {
+            switch (cmd)
+            {
+               case 'M':
+               {
+                  auto m = coords(abs, p);
+                  _builder.move_to(m);
+                  p = prev_qp = prev_cp = m;
+                  break;
+               }
+               case 'L':
+               {
+                  auto l = coords(abs, p);
+                  _builder.line_to(l);
+                  p = prev_qp = prev_cp = l;
+                  break;
+               }
+               case 'H':
+               {
+                  auto lx = coord(abs, p.x);
+                  _builder.line_to(lx, p.y);
+                  p.x = prev_qp.x = prev_cp.x = lx;
+                  break;
+               }
+               case 'V':
+               {
+                  auto ly = coord(abs, p.y);
+                  _builder.line_to(p.x, ly);
+                  p.y = prev_qp.y = prev_cp.y = ly;
+                  break;
+               }
+               case 'C':
+               {
+                  auto cp1 = coords(abs, p);
+                  auto cp2 = coords(abs, p);
+                  auto end = coords(abs, p);
+                  _builder.bezier_curve_to(cp1, cp2, end);
+                  p = prev_qp = end;
+                  prev_cp = p.reflect(cp2);
+                  break;
+               }
+               case 'S':
+               {
+                  auto cp2 = coords(abs, p);
+                  auto end = coords(abs, p);
+                  _builder.bezier_curve_to(prev_cp, cp2, end);
+                  p = prev_qp = end;
+                  prev_cp = p.reflect(cp2);
+                  break;
+               }
+               case 'Q':
+               {
+                  auto cp = coords(abs, p);
+                  auto end = coords(abs, p);
+                  _builder.quadratic_curve_to(cp, end);
+                  p = prev_cp = end;
+                  prev_qp = p.reflect(cp);
+                  break;
+               }
+               case 'T':
+               {
+                  auto end = coords(abs, p);
+                  _builder.quadratic_curve_to(prev_qp, end);
+                  p = prev_cp = end;
+                  prev_qp = p.reflect(prev_qp);
+                  break;
+               }
+               case 'A':
+               {
+                  auto radius = coords(true, {});
+                  auto rotx = coord();
+                  auto large_arc = flag();
+                  auto sweep = flag();
+                  auto end = coords(abs, p);
+                  arc_to_curve<constexpr_math>(
+                     _builder, p, radius, rotx, large_arc, sweep, end);
+                  break;
+               }
+               case 'Z':
+                  _builder.close();
+                  break;
+            }
+         }
+
+         char const*    _s;
+         char const*    _last;
+         builder_type&  _builder;
+         point          p, prev_cp, prev_qp;
+      };
+   }
+
+   template <std::size_t N>
+   constexpr auto static_path(char const (&svg_def)[N])
+   {
+      // Each number takes at least one character and yields at most 16/7
+      // points (an arc: 7 numbers, up to 5 cubic segments plus the implied
+      // move), so this is always enough.
+      constexpr std::size_t max_points = N * 16 / 7 + 1;
+
+      basic_static_path<N, max_points> r;
+      detail::static_path_builder<N, max_points> builder{r};
+      detail::static_svg_parser<N, max_points> parser{
+         svg_def, svg_def + (N - 1), builder};
+      parser.parse();
+      return r;
+   }
+}
+
+#endif
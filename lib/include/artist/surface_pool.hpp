@@ -0,0 +1,115 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_SURFACE_POOL_OCTOBER_19_2026)
+#define ARTIST_SURFACE_POOL_OCTOBER_19_2026
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cycfi::artist
+{
+   ////////////////////////////////////////////////////////////////////////////
+   // pooled_buffer: Pixel memory borrowed from the surface_pool. It goes
+   // back to the pool when destroyed. Its size is the requested size,
+   // rounded up to the pool's size bucket.
+   ////////////////////////////////////////////////////////////////////////////
+   class pooled_buffer
+   {
+   public:
+                        pooled_buffer() = default;
+                        pooled_buffer(pooled_buffer&& rhs) noexcept;
+                        ~pooled_buffer();
+
+      pooled_buffer&    operator=(pooled_buffer&& rhs) noexcept;
+      explicit          operator bool() const;
+
+      std::uint8_t*     data() const;
+      std::size_t       size() const;
+
+   private:
+
+      friend class surface_pool_access;
+
+                        pooled_buffer(std::uint8_t* data, std::size_t size);
+
+      std::uint8_t*     _data = nullptr;
+      std::size_t       _size = 0;
+   };
+
+   struct surface_pool_stats
+   {
+      std::size_t       bytes_pooled = 0;    // Idle, ready to be reused
+      std::size_t       bytes_in_use = 0;    // Borrowed
+      std::size_t       max_bytes = 0;       // The cap on bytes_pooled
+      std::size_t       hits = 0;            // Borrows served from the pool
+      std::size_t       misses = 0;          // Borrows that allocated
+      std::size_t       evictions = 0;       // Buffers freed to stay under the cap
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // surface_pool: A library-wide pool of pixel memory for offscreen
+   // rendering. Raster surfaces borrow their pixels from the pool instead
+   // of allocating (and page faulting) a new buffer each time: the
+   // canvases of batch_renderer jobs and of raster_cache rasters, the
+   // pixels of images rasterized to be encoded, the layers of those
+   // canvases (Skia), and images made with image(extent) (Quartz; on Skia,
+   // these record a picture, and borrow pixels when it is rasterized).
+   //
+   // Buffers are bucketed by size, in steps of a quarter of a power of two,
+   // so that similar sizes (e.g. thumbnails of slightly different aspect)
+   // share buffers, wasting at most a quarter. The idle buffers are kept
+   // by bucket, so a borrow only looks at its own. Returned buffers are
+   // kept up to max_bytes; the least recently returned ones are freed
+   // first, and also when the library goes over its memory budget (see
+   // image_memory_budget), which counts the idle buffers. All functions
+   // are thread safe.
+   ////////////////////////////////////////////////////////////////////////////
+   namespace surface_pool
+   {
+      constexpr std::size_t default_max_bytes = 64 * 1024 * 1024;
+
+      pooled_buffer        acquire(std::size_t bytes);
+
+      std::size_t          max_bytes();
+      void                 max_bytes(std::size_t bytes);
+      surface_pool_stats   stats();
+      void                 clear();      // Frees the idle buffers
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline pooled_buffer::pooled_buffer(std::uint8_t* data, std::size_t size)
+    : _data{data}
+    , _size{size}
+   {
+   }
+
+   inline pooled_buffer::pooled_buffer(pooled_buffer&& rhs) noexcept
+    : _data{rhs._data}
+    , _size{rhs._size}
+   {
+      rhs._data = nullptr;
+      rhs._size = 0;
+   }
+
+   inline pooled_buffer::operator bool() const
+   {
+      return _data != nullptr;
+   }
+
+   inline std::uint8_t* pooled_buffer::data() const
+   {
+      return _data;
+   }
+
+   inline std::size_t pooled_buffer::size() const
+   {
+      return _size;
+   }
+}
+
+#endif
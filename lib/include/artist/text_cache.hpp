@@ -0,0 +1,97 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_TEXT_CACHE_OCTOBER_19_2026)
+#define ARTIST_TEXT_CACHE_OCTOBER_19_2026
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace cycfi::artist
+{
+   struct text_cache_stats
+   {
+      std::size_t       entries = 0;
+      std::size_t       max_entries = 0;
+      std::size_t       bytes = 0;           // Estimated
+      std::size_t       hits = 0;
+      std::size_t       misses = 0;
+      std::size_t       evictions = 0;
+
+      double            hit_rate() const;    // hits / (hits + misses)
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // text_cache: A library-wide LRU cache of shaped text, for
+   // canvas::fill_text, stroke_text and measure_text. Entries are keyed by
+   // typeface, size and the utf8 text, and hold what the backend shaped
+   // (e.g. an SkTextBlob or CTLine), with its width and font metrics, so
+   // that labels drawn again, e.g. in every frame or every row of a table,
+   // are shaped and measured once.
+   //
+   // The cache holds up to max_entries; the least recently used ones are
+   // dropped first, and also when the library goes over its memory budget
+   // (see image_memory_budget), which counts the cache's estimated bytes.
+   // Text longer than max_text_size bytes is not cached. max_entries(0)
+   // turns the cache off: text is then shaped on every draw, without being
+   // looked up, counted or added. All functions are thread safe.
+   ////////////////////////////////////////////////////////////////////////////
+   namespace text_cache
+   {
+      constexpr std::size_t default_max_entries = 4096;
+      constexpr std::size_t max_text_size = 256;
+
+      std::size_t          max_entries();
+      void                 max_entries(std::size_t n);
+      text_cache_stats     stats();
+      void                 clear();
+   }
+
+   namespace detail
+   {
+      // Used by the backends: font_id identifies the typeface. shaped is
+      // the backend's own type.
+      using shaped_text_ptr = std::shared_ptr<void const>;
+
+      shaped_text_ptr      find_shaped_text(
+                              std::uint64_t font_id, float size, std::string_view utf8);
+      void                 add_shaped_text(
+                              std::uint64_t font_id, float size, std::string_view utf8
+                            , shaped_text_ptr shaped);
+
+      // Returns the cached T for the text, or the one make() returns,
+      // added to the cache.
+      template <typename T, typename F>
+      std::shared_ptr<T const> shaped_text(
+         std::uint64_t font_id, float size, std::string_view utf8, F&& make);
+   }
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Inlines
+   ////////////////////////////////////////////////////////////////////////////
+   inline double text_cache_stats::hit_rate() const
+   {
+      auto lookups = hits + misses;
+      return lookups? double(hits) / lookups : 0.0;
+   }
+
+   namespace detail
+   {
+      template <typename T, typename F>
+      inline std::shared_ptr<T const> shaped_text(
+         std::uint64_t font_id, float size, std::string_view utf8, F&& make)
+      {
+         if (auto found = find_shaped_text(font_id, size, utf8))
+            return std::static_pointer_cast<T const>(found);
+         auto shaped = std::make_shared<T const>(make());
+         add_shaped_text(font_id, size, utf8, shaped);
+         return shaped;
+      }
+   }
+}
+
+#endif
@@ -20,6 +20,11 @@ namespace cycfi::artist
    class canvas;
    class text_layout;
 
+   ////////////////////////////////////////////////////////////////////////////
+   // Thread safety: A text_layout keeps the results of flow for drawing, so
+   // it is used by one thread at a time, like a canvas. Separate
+   // text_layouts may be flowed and drawn on separate threads at once.
+   ////////////////////////////////////////////////////////////////////////////
    class text_layout : non_copyable
    {
    public:
@@ -50,6 +55,17 @@ namespace cycfi::artist
       void                    text(std::u32string_view utf32);
       std::u32string_view     text() const;
 
+      // Edits: pos and count are indices into text(). Only the paragraphs
+      // touched are shaped and broken again, and the next flow(width,
+      // justify) with the same width reflows from the first line changed,
+      // keeping the rows after the change. Until that flow, the layout has
+      // no lines (as before the first flow).
+      void                    insert(std::size_t pos, std::string_view utf8);
+      void                    insert(std::size_t pos, std::u32string_view utf32);
+      void                    erase(std::size_t pos, std::size_t count = npos);
+      void                    append(std::string_view utf8);
+      void                    append(std::u32string_view utf32);
+
       void                    flow(float width, bool justify = false);
       void                    flow(get_line_info const& glf, flow_info finfo);
       void                    draw(canvas& cnv, point p, color c = colors::black) const;
@@ -0,0 +1,303 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/affine_transform.hpp>
+#include "detail/simd.hpp"
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      // Note: The SIMD kernels below evaluate (a*x + c*y) + tx in the same
+      // order and precision as basic_affine_transform::apply(point), without
+      // FMA, so they give the same results as the scalar code (unless the
+      // compiler is allowed to contract the scalar code into FMAs). The
+      // scalar code is also used to mop up the remaining points.
+
+      template <typename T>
+      void aos_scalar(
+         basic_affine_transform<T> const& m
+       , point const* src, point* dest, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+            dest[i] = m.apply(src[i]);
+      }
+
+      template <typename T>
+      void soa_scalar(
+         basic_affine_transform<T> const& m
+       , float const* x, float const* y
+       , float* x_out, float* y_out
+       , std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto p = m.apply(x[i], y[i]);
+            x_out[i] = p.x;
+            y_out[i] = p.y;
+         }
+      }
+
+#if defined(ARTIST_SIMD_X86)
+
+      /////////////////////////////////////////////////////////////////////////
+      // SSE2 (x86 baseline)
+      /////////////////////////////////////////////////////////////////////////
+      void aos_sse2(
+         affine_transform_f const& m
+       , point const* src, point* dest, std::size_t n)
+      {
+         auto const ab = _mm_setr_ps(m.a, m.b, m.a, m.b);
+         auto const cd = _mm_setr_ps(m.c, m.d, m.c, m.d);
+         auto const t = _mm_setr_ps(m.tx, m.ty, m.tx, m.ty);
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto p = _mm_loadu_ps(&src[i].x);                  // x0 y0 x1 y1
+            auto xx = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 0, 0));
+            auto yy = _mm_shuffle_ps(p, p, _MM_SHUFFLE(3, 3, 1, 1));
+            auto r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xx, ab), _mm_mul_ps(yy, cd)), t);
+            _mm_storeu_ps(&dest[i].x, r);
+         }
+         aos_scalar(m, src + i, dest + i, n - i);
+      }
+
+      void aos_sse2(
+         affine_transform const& m
+       , point const* src, point* dest, std::size_t n)
+      {
+         auto const ab = _mm_setr_pd(m.a, m.b);
+         auto const cd = _mm_setr_pd(m.c, m.d);
+         auto const t = _mm_setr_pd(m.tx, m.ty);
+
+         auto xform = [&](__m128d p)
+         {
+            auto xx = _mm_unpacklo_pd(p, p);
+            auto yy = _mm_unpackhi_pd(p, p);
+            return _mm_add_pd(_mm_add_pd(_mm_mul_pd(xx, ab), _mm_mul_pd(yy, cd)), t);
+         };
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto p = _mm_loadu_ps(&src[i].x);                  // x0 y0 x1 y1
+            auto r0 = xform(_mm_cvtps_pd(p));
+            auto r1 = xform(_mm_cvtps_pd(_mm_movehl_ps(p, p)));
+            _mm_storeu_ps(&dest[i].x, _mm_movelh_ps(_mm_cvtpd_ps(r0), _mm_cvtpd_ps(r1)));
+         }
+         aos_scalar(m, src + i, dest + i, n - i);
+      }
+
+      void soa_sse2(
+         affine_transform_f const& m
+       , float const* x, float const* y
+       , float* x_out, float* y_out
+       , std::size_t n)
+      {
+         auto const a = _mm_set1_ps(m.a), b = _mm_set1_ps(m.b);
+         auto const c = _mm_set1_ps(m.c), d = _mm_set1_ps(m.d);
+         auto const tx = _mm_set1_ps(m.tx), ty = _mm_set1_ps(m.ty);
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto px = _mm_loadu_ps(x + i);
+            auto py = _mm_loadu_ps(y + i);
+            _mm_storeu_ps(x_out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(a, px), _mm_mul_ps(c, py)), tx));
+            _mm_storeu_ps(y_out + i, _mm_add_ps(_mm_add_ps(_mm_mul_ps(b, px), _mm_mul_ps(d, py)), ty));
+         }
+         soa_scalar(m, x + i, y + i, x_out + i, y_out + i, n - i);
+      }
+
+      void soa_sse2(
+         affine_transform const& m
+       , float const* x, float const* y
+       , float* x_out, float* y_out
+       , std::size_t n)
+      {
+         auto const a = _mm_set1_pd(m.a), b = _mm_set1_pd(m.b);
+         auto const c = _mm_set1_pd(m.c), d = _mm_set1_pd(m.d);
+         auto const tx = _mm_set1_pd(m.tx), ty = _mm_set1_pd(m.ty);
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto fx = _mm_loadu_ps(x + i);
+            auto fy = _mm_loadu_ps(y + i);
+            __m128d px[2] = {_mm_cvtps_pd(fx), _mm_cvtps_pd(_mm_movehl_ps(fx, fx))};
+            __m128d py[2] = {_mm_cvtps_pd(fy), _mm_cvtps_pd(_mm_movehl_ps(fy, fy))};
+            __m128 rx[2], ry[2];
+            for (int j = 0; j != 2; ++j)
+            {
+               rx[j] = _mm_cvtpd_ps(_mm_add_pd(_mm_add_pd(_mm_mul_pd(a, px[j]), _mm_mul_pd(c, py[j])), tx));
+               ry[j] = _mm_cvtpd_ps(_mm_add_pd(_mm_add_pd(_mm_mul_pd(b, px[j]), _mm_mul_pd(d, py[j])), ty));
+            }
+            _mm_storeu_ps(x_out + i, _mm_movelh_ps(rx[0], rx[1]));
+            _mm_storeu_ps(y_out + i, _mm_movelh_ps(ry[0], ry[1]));
+         }
+         soa_scalar(m, x + i, y + i, x_out + i, y_out + i, n - i);
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // AVX2
+      /////////////////////////////////////////////////////////////////////////
+      ARTIST_TARGET_AVX2
+      void aos_avx2(
+         affine_transform_f const& m
+       , point const* src, point* dest, std::size_t n)
+      {
+         auto const ab = _mm256_setr_ps(m.a, m.b, m.a, m.b, m.a, m.b, m.a, m.b);
+         auto const cd = _mm256_setr_ps(m.c, m.d, m.c, m.d, m.c, m.d, m.c, m.d);
+         auto const t = _mm256_setr_ps(m.tx, m.ty, m.tx, m.ty, m.tx, m.ty, m.tx, m.ty);
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto p = _mm256_loadu_ps(&src[i].x);
+            auto xx = _mm256_moveldup_ps(p);
+            auto yy = _mm256_movehdup_ps(p);
+            auto r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(xx, ab), _mm256_mul_ps(yy, cd)), t);
+            _mm256_storeu_ps(&dest[i].x, r);
+         }
+         aos_sse2(m, src + i, dest + i, n - i);
+      }
+
+      ARTIST_TARGET_AVX2
+      void aos_avx2(
+         affine_transform const& m
+       , point const* src, point* dest, std::size_t n)
+      {
+         auto const ab = _mm256_setr_pd(m.a, m.b, m.a, m.b);
+         auto const cd = _mm256_setr_pd(m.c, m.d, m.c, m.d);
+         auto const t = _mm256_setr_pd(m.tx, m.ty, m.tx, m.ty);
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto p = _mm256_cvtps_pd(_mm_loadu_ps(&src[i].x));   // x0 y0 x1 y1
+            auto xx = _mm256_movedup_pd(p);
+            auto yy = _mm256_permute_pd(p, 0xF);
+            auto r = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(xx, ab), _mm256_mul_pd(yy, cd)), t);
+            _mm_storeu_ps(&dest[i].x, _mm256_cvtpd_ps(r));
+         }
+         aos_scalar(m, src + i, dest + i, n - i);
+      }
+
+      ARTIST_TARGET_AVX2
+      void soa_avx2(
+         affine_transform_f const& m
+       , float const* x, float const* y
+       , float* x_out, float* y_out
+       , std::size_t n)
+      {
+         auto const a = _mm256_set1_ps(m.a), b = _mm256_set1_ps(m.b);
+         auto const c = _mm256_set1_ps(m.c), d = _mm256_set1_ps(m.d);
+         auto const tx = _mm256_set1_ps(m.tx), ty = _mm256_set1_ps(m.ty);
+
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            auto px = _mm256_loadu_ps(x + i);
+            auto py = _mm256_loadu_ps(y + i);
+            _mm256_storeu_ps(x_out + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a, px), _mm256_mul_ps(c, py)), tx));
+            _mm256_storeu_ps(y_out + i, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(b, px), _mm256_mul_ps(d, py)), ty));
+         }
+         soa_sse2(m, x + i, y + i, x_out + i, y_out + i, n - i);
+      }
+
+      ARTIST_TARGET_AVX2
+      void soa_avx2(
+         affine_transform const& m
+       , float const* x, float const* y
+       , float* x_out, float* y_out
+       , std::size_t n)
+      {
+         auto const a = _mm256_set1_pd(m.a), b = _mm256_set1_pd(m.b);
+         auto const c = _mm256_set1_pd(m.c), d = _mm256_set1_pd(m.d);
+         auto const tx = _mm256_set1_pd(m.tx), ty = _mm256_set1_pd(m.ty);
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto px = _mm256_cvtps_pd(_mm_loadu_ps(x + i));
+            auto py = _mm256_cvtps_pd(_mm_loadu_ps(y + i));
+            auto rx = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(a, px), _mm256_mul_pd(c, py)), tx);
+            auto ry = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(b, px), _mm256_mul_pd(d, py)), ty);
+            _mm_storeu_ps(x_out + i, _mm256_cvtpd_ps(rx));
+            _mm_storeu_ps(y_out + i, _mm256_cvtpd_ps(ry));
+         }
+         soa_scalar(m, x + i, y + i, x_out + i, y_out + i, n - i);
+      }
+
+#endif // ARTIST_SIMD_X86
+
+      template <typename T>
+      void transform_aos(
+         basic_affine_transform<T> const& mat
+       , point const src[], point dest[], std::size_t n)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: aos_avx2(mat, src, dest, n); return;
+            case detail::simd_isa::sse2: aos_sse2(mat, src, dest, n); return;
+            default: break;
+         }
+#endif
+         aos_scalar(mat, src, dest, n);
+      }
+
+      template <typename T>
+      void transform_soa(
+         basic_affine_transform<T> const& mat
+       , float const x[], float const y[]
+       , float x_out[], float y_out[]
+       , std::size_t n)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: soa_avx2(mat, x, y, x_out, y_out, n); return;
+            case detail::simd_isa::sse2: soa_sse2(mat, x, y, x_out, y_out, n); return;
+            default: break;
+         }
+#endif
+         soa_scalar(mat, x, y, x_out, y_out, n);
+      }
+   }
+
+   void transform_points(
+      affine_transform const& mat
+    , point const src[], point dest[], std::size_t n)
+   {
+      transform_aos(mat, src, dest, n);
+   }
+
+   void transform_points(
+      affine_transform_f const& mat
+    , point const src[], point dest[], std::size_t n)
+   {
+      transform_aos(mat, src, dest, n);
+   }
+
+   void transform_points(
+      affine_transform const& mat
+    , float const x[], float const y[]
+    , float x_out[], float y_out[]
+    , std::size_t n)
+   {
+      transform_soa(mat, x, y, x_out, y_out, n);
+   }
+
+   void transform_points(
+      affine_transform_f const& mat
+    , float const x[], float const y[]
+    , float x_out[], float y_out[]
+    , std::size_t n)
+   {
+      transform_soa(mat, x, y, x_out, y_out, n);
+   }
+}
@@ -0,0 +1,172 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/batch_renderer.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      using clock = std::chrono::steady_clock;
+
+      batch_renderer::result render_job(batch_renderer::job const& j, std::size_t index)
+      {
+         batch_renderer::result r;
+         r.index = index;
+         try
+         {
+            auto start = clock::now();
+            auto img = detail::rasterize(j.size,
+               [&j](canvas& cnv)
+               {
+                  if (j.display_list)
+                     cnv.draw(*j.display_list);
+                  if (j.scene)
+                     j.scene(cnv);
+               }
+            );
+            auto rendered = clock::now();
+            r.render_time = rendered - start;
+
+            r.encoded = img.encode(j.format, j.quality);
+            r.encode_time = clock::now() - rendered;
+         }
+         catch (...)
+         {
+            r.error = std::current_exception();
+         }
+         return r;
+      }
+   }
+
+   struct batch_renderer::state
+   {
+      struct batch
+      {
+         batch(std::vector<job> const& jobs_, output_function const& output_)
+          : jobs{jobs_}, output{output_}
+         {}
+
+         std::vector<job> const& jobs;
+         output_function const&  output;
+         std::size_t             next = 0;   // The next job to take
+         std::size_t             done = 0;
+         std::mutex              output_mutex;
+         std::exception_ptr      output_error;
+      };
+
+                              state(std::size_t num_threads);
+                              ~state();
+
+      void                    worker();
+
+      std::mutex              render_mutex;  // One batch at a time
+      std::mutex              mutex;
+      std::condition_variable jobs_cv;       // Signals workers: a batch started
+      std::condition_variable done_cv;       // Signals render: a job is done
+      batch*                  current = nullptr;
+      std::vector<std::thread> workers;
+      bool                    stop = false;
+   };
+
+   batch_renderer::state::state(std::size_t num_threads)
+   {
+      if (num_threads == 0)
+         num_threads = std::max(1u, std::thread::hardware_concurrency());
+      for (std::size_t i = 0; i != num_threads; ++i)
+         workers.emplace_back([this]{ worker(); });
+   }
+
+   batch_renderer::state::~state()
+   {
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         stop = true;
+      }
+      jobs_cv.notify_all();
+      for (auto& t : workers)
+         t.join();
+   }
+
+   void batch_renderer::state::worker()
+   {
+      while (true)
+      {
+         batch* b;
+         std::size_t index;
+         {
+            std::unique_lock<std::mutex> lock{mutex};
+            jobs_cv.wait(lock,
+               [this]{ return stop || (current && current->next < current->jobs.size()); });
+            if (stop)
+               return;
+            b = current;
+            index = b->next++;
+         }
+
+         auto r = render_job(b->jobs[index], index);
+         {
+            std::lock_guard<std::mutex> lock{b->output_mutex};
+            try
+            {
+               if (!b->output_error)
+                  b->output(std::move(r));
+            }
+            catch (...)
+            {
+               b->output_error = std::current_exception();
+            }
+         }
+
+         bool last;
+         {
+            std::lock_guard<std::mutex> lock{mutex};
+            last = ++b->done == b->jobs.size();
+         }
+         if (last)
+            done_cv.notify_all();
+      }
+   }
+
+   batch_renderer::batch_renderer(std::size_t num_threads)
+    : _state{std::make_unique<state>(num_threads)}
+   {
+   }
+
+   batch_renderer::~batch_renderer()
+   {
+   }
+
+   void batch_renderer::render(std::vector<job> const& jobs, output_function output)
+   {
+      if (jobs.empty())
+         return;
+
+      std::lock_guard<std::mutex> serial{_state->render_mutex};
+      state::batch b{jobs, output};
+      {
+         std::lock_guard<std::mutex> lock{_state->mutex};
+         _state->current = &b;
+      }
+      _state->jobs_cv.notify_all();
+      {
+         std::unique_lock<std::mutex> lock{_state->mutex};
+         _state->done_cv.wait(lock, [&b]{ return b.done == b.jobs.size(); });
+         _state->current = nullptr;
+      }
+
+      if (b.output_error)
+         std::rethrow_exception(b.output_error);
+   }
+
+   std::size_t batch_renderer::num_threads() const
+   {
+      return _state->workers.size();
+   }
+}
@@ -0,0 +1,800 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/color.hpp>
+#include "detail/simd.hpp"
+#include <cmath>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      // Note: The SIMD kernels below do the same float operations, in the
+      // same order, as the scalar code, so they give the same results. The
+      // exception is hsl, where the scalar hsl(h, s, l) does some of its
+      // math in double. The scalar code is also used to mop up the
+      // remaining elements.
+
+      /////////////////////////////////////////////////////////////////////////
+      // Scalar
+      /////////////////////////////////////////////////////////////////////////
+
+      // Same as _mm_max_ps(_mm_min_ps(v, 1), 0), including NaN handling
+      inline float clamp01(float v)
+      {
+         v = v < 1.0f? v : 1.0f;
+         return v > 0.0f? v : 0.0f;
+      }
+
+      inline std::uint8_t to_byte(float v)
+      {
+         return std::uint8_t(clamp01(v) * 255.0f + 0.5f);
+      }
+
+      template <bool bgra>
+      void pack_scalar(color const* src, std::uint32_t* dest, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto p = reinterpret_cast<std::uint8_t*>(dest + i);
+            auto const& c = src[i];
+            p[0] = to_byte(bgra? c.blue : c.red);
+            p[1] = to_byte(c.green);
+            p[2] = to_byte(bgra? c.red : c.blue);
+            p[3] = to_byte(c.alpha);
+         }
+      }
+
+      template <bool bgra>
+      void unpack_scalar(std::uint32_t const* src, color* dest, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto p = reinterpret_cast<std::uint8_t const*>(src + i);
+            dest[i] = {
+               (bgra? p[2] : p[0]) / 255.0f
+             , p[1] / 255.0f
+             , (bgra? p[0] : p[2]) / 255.0f
+             , p[3] / 255.0f
+            };
+         }
+      }
+
+      void premultiply_scalar(color* c, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto a = c[i].alpha;
+            c[i].red *= a;
+            c[i].green *= a;
+            c[i].blue *= a;
+         }
+      }
+
+      void unpremultiply_scalar(color* c, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto a = c[i].alpha;
+            if (a > 0.0f)
+            {
+               c[i].red /= a;
+               c[i].green /= a;
+               c[i].blue /= a;
+            }
+            else
+            {
+               c[i].red = c[i].green = c[i].blue = 0.0f;
+            }
+         }
+      }
+
+      // Exact rounded x / 255 for x in [0, 255 * 255]
+      inline std::uint32_t div255(std::uint32_t x)
+      {
+         x += 128;
+         return (x + (x >> 8)) >> 8;
+      }
+
+      void premultiply_scalar(std::uint32_t* c, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto p = reinterpret_cast<std::uint8_t*>(c + i);
+            std::uint32_t a = p[3];
+            p[0] = div255(p[0] * a);
+            p[1] = div255(p[1] * a);
+            p[2] = div255(p[2] * a);
+         }
+      }
+
+      void unpremultiply_scalar(std::uint32_t* c, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto p = reinterpret_cast<std::uint8_t*>(c + i);
+            float scale = p[3]? 255.0f / p[3] : 0.0f;
+            for (int j = 0; j != 3; ++j)
+               p[j] = std::uint8_t(std::min(p[j] * scale + 0.5f, 255.0f));
+         }
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // sRGB lookup tables. The extra entry at the end lets us interpolate
+      // at 1.0 without a bounds check.
+      /////////////////////////////////////////////////////////////////////////
+      constexpr int lut_size = 4096;
+
+      struct srgb_lut
+      {
+         float to_linear[lut_size + 1];
+         float to_srgb[lut_size + 1];
+
+         srgb_lut()
+         {
+            for (int i = 0; i != lut_size; ++i)
+            {
+               double x = double(i) / (lut_size - 1);
+               to_linear[i] = float(
+                  (x <= 0.04045)? x / 12.92 : std::pow((x + 0.055) / 1.055, 2.4));
+               to_srgb[i] = float(
+                  (x <= 0.0031308)? x * 12.92 : 1.055 * std::pow(x, 1 / 2.4) - 0.055);
+            }
+            to_linear[lut_size] = to_linear[lut_size - 1];
+            to_srgb[lut_size] = to_srgb[lut_size - 1];
+         }
+      };
+
+      srgb_lut const& get_srgb_lut()
+      {
+         static srgb_lut const lut;
+         return lut;
+      }
+
+      inline float lut_lookup(float const* lut, float v)
+      {
+         v = clamp01(v) * float(lut_size - 1);
+         int i = int(v);
+         float f = v - float(i);
+         return lut[i] + f * (lut[i+1] - lut[i]);
+      }
+
+      void apply_lut_scalar(float const* lut, color* c, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            c[i].red = lut_lookup(lut, c[i].red);
+            c[i].green = lut_lookup(lut, c[i].green);
+            c[i].blue = lut_lookup(lut, c[i].blue);
+         }
+      }
+
+      void hsl_scalar(
+         float const* h, float const* s, float const* l
+       , color* dest, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+            dest[i] = artist::hsl(h[i], s[i], l[i]);
+      }
+
+#if defined(ARTIST_SIMD_X86)
+
+      /////////////////////////////////////////////////////////////////////////
+      // SSE2 (x86 baseline)
+      /////////////////////////////////////////////////////////////////////////
+      template <bool bgra>
+      inline __m128 swap_rb(__m128 c)
+      {
+         return bgra? _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 1, 2)) : c;
+      }
+
+      template <bool bgra>
+      inline __m128i to_epi32_sse2(__m128 c)
+      {
+         auto const one = _mm_set1_ps(1.0f);
+         auto const zero = _mm_setzero_ps();
+         auto v = _mm_max_ps(_mm_min_ps(swap_rb<bgra>(c), one), zero);
+         return _mm_cvttps_epi32(
+            _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f)), _mm_set1_ps(0.5f)));
+      }
+
+      template <bool bgra>
+      void pack_sse2(color const* src, std::uint32_t* dest, std::size_t n)
+      {
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto c0 = to_epi32_sse2<bgra>(_mm_loadu_ps(&src[i].red));
+            auto c1 = to_epi32_sse2<bgra>(_mm_loadu_ps(&src[i+1].red));
+            auto c2 = to_epi32_sse2<bgra>(_mm_loadu_ps(&src[i+2].red));
+            auto c3 = to_epi32_sse2<bgra>(_mm_loadu_ps(&src[i+3].red));
+            auto p = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), p);
+         }
+         pack_scalar<bgra>(src + i, dest + i, n - i);
+      }
+
+      template <bool bgra>
+      void unpack_sse2(std::uint32_t const* src, color* dest, std::size_t n)
+      {
+         auto const zero = _mm_setzero_si128();
+         auto const scale = _mm_set1_ps(255.0f);
+         auto to_color = [&](__m128i c)
+         {
+            return swap_rb<bgra>(_mm_div_ps(_mm_cvtepi32_ps(c), scale));
+         };
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto p = _mm_loadu_si128(reinterpret_cast<__m128i const*>(src + i));
+            auto lo = _mm_unpacklo_epi8(p, zero);
+            auto hi = _mm_unpackhi_epi8(p, zero);
+            _mm_storeu_ps(&dest[i].red, to_color(_mm_unpacklo_epi16(lo, zero)));
+            _mm_storeu_ps(&dest[i+1].red, to_color(_mm_unpackhi_epi16(lo, zero)));
+            _mm_storeu_ps(&dest[i+2].red, to_color(_mm_unpacklo_epi16(hi, zero)));
+            _mm_storeu_ps(&dest[i+3].red, to_color(_mm_unpackhi_epi16(hi, zero)));
+         }
+         unpack_scalar<bgra>(src + i, dest + i, n - i);
+      }
+
+      // (a, a, a, 1)
+      inline __m128 alpha_multiplier_sse2(__m128 c)
+      {
+         auto const rgb_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+         auto const one_w = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+         auto a = _mm_shuffle_ps(c, c, _MM_SHUFFLE(3, 3, 3, 3));
+         return _mm_or_ps(_mm_and_ps(a, rgb_mask), one_w);
+      }
+
+      void premultiply_sse2(color* c, std::size_t n)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto v = _mm_loadu_ps(&c[i].red);
+            _mm_storeu_ps(&c[i].red, _mm_mul_ps(v, alpha_multiplier_sse2(v)));
+         }
+      }
+
+      void unpremultiply_sse2(color* c, std::size_t n)
+      {
+         auto const alpha_mask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+         auto const zero = _mm_setzero_ps();
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            auto v = _mm_loadu_ps(&c[i].red);
+            auto a = alpha_multiplier_sse2(v);
+            auto keep = _mm_or_ps(_mm_cmpgt_ps(a, zero), alpha_mask);
+            _mm_storeu_ps(&c[i].red, _mm_and_ps(_mm_div_ps(v, a), keep));
+         }
+      }
+
+      void premultiply_packed_sse2(std::uint32_t* c, std::size_t n)
+      {
+         auto const zero = _mm_setzero_si128();
+         auto const alpha_255 = _mm_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255);
+         auto const round = _mm_set1_epi16(128);
+
+         // x * a / 255, rounded, for 2 pixels in 16-bit lanes
+         auto premul = [&](__m128i x)
+         {
+            auto a = _mm_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+            a = _mm_or_si128(a, alpha_255);
+            auto t = _mm_add_epi16(_mm_mullo_epi16(x, a), round);
+            return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+         };
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto p = _mm_loadu_si128(reinterpret_cast<__m128i const*>(c + i));
+            auto lo = premul(_mm_unpacklo_epi8(p, zero));
+            auto hi = premul(_mm_unpackhi_epi8(p, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(c + i), _mm_packus_epi16(lo, hi));
+         }
+         premultiply_scalar(c + i, n - i);
+      }
+
+      void unpremultiply_packed_sse2(std::uint32_t* c, std::size_t n)
+      {
+         auto const zero = _mm_setzero_si128();
+         auto const zero_ps = _mm_setzero_ps();
+         auto const c255 = _mm_set1_ps(255.0f);
+         auto const half = _mm_set1_ps(0.5f);
+         auto const rgb_mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, -1, 0));
+         auto const one_w = _mm_setr_ps(0.0f, 0.0f, 0.0f, 1.0f);
+
+         auto unpremul = [&](__m128i x)
+         {
+            auto v = _mm_cvtepi32_ps(x);
+            auto a = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+            auto scale = _mm_and_ps(_mm_div_ps(c255, a), _mm_cmpgt_ps(a, zero_ps));
+            scale = _mm_or_ps(_mm_and_ps(scale, rgb_mask), one_w);
+            auto r = _mm_min_ps(_mm_add_ps(_mm_mul_ps(v, scale), half), c255);
+            return _mm_cvttps_epi32(r);
+         };
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto p = _mm_loadu_si128(reinterpret_cast<__m128i const*>(c + i));
+            auto lo = _mm_unpacklo_epi8(p, zero);
+            auto hi = _mm_unpackhi_epi8(p, zero);
+            auto c0 = unpremul(_mm_unpacklo_epi16(lo, zero));
+            auto c1 = unpremul(_mm_unpackhi_epi16(lo, zero));
+            auto c2 = unpremul(_mm_unpacklo_epi16(hi, zero));
+            auto c3 = unpremul(_mm_unpackhi_epi16(hi, zero));
+            auto r = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(c + i), r);
+         }
+         unpremultiply_scalar(c + i, n - i);
+      }
+
+      inline __m128 select_sse2(__m128 mask, __m128 a, __m128 b)
+      {
+         return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+      }
+
+      void hsl_sse2(
+         float const* h_, float const* s_, float const* l_
+       , color* dest, std::size_t n)
+      {
+         auto const zero = _mm_setzero_ps();
+         auto const one = _mm_set1_ps(1.0f);
+         auto const half = _mm_set1_ps(0.5f);
+         auto const max_h = _mm_set1_ps(359.99f);
+         auto const h_scale = _mm_set1_ps(6.0f / 360);
+
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto h = _mm_min_ps(_mm_loadu_ps(h_ + i), max_h);
+            auto s = _mm_loadu_ps(s_ + i);
+            auto l = _mm_loadu_ps(l_ + i);
+
+            auto v = select_sse2(
+               _mm_cmple_ps(l, half)
+             , _mm_mul_ps(l, _mm_add_ps(one, s))
+             , _mm_sub_ps(_mm_add_ps(l, s), _mm_mul_ps(l, s))
+            );
+            auto m = _mm_sub_ps(_mm_add_ps(l, l), v);
+            auto sv = _mm_div_ps(_mm_sub_ps(v, m), v);
+
+            h = _mm_mul_ps(h, h_scale);
+            auto sextant = _mm_cvttps_epi32(h);
+            auto fract = _mm_sub_ps(h, _mm_cvtepi32_ps(sextant));
+            auto vsf = _mm_mul_ps(_mm_mul_ps(v, sv), fract);
+            auto mid1 = _mm_add_ps(m, vsf);
+            auto mid2 = _mm_sub_ps(v, vsf);
+
+            __m128 e[6];
+            for (int k = 0; k != 6; ++k)
+               e[k] = _mm_castsi128_ps(_mm_cmpeq_epi32(sextant, _mm_set1_epi32(k)));
+
+            // Gray if v <= 0 or the sextant is out of range
+            auto r = l, g = l, b = l;
+            auto valid = _mm_cmpgt_ps(v, zero);
+            auto pick = [&](__m128 mask, __m128 rv, __m128 gv, __m128 bv)
+            {
+               mask = _mm_and_ps(mask, valid);
+               r = select_sse2(mask, rv, r);
+               g = select_sse2(mask, gv, g);
+               b = select_sse2(mask, bv, b);
+            };
+            pick(e[0], v, mid1, m);
+            pick(e[1], mid2, v, m);
+            pick(e[2], m, v, mid1);
+            pick(e[3], m, mid2, v);
+            pick(e[4], mid1, m, v);
+            pick(e[5], v, m, mid2);
+
+            auto a = one;
+            _MM_TRANSPOSE4_PS(r, g, b, a);
+            _mm_storeu_ps(&dest[i].red, r);
+            _mm_storeu_ps(&dest[i+1].red, g);
+            _mm_storeu_ps(&dest[i+2].red, b);
+            _mm_storeu_ps(&dest[i+3].red, a);
+         }
+         hsl_scalar(h_ + i, s_ + i, l_ + i, dest + i, n - i);
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // AVX2 (two colors per register)
+      /////////////////////////////////////////////////////////////////////////
+      template <bool bgra>
+      ARTIST_TARGET_AVX2
+      inline __m256 swap_rb_avx2(__m256 c)
+      {
+         return bgra? _mm256_shuffle_ps(c, c, _MM_SHUFFLE(3, 0, 1, 2)) : c;
+      }
+
+      template <bool bgra>
+      ARTIST_TARGET_AVX2
+      inline __m256i to_epi32_avx2(__m256 c)
+      {
+         auto const one = _mm256_set1_ps(1.0f);
+         auto const zero = _mm256_setzero_ps();
+         auto v = _mm256_max_ps(_mm256_min_ps(swap_rb_avx2<bgra>(c), one), zero);
+         return _mm256_cvttps_epi32(
+            _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f)), _mm256_set1_ps(0.5f)));
+      }
+
+      template <bool bgra>
+      ARTIST_TARGET_AVX2
+      void pack_avx2(color const* src, std::uint32_t* dest, std::size_t n)
+      {
+         auto const order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            auto c01 = to_epi32_avx2<bgra>(_mm256_loadu_ps(&src[i].red));
+            auto c23 = to_epi32_avx2<bgra>(_mm256_loadu_ps(&src[i+2].red));
+            auto c45 = to_epi32_avx2<bgra>(_mm256_loadu_ps(&src[i+4].red));
+            auto c67 = to_epi32_avx2<bgra>(_mm256_loadu_ps(&src[i+6].red));
+
+            // The packs work within 128-bit lanes, giving us pixels in the
+            // order 0 2 4 6 | 1 3 5 7. The permute puts them back in order.
+            auto p = _mm256_packus_epi16(
+               _mm256_packs_epi32(c01, c23), _mm256_packs_epi32(c45, c67));
+            p = _mm256_permutevar8x32_epi32(p, order);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i), p);
+         }
+         pack_sse2<bgra>(src + i, dest + i, n - i);
+      }
+
+      template <bool bgra>
+      ARTIST_TARGET_AVX2
+      void unpack_avx2(std::uint32_t const* src, color* dest, std::size_t n)
+      {
+         auto const scale = _mm256_set1_ps(255.0f);
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto p = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(src + i));
+            auto c = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p));
+            _mm256_storeu_ps(&dest[i].red, swap_rb_avx2<bgra>(_mm256_div_ps(c, scale)));
+         }
+         unpack_scalar<bgra>(src + i, dest + i, n - i);
+      }
+
+      // (a0, a0, a0, 1 | a1, a1, a1, 1)
+      ARTIST_TARGET_AVX2
+      inline __m256 alpha_multiplier_avx2(__m256 c)
+      {
+         auto a = _mm256_permute_ps(c, _MM_SHUFFLE(3, 3, 3, 3));
+         return _mm256_blend_ps(a, _mm256_set1_ps(1.0f), 0x88);
+      }
+
+      ARTIST_TARGET_AVX2
+      void premultiply_avx2(color* c, std::size_t n)
+      {
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto v = _mm256_loadu_ps(&c[i].red);
+            _mm256_storeu_ps(&c[i].red, _mm256_mul_ps(v, alpha_multiplier_avx2(v)));
+         }
+         premultiply_sse2(c + i, n - i);
+      }
+
+      ARTIST_TARGET_AVX2
+      void unpremultiply_avx2(color* c, std::size_t n)
+      {
+         auto const zero = _mm256_setzero_ps();
+         auto const all = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto v = _mm256_loadu_ps(&c[i].red);
+            auto a = alpha_multiplier_avx2(v);
+            auto keep = _mm256_blend_ps(_mm256_cmp_ps(a, zero, _CMP_GT_OQ), all, 0x88);
+            _mm256_storeu_ps(&c[i].red, _mm256_and_ps(_mm256_div_ps(v, a), keep));
+         }
+         unpremultiply_sse2(c + i, n - i);
+      }
+
+      // x * a / 255, rounded, for 4 pixels in 16-bit lanes. (Lambdas do not
+      // inherit the target attribute, hence a function.)
+      ARTIST_TARGET_AVX2
+      inline __m256i premul_epi16_avx2(__m256i x)
+      {
+         auto const alpha_255 = _mm256_setr_epi16(
+            0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+         auto a = _mm256_shufflelo_epi16(x, _MM_SHUFFLE(3, 3, 3, 3));
+         a = _mm256_shufflehi_epi16(a, _MM_SHUFFLE(3, 3, 3, 3));
+         a = _mm256_or_si256(a, alpha_255);
+         auto t = _mm256_add_epi16(_mm256_mullo_epi16(x, a), _mm256_set1_epi16(128));
+         return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+      }
+
+      ARTIST_TARGET_AVX2
+      void premultiply_packed_avx2(std::uint32_t* c, std::size_t n)
+      {
+         auto const zero = _mm256_setzero_si256();
+
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            // Unpack and pack work within 128-bit lanes, so they cancel out
+            // and the pixels stay in order.
+            auto p = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(c + i));
+            auto lo = premul_epi16_avx2(_mm256_unpacklo_epi8(p, zero));
+            auto hi = premul_epi16_avx2(_mm256_unpackhi_epi8(p, zero));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + i), _mm256_packus_epi16(lo, hi));
+         }
+         premultiply_packed_sse2(c + i, n - i);
+      }
+
+      ARTIST_TARGET_AVX2
+      void unpremultiply_packed_avx2(std::uint32_t* c, std::size_t n)
+      {
+         auto const zero = _mm256_setzero_ps();
+         auto const c255 = _mm256_set1_ps(255.0f);
+         auto const half = _mm256_set1_ps(0.5f);
+         auto const one = _mm256_set1_ps(1.0f);
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto p = _mm_loadl_epi64(reinterpret_cast<__m128i const*>(c + i));
+            auto v = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(p));
+            auto a = _mm256_permute_ps(v, _MM_SHUFFLE(3, 3, 3, 3));
+            auto scale = _mm256_and_ps(_mm256_div_ps(c255, a), _mm256_cmp_ps(a, zero, _CMP_GT_OQ));
+            scale = _mm256_blend_ps(scale, one, 0x88);
+            auto r = _mm256_cvttps_epi32(
+               _mm256_min_ps(_mm256_add_ps(_mm256_mul_ps(v, scale), half), c255));
+
+            // 8 x 32-bit to 8 x 8-bit
+            auto lo = _mm256_castsi256_si128(r);
+            auto hi = _mm256_extracti128_si256(r, 1);
+            auto packed = _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(c + i), packed);
+         }
+         unpremultiply_scalar(c + i, n - i);
+      }
+
+      ARTIST_TARGET_AVX2
+      void apply_lut_avx2(float const* lut, color* c, std::size_t n)
+      {
+         auto const one = _mm256_set1_ps(1.0f);
+         auto const zero = _mm256_setzero_ps();
+         auto const scale = _mm256_set1_ps(float(lut_size - 1));
+         auto const next = _mm256_set1_epi32(1);
+
+         std::size_t i = 0;
+         for (; i + 2 <= n; i += 2)
+         {
+            auto orig = _mm256_loadu_ps(&c[i].red);
+            auto v = _mm256_max_ps(_mm256_min_ps(orig, one), zero);
+            v = _mm256_mul_ps(v, scale);
+            auto idx = _mm256_cvttps_epi32(v);
+            auto f = _mm256_sub_ps(v, _mm256_cvtepi32_ps(idx));
+            auto y0 = _mm256_i32gather_ps(lut, idx, 4);
+            auto y1 = _mm256_i32gather_ps(lut, _mm256_add_epi32(idx, next), 4);
+            auto r = _mm256_add_ps(y0, _mm256_mul_ps(f, _mm256_sub_ps(y1, y0)));
+
+            // Leave alpha alone
+            _mm256_storeu_ps(&c[i].red, _mm256_blend_ps(r, orig, 0x88));
+         }
+         apply_lut_scalar(lut, c + i, n - i);
+      }
+
+      // Where sextant == k (and valid), set r, g, b to rv, gv, bv
+      ARTIST_TARGET_AVX2
+      inline void hsl_pick_avx2(
+         int k, __m256i sextant, __m256 valid
+       , __m256& r, __m256& g, __m256& b
+       , __m256 rv, __m256 gv, __m256 bv)
+      {
+         auto mask = _mm256_castsi256_ps(_mm256_cmpeq_epi32(sextant, _mm256_set1_epi32(k)));
+         mask = _mm256_and_ps(mask, valid);
+         r = _mm256_blendv_ps(r, rv, mask);
+         g = _mm256_blendv_ps(g, gv, mask);
+         b = _mm256_blendv_ps(b, bv, mask);
+      }
+
+      ARTIST_TARGET_AVX2
+      void hsl_avx2(
+         float const* h_, float const* s_, float const* l_
+       , color* dest, std::size_t n)
+      {
+         auto const zero = _mm256_setzero_ps();
+         auto const one = _mm256_set1_ps(1.0f);
+         auto const half = _mm256_set1_ps(0.5f);
+         auto const max_h = _mm256_set1_ps(359.99f);
+         auto const h_scale = _mm256_set1_ps(6.0f / 360);
+
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            auto h = _mm256_min_ps(_mm256_loadu_ps(h_ + i), max_h);
+            auto s = _mm256_loadu_ps(s_ + i);
+            auto l = _mm256_loadu_ps(l_ + i);
+
+            auto v = _mm256_blendv_ps(
+               _mm256_sub_ps(_mm256_add_ps(l, s), _mm256_mul_ps(l, s))
+             , _mm256_mul_ps(l, _mm256_add_ps(one, s))
+             , _mm256_cmp_ps(l, half, _CMP_LE_OQ)
+            );
+            auto m = _mm256_sub_ps(_mm256_add_ps(l, l), v);
+            auto sv = _mm256_div_ps(_mm256_sub_ps(v, m), v);
+
+            h = _mm256_mul_ps(h, h_scale);
+            auto sextant = _mm256_cvttps_epi32(h);
+            auto fract = _mm256_sub_ps(h, _mm256_cvtepi32_ps(sextant));
+            auto vsf = _mm256_mul_ps(_mm256_mul_ps(v, sv), fract);
+            auto mid1 = _mm256_add_ps(m, vsf);
+            auto mid2 = _mm256_sub_ps(v, vsf);
+
+            // Gray if v <= 0 or the sextant is out of range
+            auto r = l, g = l, b = l;
+            auto valid = _mm256_cmp_ps(v, zero, _CMP_GT_OQ);
+            hsl_pick_avx2(0, sextant, valid, r, g, b, v, mid1, m);
+            hsl_pick_avx2(1, sextant, valid, r, g, b, mid2, v, m);
+            hsl_pick_avx2(2, sextant, valid, r, g, b, m, v, mid1);
+            hsl_pick_avx2(3, sextant, valid, r, g, b, m, mid2, v);
+            hsl_pick_avx2(4, sextant, valid, r, g, b, mid1, m, v);
+            hsl_pick_avx2(5, sextant, valid, r, g, b, v, m, mid2);
+
+            // Transpose to colors. The in-lane unpacks and shuffles give
+            // colors (0, 4), (1, 5), (2, 6) and (3, 7).
+            auto rg_lo = _mm256_unpacklo_ps(r, g);
+            auto rg_hi = _mm256_unpackhi_ps(r, g);
+            auto ba_lo = _mm256_unpacklo_ps(b, one);
+            auto ba_hi = _mm256_unpackhi_ps(b, one);
+            auto c04 = _mm256_shuffle_ps(rg_lo, ba_lo, _MM_SHUFFLE(1, 0, 1, 0));
+            auto c15 = _mm256_shuffle_ps(rg_lo, ba_lo, _MM_SHUFFLE(3, 2, 3, 2));
+            auto c26 = _mm256_shuffle_ps(rg_hi, ba_hi, _MM_SHUFFLE(1, 0, 1, 0));
+            auto c37 = _mm256_shuffle_ps(rg_hi, ba_hi, _MM_SHUFFLE(3, 2, 3, 2));
+            _mm256_storeu_ps(&dest[i].red, _mm256_permute2f128_ps(c04, c15, 0x20));
+            _mm256_storeu_ps(&dest[i+2].red, _mm256_permute2f128_ps(c26, c37, 0x20));
+            _mm256_storeu_ps(&dest[i+4].red, _mm256_permute2f128_ps(c04, c15, 0x31));
+            _mm256_storeu_ps(&dest[i+6].red, _mm256_permute2f128_ps(c26, c37, 0x31));
+         }
+         hsl_sse2(h_ + i, s_ + i, l_ + i, dest + i, n - i);
+      }
+
+#endif // ARTIST_SIMD_X86
+
+      template <bool bgra>
+      void pack(color const* src, std::uint32_t* dest, std::size_t n)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: pack_avx2<bgra>(src, dest, n); return;
+            case detail::simd_isa::sse2: pack_sse2<bgra>(src, dest, n); return;
+            default: break;
+         }
+#endif
+         pack_scalar<bgra>(src, dest, n);
+      }
+
+      template <bool bgra>
+      void unpack(std::uint32_t const* src, color* dest, std::size_t n)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: unpack_avx2<bgra>(src, dest, n); return;
+            case detail::simd_isa::sse2: unpack_sse2<bgra>(src, dest, n); return;
+            default: break;
+         }
+#endif
+         unpack_scalar<bgra>(src, dest, n);
+      }
+
+      void apply_lut(float const* lut, color* c, std::size_t n)
+      {
+#if defined(ARTIST_SIMD_X86)
+         // No gather before AVX2, so SSE2 uses the scalar code
+         if (detail::simd_level() == detail::simd_isa::avx2)
+            return apply_lut_avx2(lut, c, n);
+#endif
+         apply_lut_scalar(lut, c, n);
+      }
+   }
+
+   void to_rgba8(color const src[], std::uint32_t dest[], std::size_t n)
+   {
+      pack<false>(src, dest, n);
+   }
+
+   void to_bgra8(color const src[], std::uint32_t dest[], std::size_t n)
+   {
+      pack<true>(src, dest, n);
+   }
+
+   void from_rgba8(std::uint32_t const src[], color dest[], std::size_t n)
+   {
+      unpack<false>(src, dest, n);
+   }
+
+   void from_bgra8(std::uint32_t const src[], color dest[], std::size_t n)
+   {
+      unpack<true>(src, dest, n);
+   }
+
+   void premultiply(color c[], std::size_t n)
+   {
+#if defined(ARTIST_SIMD_X86)
+      switch (detail::simd_level())
+      {
+         case detail::simd_isa::avx2: premultiply_avx2(c, n); return;
+         case detail::simd_isa::sse2: premultiply_sse2(c, n); return;
+         default: break;
+      }
+#endif
+      premultiply_scalar(c, n);
+   }
+
+   void unpremultiply(color c[], std::size_t n)
+   {
+#if defined(ARTIST_SIMD_X86)
+      switch (detail::simd_level())
+      {
+         case detail::simd_isa::avx2: unpremultiply_avx2(c, n); return;
+         case detail::simd_isa::sse2: unpremultiply_sse2(c, n); return;
+         default: break;
+      }
+#endif
+      unpremultiply_scalar(c, n);
+   }
+
+   void premultiply(std::uint32_t c[], std::size_t n)
+   {
+#if defined(ARTIST_SIMD_X86)
+      switch (detail::simd_level())
+      {
+         case detail::simd_isa::avx2: premultiply_packed_avx2(c, n); return;
+         case detail::simd_isa::sse2: premultiply_packed_sse2(c, n); return;
+         default: break;
+      }
+#endif
+      premultiply_scalar(c, n);
+   }
+
+   void unpremultiply(std::uint32_t c[], std::size_t n)
+   {
+#if defined(ARTIST_SIMD_X86)
+      switch (detail::simd_level())
+      {
+         case detail::simd_isa::avx2: unpremultiply_packed_avx2(c, n); return;
+         case detail::simd_isa::sse2: unpremultiply_packed_sse2(c, n); return;
+         default: break;
+      }
+#endif
+      unpremultiply_scalar(c, n);
+   }
+
+   void srgb_to_linear(color c[], std::size_t n)
+   {
+      apply_lut(get_srgb_lut().to_linear, c, n);
+   }
+
+   void linear_to_srgb(color c[], std::size_t n)
+   {
+      apply_lut(get_srgb_lut().to_srgb, c, n);
+   }
+
+   void hsl(
+      float const h[], float const s[], float const l[]
+    , color dest[], std::size_t n)
+   {
+#if defined(ARTIST_SIMD_X86)
+      switch (detail::simd_level())
+      {
+         case detail::simd_isa::avx2: hsl_avx2(h, s, l, dest, n); return;
+         case detail::simd_isa::sse2: hsl_sse2(h, s, l, dest, n); return;
+         default: break;
+      }
+#endif
+      hsl_scalar(h, s, l, dest, n);
+   }
+}
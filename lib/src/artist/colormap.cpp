@@ -0,0 +1,196 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/colormap.hpp>
+#include "detail/simd.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      // Note: The SIMD kernels below compute the table index with the same
+      // float operations as the scalar code, so they give the same results.
+      // The scalar code is also used to mop up the remaining elements.
+
+      /////////////////////////////////////////////////////////////////////////
+      // Scalar
+      /////////////////////////////////////////////////////////////////////////
+      void apply_scalar(
+         std::uint32_t const* lut, float last, float const* values
+       , std::size_t n, std::uint32_t* dest, float low, float scale)
+      {
+         for (std::size_t i = 0; i != n; ++i)
+         {
+            // Same as _mm_min_ps(_mm_max_ps(x, 0), last): NaN gives 0
+            float x = (values[i] - low) * scale;
+            x = x > 0.0f? x : 0.0f;
+            x = x < last? x : last;
+            dest[i] = lut[int(x + 0.5f)];
+         }
+      }
+
+#if defined(ARTIST_SIMD_X86)
+
+      /////////////////////////////////////////////////////////////////////////
+      // SSE2 (no gather, so only the index computation is vectorized)
+      /////////////////////////////////////////////////////////////////////////
+      void apply_sse2(
+         std::uint32_t const* lut, float last, float const* values
+       , std::size_t n, std::uint32_t* dest, float low, float scale)
+      {
+         auto const low_ = _mm_set1_ps(low);
+         auto const scale_ = _mm_set1_ps(scale);
+         auto const last_ = _mm_set1_ps(last);
+         auto const zero = _mm_setzero_ps();
+         auto const half = _mm_set1_ps(0.5f);
+
+         alignas(16) std::int32_t idx[4];
+         std::size_t i = 0;
+         for (; i + 4 <= n; i += 4)
+         {
+            auto x = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(values + i), low_), scale_);
+            x = _mm_min_ps(_mm_max_ps(x, zero), last_);
+            _mm_store_si128(
+               reinterpret_cast<__m128i*>(idx), _mm_cvttps_epi32(_mm_add_ps(x, half)));
+            dest[i] = lut[idx[0]];
+            dest[i+1] = lut[idx[1]];
+            dest[i+2] = lut[idx[2]];
+            dest[i+3] = lut[idx[3]];
+         }
+         apply_scalar(lut, last, values + i, n - i, dest + i, low, scale);
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // AVX2
+      /////////////////////////////////////////////////////////////////////////
+      ARTIST_TARGET_AVX2
+      void apply_avx2(
+         std::uint32_t const* lut, float last, float const* values
+       , std::size_t n, std::uint32_t* dest, float low, float scale)
+      {
+         auto const low_ = _mm256_set1_ps(low);
+         auto const scale_ = _mm256_set1_ps(scale);
+         auto const last_ = _mm256_set1_ps(last);
+         auto const zero = _mm256_setzero_ps();
+         auto const half = _mm256_set1_ps(0.5f);
+         auto const base = reinterpret_cast<int const*>(lut);
+
+         std::size_t i = 0;
+         for (; i + 8 <= n; i += 8)
+         {
+            auto x = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(values + i), low_), scale_);
+            x = _mm256_min_ps(_mm256_max_ps(x, zero), last_);
+            auto idx = _mm256_cvttps_epi32(_mm256_add_ps(x, half));
+            _mm256_storeu_si256(
+               reinterpret_cast<__m256i*>(dest + i), _mm256_i32gather_epi32(base, idx, 4));
+         }
+         apply_sse2(lut, last, values + i, n - i, dest + i, low, scale);
+      }
+
+#endif // ARTIST_SIMD_X86
+
+      color lerp_stops(std::vector<colormap::color_stop> const& stops, float t)
+      {
+         if (t <= stops.front().offset)
+            return stops.front().color;
+         if (t >= stops.back().offset)
+            return stops.back().color;
+
+         auto i = std::upper_bound(stops.begin(), stops.end(), t,
+            [](float t_, colormap::color_stop const& s) { return t_ < s.offset; });
+         auto const& a = *(i - 1);
+         auto const& b = *i;
+         auto f = (t - a.offset) / (b.offset - a.offset);
+         return a.color + (b.color - a.color) * f;
+      }
+
+      colormap make_named(std::uint32_t const (&samples)[9], std::size_t size)
+      {
+         std::vector<colormap::color_stop> stops;
+         for (int i = 0; i != 9; ++i)
+            stops.push_back({i / 8.0f, rgb(samples[i])});
+         return colormap(stops, size);
+      }
+   }
+
+   colormap::colormap(std::vector<color_stop> const& stops, std::size_t size)
+   {
+      if (stops.empty())
+         throw std::runtime_error{"Error: colormap needs at least one color stop."};
+      if (size < 2)
+         throw std::runtime_error{"Error: colormap size must be at least 2."};
+
+      auto sorted = stops;
+      std::stable_sort(sorted.begin(), sorted.end(),
+         [](color_stop const& a, color_stop const& b) { return a.offset < b.offset; });
+
+      std::vector<color> colors(size);
+      for (std::size_t i = 0; i != size; ++i)
+         colors[i] = lerp_stops(sorted, float(i) / (size - 1));
+
+      _lut.resize(size);
+      to_rgba8(colors.data(), _lut.data(), size);
+   }
+
+   color colormap::operator()(float v) const
+   {
+      std::uint32_t p;
+      apply(&v, 1, &p);
+      color c;
+      from_rgba8(&p, &c, 1);
+      return c;
+   }
+
+   void colormap::apply(
+      float const values[], std::size_t n
+    , std::uint32_t dest[]
+    , float low, float high
+   ) const
+   {
+      auto lut = _lut.data();
+      auto last = float(_lut.size() - 1);
+      auto scale = last / (high - low);
+
+#if defined(ARTIST_SIMD_X86)
+      switch (detail::simd_level())
+      {
+         case detail::simd_isa::avx2: apply_avx2(lut, last, values, n, dest, low, scale); return;
+         case detail::simd_isa::sse2: apply_sse2(lut, last, values, n, dest, low, scale); return;
+         default: break;
+      }
+#endif
+      apply_scalar(lut, last, values, n, dest, low, scale);
+   }
+
+   namespace colormaps
+   {
+      colormap viridis(std::size_t size)
+      {
+         static constexpr std::uint32_t samples[] =
+         {
+            0x440154, 0x472D7B, 0x3B528B, 0x2C728E, 0x21908C
+          , 0x27AD81, 0x5DC863, 0xAADC32, 0xFDE725
+         };
+         return make_named(samples, size);
+      }
+
+      colormap magma(std::size_t size)
+      {
+         static constexpr std::uint32_t samples[] =
+         {
+            0x000004, 0x1D1147, 0x51127C, 0x822681, 0xB63679
+          , 0xE65164, 0xFB8861, 0xFEC287, 0xFCFDBF
+         };
+         return make_named(samples, size);
+      }
+
+      colormap grays(std::size_t size)
+      {
+         return colormap({{0.0f, colors::black}, {1.0f, colors::white}}, size);
+      }
+   }
+}
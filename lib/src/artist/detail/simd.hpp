@@ -0,0 +1,73 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#if !defined(ARTIST_DETAIL_SIMD_OCTOBER_19_2026)
+#define ARTIST_DETAIL_SIMD_OCTOBER_19_2026
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define ARTIST_SIMD_X86
+# include <immintrin.h>
+# if defined(_MSC_VER) && !defined(__clang__)
+#  include <intrin.h>
+# endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////
+// Kernels that use instructions beyond the x86 baseline (SSE2) are compiled
+// with a per-function target attribute so that the library as a whole does
+// not need -mavx2. They must only be called after checking simd_level().
+// MSVC does not need the attribute: intrinsics are always available there.
+///////////////////////////////////////////////////////////////////////////////
+#if defined(ARTIST_SIMD_X86) && (defined(__GNUC__) || defined(__clang__))
+# define ARTIST_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+# define ARTIST_TARGET_AVX2
+#endif
+
+namespace cycfi::artist::detail
+{
+   enum class simd_isa
+   {
+      scalar,
+      sse2,
+      avx2
+   };
+
+   ////////////////////////////////////////////////////////////////////////////
+   // Returns the best instruction set supported by the running CPU. This is
+   // computed once and cached.
+   ////////////////////////////////////////////////////////////////////////////
+   inline simd_isa simd_level()
+   {
+#if defined(ARTIST_SIMD_X86)
+      static simd_isa const level = []()
+      {
+# if defined(_MSC_VER) && !defined(__clang__)
+         int info[4];
+         __cpuid(info, 0);
+         if (info[0] < 7)
+            return simd_isa::sse2;
+
+         __cpuid(info, 1);
+         bool osxsave = (info[2] & (1 << 27)) != 0;
+         bool avx = (info[2] & (1 << 28)) != 0;
+         if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+            return simd_isa::sse2;
+
+         __cpuidex(info, 7, 0);
+         return (info[1] & (1 << 5))? simd_isa::avx2 : simd_isa::sse2;
+# else
+         __builtin_cpu_init();
+         return __builtin_cpu_supports("avx2")? simd_isa::avx2 : simd_isa::sse2;
+# endif
+      }();
+      return level;
+#else
+      return simd_isa::scalar;
+#endif
+   }
+}
+
+#endif
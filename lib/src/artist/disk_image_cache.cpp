@@ -0,0 +1,393 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/disk_image_cache.hpp>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+
+#if defined(_WIN32)
+# include <windows.h>
+#else
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      constexpr char const* entry_extension = ".pixels";
+      constexpr char entry_magic[8] = {'A', 'R', 'T', 'P', 'I', 'X', 'E', 'L'};
+      constexpr std::uint32_t entry_version = 2;   // 2: mtime from stat_file
+      constexpr std::size_t pixels_alignment = 64;
+
+      // An entry file is this header, then the source path, then the
+      // pixels, starting at pixels_offset.
+      struct entry_header
+      {
+         char           magic[8];
+         std::uint32_t  version;
+         std::int32_t   format;
+         std::uint32_t  width;
+         std::uint32_t  height;
+         std::uint64_t  row_bytes;
+         std::uint64_t  pixels_offset;
+         std::int64_t   mtime;
+         std::uint64_t  file_size;
+         float          target_width;
+         float          target_height;
+         std::uint32_t  path_size;
+         std::uint32_t  reserved;
+      };
+
+      struct source_info
+      {
+         std::string    path;
+         std::int64_t   mtime;
+         std::uint64_t  file_size;
+         extent         target;
+      };
+
+      /////////////////////////////////////////////////////////////////////////
+      // Copy-on-write file mapping
+      /////////////////////////////////////////////////////////////////////////
+#if defined(_WIN32)
+
+      void* map_file(fs::path const& path, std::size_t& size)
+      {
+         auto file = CreateFileW(
+            path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE
+          , nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+         if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+         void* data = nullptr;
+         LARGE_INTEGER file_size;
+         if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+         {
+            size = std::size_t(file_size.QuadPart);
+            if (auto mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr))
+            {
+               data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+               CloseHandle(mapping); // The view keeps the mapping
+            }
+         }
+         CloseHandle(file);
+         return data;
+      }
+
+      void unmap_file(void* data, std::size_t /* size */)
+      {
+         UnmapViewOfFile(data);
+      }
+
+      // Reads the modification time (in 100ns units) and size of a file,
+      // with one call
+      bool stat_file(fs::path const& path, std::int64_t& mtime, std::uint64_t& size)
+      {
+         WIN32_FILE_ATTRIBUTE_DATA attr;
+         if (!GetFileAttributesExW(path.wstring().c_str(), GetFileExInfoStandard, &attr))
+            return false;
+         mtime = (std::int64_t(attr.ftLastWriteTime.dwHighDateTime) << 32)
+            | attr.ftLastWriteTime.dwLowDateTime;
+         size = (std::uint64_t(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+         return true;
+      }
+
+#else
+
+      void* map_file(fs::path const& path, std::size_t& size)
+      {
+         int fd = ::open(path.c_str(), O_RDONLY);
+         if (fd < 0)
+            return nullptr;
+
+         void* data = nullptr;
+         struct stat st;
+         if (::fstat(fd, &st) == 0 && st.st_size > 0)
+         {
+            size = std::size_t(st.st_size);
+            data = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (data == MAP_FAILED)
+               data = nullptr;
+         }
+         ::close(fd); // The mapping keeps the file
+         return data;
+      }
+
+      void unmap_file(void* data, std::size_t size)
+      {
+         ::munmap(data, size);
+      }
+
+      // Reads the modification time (in nanoseconds) and size of a file,
+      // with one call
+      bool stat_file(fs::path const& path, std::int64_t& mtime, std::uint64_t& size)
+      {
+         struct stat st;
+         if (::stat(path.c_str(), &st) != 0)
+            return false;
+# if defined(__APPLE__)
+         auto const& time = st.st_mtimespec;
+# else
+         auto const& time = st.st_mtim;
+# endif
+         mtime = std::int64_t(time.tv_sec) * 1000000000 + time.tv_nsec;
+         size = std::uint64_t(st.st_size);
+         return true;
+      }
+
+#endif
+
+      bool is_scaled(extent target)
+      {
+         return target.x > 0 && target.y > 0;
+      }
+
+      fs::path entry_path(fs::path const& directory, source_info const& src)
+      {
+         auto key = src.path
+            + '|' + std::to_string(src.mtime)
+            + '|' + std::to_string(src.file_size)
+            + '|' + std::to_string(src.target.x)
+            + '|' + std::to_string(src.target.y)
+            ;
+         auto name = std::to_string(std::hash<std::string>{}(key)) + entry_extension;
+         return directory / name;
+      }
+
+      bool matches(entry_header const& h, char const* path, source_info const& src)
+      {
+         return std::memcmp(h.magic, entry_magic, sizeof(entry_magic)) == 0
+            && h.version == entry_version
+            && h.mtime == src.mtime
+            && h.file_size == src.file_size
+            && h.target_width == src.target.x
+            && h.target_height == src.target.y
+            && h.path_size == src.path.size()
+            && std::memcmp(path, src.path.data(), src.path.size()) == 0
+            ;
+      }
+
+      template <pixel_format fmt>
+      image make_mapped(
+         std::uint8_t* pixels, extent size, std::size_t row_bytes
+       , image_release_function release)
+      {
+         using type = typename pixel_type<fmt>::type;
+         return make_image<fmt>(
+            reinterpret_cast<type*>(pixels), size, row_bytes, std::move(release));
+      }
+
+      image_ptr map_entry(fs::path const& entry, source_info const& src)
+      {
+         std::size_t size = 0;
+         auto data = static_cast<std::uint8_t*>(map_file(entry, size));
+         if (!data)
+            return nullptr;
+
+         entry_header h;
+         bool valid = size >= sizeof(h);
+         if (valid)
+         {
+            std::memcpy(&h, data, sizeof(h));
+            valid = sizeof(h) + h.path_size <= size
+               && matches(h, reinterpret_cast<char const*>(data + sizeof(h)), src)
+               && h.pixels_offset + h.row_bytes * h.height <= size
+               ;
+         }
+         if (!valid)
+         {
+            unmap_file(data, size);
+            return nullptr;
+         }
+
+         auto pixels = data + h.pixels_offset;
+         auto img_size = extent{float(h.width), float(h.height)};
+         auto release = [data, size]() { unmap_file(data, size); };
+         try
+         {
+            switch (pixel_format(h.format))
+            {
+               case pixel_format::gray8:
+                  return std::make_shared<image>(make_mapped<pixel_format::gray8>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::rgb16:
+                  return std::make_shared<image>(make_mapped<pixel_format::rgb16>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::rgb32:
+                  return std::make_shared<image>(make_mapped<pixel_format::rgb32>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::rgba32:
+                  return std::make_shared<image>(make_mapped<pixel_format::rgba32>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::bgra32:
+                  return std::make_shared<image>(make_mapped<pixel_format::bgra32>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::bgra32_premul:
+                  return std::make_shared<image>(make_mapped<pixel_format::bgra32_premul>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::rgba32_premul:
+                  return std::make_shared<image>(make_mapped<pixel_format::rgba32_premul>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::alpha8:
+                  return std::make_shared<image>(make_mapped<pixel_format::alpha8>(
+                     pixels, img_size, h.row_bytes, release));
+               case pixel_format::rgba_f16:
+                  return std::make_shared<image>(make_mapped<pixel_format::rgba_f16>(
+                     pixels, img_size, h.row_bytes, release));
+               default:
+                  release();
+                  return nullptr;
+            }
+         }
+         catch (std::runtime_error const&)
+         {
+            // make_image has already called release
+            return nullptr;
+         }
+      }
+
+      void write_entry(fs::path const& entry, image const& img, source_info const& src)
+      {
+         auto format = img.format();
+         auto pixels = reinterpret_cast<char const*>(img.bytes());
+         auto size = img.bitmap_size();
+         auto row_bytes = img.row_bytes();
+         if (format == pixel_format::invalid || !pixels || row_bytes == 0)
+            return;
+
+         entry_header h = {};
+         std::memcpy(h.magic, entry_magic, sizeof(entry_magic));
+         h.version = entry_version;
+         h.format = std::int32_t(format);
+         h.width = std::uint32_t(size.x);
+         h.height = std::uint32_t(size.y);
+         h.row_bytes = row_bytes;
+         h.mtime = src.mtime;
+         h.file_size = src.file_size;
+         h.target_width = src.target.x;
+         h.target_height = src.target.y;
+         h.path_size = std::uint32_t(src.path.size());
+
+         auto end_of_path = sizeof(h) + src.path.size();
+         h.pixels_offset = (end_of_path + pixels_alignment - 1) & ~(pixels_alignment - 1);
+
+         // Write to a temporary file first, so no one maps a partial entry
+         auto tmp = entry;
+         tmp += ".tmp" + std::to_string(std::random_device{}());
+         {
+            std::ofstream out{tmp, std::ios::binary};
+            char const padding[pixels_alignment] = {};
+            out.write(reinterpret_cast<char const*>(&h), sizeof(h));
+            out.write(src.path.data(), src.path.size());
+            out.write(padding, h.pixels_offset - end_of_path);
+            out.write(pixels, row_bytes * h.height);
+            if (!out)
+            {
+               out.close();
+               std::error_code ec;
+               fs::remove(tmp, ec);
+               return;
+            }
+         }
+
+         std::error_code ec;
+         fs::rename(tmp, entry, ec);
+         if (ec)
+            fs::remove(tmp, ec);
+      }
+   }
+
+   disk_image_cache::disk_image_cache(fs::path directory)
+    : _directory{std::move(directory)}
+   {
+      std::error_code ec;
+      fs::create_directories(_directory, ec);
+   }
+
+   fs::path disk_image_cache::resolve(fs::path const& path)
+   {
+      auto requested = path.string();
+      {
+         std::lock_guard<std::mutex> lock{_mutex};
+         if (auto i = _resolved.find(requested); i != _resolved.end())
+            return i->second;
+      }
+
+      auto found = find_file(path);
+      if (!found.empty())
+      {
+         std::lock_guard<std::mutex> lock{_mutex};
+         _resolved.emplace(std::move(requested), found);
+      }
+      return found;
+   }
+
+   void disk_image_cache::forget(fs::path const& path)
+   {
+      std::lock_guard<std::mutex> lock{_mutex};
+      _resolved.erase(path.string());
+   }
+
+   image_ptr disk_image_cache::load(fs::path const& path, extent target)
+   {
+      auto fail = [&path]()
+      {
+         throw std::runtime_error{"Error: Failed to load file: " + path.string()};
+      };
+
+      auto resolved = resolve(path);
+      if (resolved.empty())
+         fail();
+      std::int64_t mtime;
+      std::uint64_t file_size;
+      if (!stat_file(resolved, mtime, file_size))
+      {
+         // Moved or removed: search again
+         forget(path);
+         resolved = find_file(path);
+         if (resolved.empty() || !stat_file(resolved, mtime, file_size))
+            fail();
+      }
+
+      source_info src{
+         resolved.string()
+       , mtime
+       , file_size
+       , is_scaled(target)? target : extent{}
+      };
+
+      auto entry = entry_path(_directory, src);
+      if (auto img = map_entry(entry, src))
+         return img;
+
+      auto img = is_scaled(target)?
+         std::make_shared<image>(resolved, target) :
+         std::make_shared<image>(resolved);
+      write_entry(entry, *img, src);
+      return img;
+   }
+
+   void disk_image_cache::clear()
+   {
+      {
+         std::lock_guard<std::mutex> lock{_mutex};
+         _resolved.clear();
+      }
+
+      std::error_code ec;
+      for (auto const& f : fs::directory_iterator{_directory, ec})
+      {
+         if (f.path().extension() == entry_extension)
+            fs::remove(f.path(), ec);
+      }
+   }
+}
@@ -0,0 +1,188 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/encode_queue.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      // Same estimate as the image_cache: 4 bytes per pixel
+      std::size_t image_bytes(image const& img)
+      {
+         auto size = img.bitmap_size();
+         if (size.x <= 0 || size.y <= 0)
+            size = img.size();
+         return std::size_t(size.x) * std::size_t(size.y) * 4;
+      }
+   }
+
+   struct encode_queue::state
+   {
+      struct job
+      {
+         std::function<void()>   run;
+         std::size_t             bytes;
+      };
+
+                              state(std::size_t max_bytes_, std::size_t num_threads);
+                              ~state();
+
+      void                    push(std::function<void()> run, std::size_t bytes);
+      void                    worker();
+
+      mutable std::mutex      mutex;
+      std::condition_variable jobs_cv;    // Signals workers: a job was added
+      std::condition_variable done_cv;    // Signals producers: a job is done
+      std::deque<job>         jobs;
+      std::size_t             max_bytes;
+      std::size_t             bytes_queued = 0;
+      std::size_t             busy = 0;   // Jobs taken by workers, not yet done
+      std::vector<std::thread> workers;
+      bool                    stop = false;
+   };
+
+   encode_queue::state::state(std::size_t max_bytes_, std::size_t num_threads)
+    : max_bytes{max_bytes_}
+   {
+      if (num_threads == 0)
+         num_threads = std::max(1u, std::thread::hardware_concurrency());
+      for (std::size_t i = 0; i != num_threads; ++i)
+         workers.emplace_back([this]{ worker(); });
+   }
+
+   encode_queue::state::~state()
+   {
+      {
+         std::unique_lock<std::mutex> lock{mutex};
+         done_cv.wait(lock, [this]{ return jobs.empty() && busy == 0; });
+         stop = true;
+      }
+      jobs_cv.notify_all();
+      for (auto& t : workers)
+         t.join();
+   }
+
+   void encode_queue::state::push(std::function<void()> run, std::size_t bytes)
+   {
+      {
+         std::unique_lock<std::mutex> lock{mutex};
+         done_cv.wait(lock,
+            [&]{ return bytes_queued == 0 || bytes_queued + bytes <= max_bytes; });
+         bytes_queued += bytes;
+         jobs.push_back({std::move(run), bytes});
+      }
+      jobs_cv.notify_one();
+   }
+
+   void encode_queue::state::worker()
+   {
+      while (true)
+      {
+         job j;
+         {
+            std::unique_lock<std::mutex> lock{mutex};
+            jobs_cv.wait(lock, [this]{ return stop || !jobs.empty(); });
+            if (stop)
+               return;
+            j = std::move(jobs.front());
+            jobs.pop_front();
+            ++busy;
+         }
+
+         j.run();
+         j.run = nullptr;  // Drops the image before the bytes are given back
+
+         {
+            std::lock_guard<std::mutex> lock{mutex};
+            bytes_queued -= j.bytes;
+            --busy;
+         }
+         done_cv.notify_all();
+      }
+   }
+
+   encode_queue::encode_queue(std::size_t max_bytes, std::size_t num_threads)
+    : _state{std::make_unique<state>(max_bytes, num_threads)}
+   {
+   }
+
+   encode_queue::~encode_queue()
+   {
+   }
+
+   std::future<encode_queue::encoded>
+   encode_queue::encode(image_ptr img, image_format format, int quality)
+   {
+      auto promise = std::make_shared<std::promise<encoded>>();
+      auto future = promise->get_future();
+      auto bytes = image_bytes(*img);
+      _state->push(
+         [img = std::move(img), format, quality, promise]()
+         {
+            try
+            {
+               promise->set_value(img->encode(format, quality));
+            }
+            catch (...)
+            {
+               promise->set_exception(std::current_exception());
+            }
+         }
+       , bytes
+      );
+      return future;
+   }
+
+   std::future<void> encode_queue::save(
+      image_ptr img, fs::path const& path
+    , image_format format, int quality)
+   {
+      auto promise = std::make_shared<std::promise<void>>();
+      auto future = promise->get_future();
+      auto bytes = image_bytes(*img);
+      _state->push(
+         [img = std::move(img), path, format, quality, promise]()
+         {
+            try
+            {
+               img->save(path, format, quality);
+               promise->set_value();
+            }
+            catch (...)
+            {
+               promise->set_exception(std::current_exception());
+            }
+         }
+       , bytes
+      );
+      return future;
+   }
+
+   void encode_queue::wait()
+   {
+      std::unique_lock<std::mutex> lock{_state->mutex};
+      _state->done_cv.wait(lock,
+         [this]{ return _state->jobs.empty() && _state->busy == 0; });
+   }
+
+   std::size_t encode_queue::bytes_queued() const
+   {
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      return _state->bytes_queued;
+   }
+
+   std::size_t encode_queue::max_bytes() const
+   {
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      return _state->max_bytes;
+   }
+}
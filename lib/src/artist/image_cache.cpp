@@ -0,0 +1,387 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/image_cache.hpp>
+#include <artist/image_memory.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      struct cache_key
+      {
+         std::string    path;
+         float          width;
+         float          height;
+
+         bool operator==(cache_key const& other) const
+         {
+            return path == other.path && width == other.width && height == other.height;
+         }
+      };
+
+      struct cache_key_hash
+      {
+         std::size_t operator()(cache_key const& key) const
+         {
+            auto h = std::hash<std::string>{}(key.path);
+            h ^= std::hash<float>{}(key.width) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            h ^= std::hash<float>{}(key.height) + 0x9e3779b9 + (h << 6) + (h >> 2);
+            return h;
+         }
+      };
+
+      bool is_scaled(extent target)
+      {
+         return target.x > 0 && target.y > 0;
+      }
+
+      // Decoded images are 4 bytes per pixel. Images without a bitmap
+      // (e.g. Quartz CGImage backed images) are counted by their size.
+      std::size_t image_bytes(image const& img)
+      {
+         auto size = img.bitmap_size();
+         if (size.x <= 0 || size.y <= 0)
+            size = img.size();
+         return std::size_t(size.x) * std::size_t(size.y) * 4;
+      }
+
+      image_cache::image_future ready_future(image_ptr img)
+      {
+         std::promise<image_ptr> promise;
+         promise.set_value(std::move(img));
+         return promise.get_future().share();
+      }
+   }
+
+   struct image_cache::state
+   {
+      using lru_list = std::list<cache_key>;
+
+      struct entry
+      {
+         image_ptr                     img;
+         std::size_t                   bytes;
+         lru_list::iterator            lru_pos;
+      };
+
+      struct pending_load
+      {
+         image_future                  future;
+         std::vector<load_callback>    callbacks;
+      };
+
+      using entry_map = std::unordered_map<cache_key, entry, cache_key_hash>;
+      using pending_map = std::unordered_map<cache_key, pending_load, cache_key_hash>;
+      using task = std::function<void()>;
+
+                              state(std::size_t budget_, std::size_t num_threads);
+                              ~state();
+
+      fs::path                resolve(fs::path const& path);
+      void                    forget(std::string const& path);
+      image_future            load(fs::path const& path, extent target, load_callback callback);
+      void                    decode(
+                                 cache_key key, fs::path path, extent target
+                               , std::shared_ptr<std::promise<image_ptr>> promise);
+      void                    insert(cache_key const& key, image_ptr img);
+      void                    evict();
+      void                    release(std::size_t bytes);
+      void                    worker();
+
+      mutable std::mutex      mutex;
+      lru_list                lru;        // Most recently used first
+      entry_map               entries;
+      pending_map             pending;
+      std::unordered_map<std::string, fs::path> resolved;  // By requested path
+      std::size_t             budget;
+      std::size_t             bytes_used = 0;
+
+      std::condition_variable tasks_cv;
+      std::deque<task>        tasks;
+      std::vector<std::thread> workers;
+      bool                    stop = false;
+      std::size_t             evictor_id = 0;
+   };
+
+   image_cache::state::state(std::size_t budget_, std::size_t num_threads)
+    : budget{budget_}
+   {
+      if (num_threads == 0)
+         num_threads = std::max(1u, std::thread::hardware_concurrency());
+      for (std::size_t i = 0; i != num_threads; ++i)
+         workers.emplace_back([this]{ worker(); });
+
+      // Dropped images are loaded again on demand
+      evictor_id = add_image_evictor([this](std::size_t bytes){ release(bytes); });
+   }
+
+   image_cache::state::~state()
+   {
+      remove_image_evictor(evictor_id);
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         stop = true;
+         tasks.clear();
+      }
+      tasks_cv.notify_all();
+      for (auto& t : workers)
+         t.join();
+   }
+
+   void image_cache::state::worker()
+   {
+      while (true)
+      {
+         task t;
+         {
+            std::unique_lock<std::mutex> lock{mutex};
+            tasks_cv.wait(lock, [this]{ return stop || !tasks.empty(); });
+            if (stop)
+               return;
+            t = std::move(tasks.front());
+            tasks.pop_front();
+         }
+         t();
+      }
+   }
+
+   // find_file checks each resource path in the file system. Its results
+   // are kept, so that loading an image that is in the cache makes no
+   // system calls.
+   fs::path image_cache::state::resolve(fs::path const& path)
+   {
+      auto requested = path.string();
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         if (auto i = resolved.find(requested); i != resolved.end())
+            return i->second;
+      }
+
+      auto found = find_file(path);
+      if (!found.empty())
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         resolved.emplace(std::move(requested), found);
+      }
+      return found;
+   }
+
+   // Called with the mutex locked, when a resolved file fails to load
+   // (e.g. it was moved), so that the next load searches again
+   void image_cache::state::forget(std::string const& path)
+   {
+      for (auto i = resolved.begin(); i != resolved.end();)
+         i = (i->second.string() == path)? resolved.erase(i) : std::next(i);
+   }
+
+   image_cache::image_future image_cache::state::load(
+      fs::path const& path, extent target, load_callback callback)
+   {
+      if (!is_scaled(target))
+         target = {};
+
+      auto resolved = resolve(path);
+      if (resolved.empty())
+      {
+         if (callback)
+            callback(nullptr);
+         std::promise<image_ptr> promise;
+         promise.set_exception(std::make_exception_ptr(
+            std::runtime_error{"Error: Failed to load file: " + path.string()}));
+         return promise.get_future().share();
+      }
+
+      cache_key key{resolved.string(), target.x, target.y};
+      std::unique_lock<std::mutex> lock{mutex};
+
+      if (auto i = entries.find(key); i != entries.end())
+      {
+         lru.splice(lru.begin(), lru, i->second.lru_pos);
+         auto img = i->second.img;
+         lock.unlock();
+         if (callback)
+            callback(img);
+         return ready_future(std::move(img));
+      }
+
+      // Already loading? Then share that load.
+      if (auto i = pending.find(key); i != pending.end())
+      {
+         if (callback)
+            i->second.callbacks.push_back(std::move(callback));
+         return i->second.future;
+      }
+
+      auto promise = std::make_shared<std::promise<image_ptr>>();
+      auto& p = pending[key];
+      p.future = promise->get_future().share();
+      if (callback)
+         p.callbacks.push_back(std::move(callback));
+      auto future = p.future;
+
+      tasks.push_back(
+         [this, key, resolved, target, promise]()
+         {
+            decode(key, resolved, target, promise);
+         });
+      lock.unlock();
+      tasks_cv.notify_one();
+      return future;
+   }
+
+   void image_cache::state::decode(
+      cache_key key, fs::path path, extent target
+    , std::shared_ptr<std::promise<image_ptr>> promise)
+   {
+      image_ptr img;
+      std::exception_ptr error;
+      try
+      {
+         img = is_scaled(target)?
+            std::make_shared<image>(path, target) :
+            std::make_shared<image>(path);
+      }
+      catch (...)
+      {
+         error = std::current_exception();
+      }
+
+      std::vector<load_callback> callbacks;
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         auto i = pending.find(key);
+         callbacks = std::move(i->second.callbacks);
+         pending.erase(i);
+         if (img)
+            insert(key, img);
+         else
+            forget(key.path);
+      }
+
+      if (error)
+         promise->set_exception(error);
+      else
+         promise->set_value(img);
+      for (auto const& f : callbacks)
+         f(img);
+   }
+
+   void image_cache::state::insert(cache_key const& key, image_ptr img)
+   {
+      auto bytes = image_bytes(*img);
+      lru.push_front(key);
+      entries[key] = entry{std::move(img), bytes, lru.begin()};
+      bytes_used += bytes;
+      evict();
+   }
+
+   void image_cache::state::evict()
+   {
+      while (bytes_used > budget && !lru.empty())
+      {
+         auto i = entries.find(lru.back());
+         bytes_used -= i->second.bytes;
+         entries.erase(i);
+         lru.pop_back();
+      }
+   }
+
+   // Drops the least recently used images, of at least the given bytes,
+   // when the image memory budget is exceeded (see image_memory).
+   void image_cache::state::release(std::size_t bytes)
+   {
+      std::vector<image_ptr> dropped;
+      {
+         std::lock_guard<std::mutex> lock{mutex};
+         std::size_t released = 0;
+         while (released < bytes && !lru.empty())
+         {
+            auto i = entries.find(lru.back());
+            released += i->second.bytes;
+            bytes_used -= i->second.bytes;
+            dropped.push_back(std::move(i->second.img));
+            entries.erase(i);
+            lru.pop_back();
+         }
+      }
+      // The images are destroyed here, outside the lock
+   }
+
+   image_cache::image_cache(std::size_t budget, std::size_t num_threads)
+    : _state{std::make_unique<state>(budget, num_threads)}
+   {
+   }
+
+   image_cache::~image_cache()
+   {
+   }
+
+   image_cache::image_future image_cache::load(fs::path const& path, extent target)
+   {
+      return _state->load(path, target, nullptr);
+   }
+
+   void image_cache::load(fs::path const& path, extent target, load_callback callback)
+   {
+      _state->load(path, target, std::move(callback));
+   }
+
+   image_ptr image_cache::find(fs::path const& path, extent target) const
+   {
+      if (!is_scaled(target))
+         target = {};
+
+      auto resolved = _state->resolve(path);
+      if (resolved.empty())
+         return nullptr;
+
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      auto i = _state->entries.find({resolved.string(), target.x, target.y});
+      if (i == _state->entries.end())
+         return nullptr;
+      _state->lru.splice(_state->lru.begin(), _state->lru, i->second.lru_pos);
+      return i->second.img;
+   }
+
+   std::size_t image_cache::budget() const
+   {
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      return _state->budget;
+   }
+
+   void image_cache::budget(std::size_t bytes)
+   {
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      _state->budget = bytes;
+      _state->evict();
+   }
+
+   std::size_t image_cache::bytes_used() const
+   {
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      return _state->bytes_used;
+   }
+
+   void image_cache::clear()
+   {
+      std::lock_guard<std::mutex> lock{_state->mutex};
+      _state->entries.clear();
+      _state->lru.clear();
+      _state->resolved.clear();
+      _state->bytes_used = 0;
+   }
+}
@@ -0,0 +1,187 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/image_memory.hpp>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      struct usage_counters
+      {
+         std::atomic<std::size_t>   images{0};
+         std::atomic<std::size_t>   bitmap_bytes{0};
+         std::atomic<std::size_t>   borrowed_bytes{0};
+         std::atomic<std::size_t>   picture_bytes{0};
+         std::atomic<std::size_t>   cached_bytes{0};
+         std::atomic<std::size_t>   surface_pool_bytes{0};
+         std::atomic<std::size_t>   raster_cache_bytes{0};
+         std::atomic<std::size_t>   text_cache_bytes{0};
+
+         std::size_t total_bytes() const
+         {
+            return bitmap_bytes + picture_bytes + cached_bytes
+               + surface_pool_bytes + raster_cache_bytes + text_cache_bytes;
+         }
+      };
+
+      struct eviction_state
+      {
+         using evictor_list = std::vector<std::pair<std::size_t, image_evictor>>;
+
+         std::mutex                 mutex;   // Held while evictors run
+         evictor_list               evictors;
+         std::size_t                next_id = 1;
+         std::atomic<std::size_t>   budget{0};
+         std::atomic<std::size_t>   evictions{0};
+      };
+
+      // Function statics, so that images in other static objects can be
+      // counted during static initialization and destruction.
+      usage_counters& usage()
+      {
+         static usage_counters counters;
+         return counters;
+      }
+
+      eviction_state& eviction()
+      {
+         static eviction_state state;
+         return state;
+      }
+
+      thread_local bool evicting = false;
+
+      struct evicting_guard
+      {
+         evicting_guard() { evicting = true; }
+         ~evicting_guard() { evicting = false; }
+      };
+
+      void update(std::atomic<std::size_t>& counter, std::size_t from, std::size_t to)
+      {
+         if (to > from)
+            counter += to - from;
+         else
+            counter -= from - to;
+      }
+
+      bool over_budget()
+      {
+         auto budget = eviction().budget.load();
+         return budget != 0 && usage().total_bytes() > budget;
+      }
+
+      void evict()
+      {
+         auto& e = eviction();
+         std::unique_lock<std::mutex> lock{e.mutex, std::try_to_lock};
+         if (!lock.owns_lock())
+            return; // Another thread is evicting
+
+         // Memory an evictor frees may move to another (e.g. the pixels of
+         // dropped rasters go back to the surface_pool), so go over them
+         // again, as long as they free memory
+         evicting_guard guard;
+         for (bool freed = true; freed;)
+         {
+            freed = false;
+            for (auto const& entry : e.evictors)
+            {
+               auto budget = e.budget.load();
+               auto used = usage().total_bytes();
+               if (budget == 0 || used <= budget)
+                  return;
+               ++e.evictions;
+               entry.second(used - budget);
+               if (usage().total_bytes() < used)
+                  freed = true;
+            }
+         }
+      }
+
+      void update(usage_counters& u, image_memory_stats const& from, image_memory_stats const& to)
+      {
+         update(u.images, from.images, to.images);
+         update(u.bitmap_bytes, from.bitmap_bytes, to.bitmap_bytes);
+         update(u.borrowed_bytes, from.borrowed_bytes, to.borrowed_bytes);
+         update(u.picture_bytes, from.picture_bytes, to.picture_bytes);
+         update(u.cached_bytes, from.cached_bytes, to.cached_bytes);
+         update(u.surface_pool_bytes, from.surface_pool_bytes, to.surface_pool_bytes);
+         update(u.raster_cache_bytes, from.raster_cache_bytes, to.raster_cache_bytes);
+         update(u.text_cache_bytes, from.text_cache_bytes, to.text_cache_bytes);
+      }
+   }
+
+   image_memory_stats image_memory()
+   {
+      auto const& u = usage();
+      image_memory_stats stats;
+      stats.images = u.images;
+      stats.bitmap_bytes = u.bitmap_bytes;
+      stats.borrowed_bytes = u.borrowed_bytes;
+      stats.picture_bytes = u.picture_bytes;
+      stats.cached_bytes = u.cached_bytes;
+      stats.surface_pool_bytes = u.surface_pool_bytes;
+      stats.raster_cache_bytes = u.raster_cache_bytes;
+      stats.text_cache_bytes = u.text_cache_bytes;
+      stats.budget = eviction().budget;
+      stats.evictions = eviction().evictions;
+      return stats;
+   }
+
+   void image_memory_budget(std::size_t bytes)
+   {
+      eviction().budget = bytes;
+      if (!evicting && over_budget())
+         evict();
+   }
+
+   std::size_t add_image_evictor(image_evictor evictor)
+   {
+      auto& e = eviction();
+      std::lock_guard<std::mutex> lock{e.mutex};
+      auto id = e.next_id++;
+      e.evictors.emplace_back(id, std::move(evictor));
+      return id;
+   }
+
+   void remove_image_evictor(std::size_t id)
+   {
+      auto& e = eviction();
+      std::lock_guard<std::mutex> lock{e.mutex};
+      e.evictors.erase(
+         std::remove_if(e.evictors.begin(), e.evictors.end(),
+            [id](auto const& entry) { return entry.first == id; })
+       , e.evictors.end()
+      );
+   }
+
+   namespace detail
+   {
+      void update_image_memory(image_memory_stats const& from, image_memory_stats const& to)
+      {
+         update(usage(), from, to);
+         if (to.total_bytes() > from.total_bytes())
+            enforce_image_memory_budget();
+      }
+
+      void update_cache_memory(image_memory_stats const& from, image_memory_stats const& to)
+      {
+         update(usage(), from, to);
+      }
+
+      void enforce_image_memory_budget()
+      {
+         if (!evicting && over_budget())
+            evict();
+      }
+   }
+}
@@ -0,0 +1,683 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/image_ops.hpp>
+#include "detail/simd.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      using byte = std::uint8_t;
+
+      // Pixels of a bitmap with four 8-bit channels
+      struct pixmap_view
+      {
+         byte*          data;
+         int            width;
+         int            height;
+         std::size_t    row_bytes;
+
+         byte*          row(int y) const { return data + y * row_bytes; }
+      };
+
+      pixmap_view pixmap_of(image const& img)
+      {
+         switch (img.format())
+         {
+            case pixel_format::rgb32:
+            case pixel_format::rgba32:
+            case pixel_format::bgra32:
+            case pixel_format::bgra32_premul:
+            case pixel_format::rgba32_premul:
+               break;
+            default:
+               throw std::runtime_error{
+                  "Error: image_ops needs a bitmap image with 32-bit pixels."};
+         }
+
+         auto pixels = const_cast<image&>(img).pixels();
+         if (!pixels)
+            throw std::runtime_error{"Error: image_ops needs accessible pixels."};
+         auto size = img.bitmap_size();
+         return {
+            reinterpret_cast<byte*>(pixels)
+          , int(size.x), int(size.y), img.row_bytes()
+         };
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // Filter taps: output i is the sum, for j in [0, count), of
+      // weight[i*count + j] * input[index[i*count + j]]. Blurs and resizing
+      // differ only in their taps.
+      /////////////////////////////////////////////////////////////////////////
+      struct filter_taps
+      {
+         int                  count = 0;
+         std::vector<int>     index;
+         std::vector<float>   weight;
+      };
+
+      // A centered kernel, with edge pixels repeated
+      filter_taps kernel_taps(int n, std::vector<float> const& kernel)
+      {
+         filter_taps t;
+         t.count = int(kernel.size());
+         t.index.resize(std::size_t(n) * t.count);
+         t.weight.resize(t.index.size());
+
+         int radius = t.count / 2;
+         for (int i = 0; i != n; ++i)
+         {
+            for (int j = 0; j != t.count; ++j)
+            {
+               t.index[i * t.count + j] = std::clamp(i + j - radius, 0, n - 1);
+               t.weight[i * t.count + j] = kernel[j];
+            }
+         }
+         return t;
+      }
+
+      float sinc(float x)
+      {
+         constexpr float pi = 3.14159265358979f;
+         return std::sin(pi * x) / (pi * x);
+      }
+
+      float filter_weight(image_ops::resize_filter filter, float x)
+      {
+         x = std::abs(x);
+         switch (filter)
+         {
+            case image_ops::resize_filter::bilinear:
+               return x < 1.0f? 1.0f - x : 0.0f;
+
+            case image_ops::resize_filter::lanczos3:
+               if (x < 1e-6f)
+                  return 1.0f;
+               return x < 3.0f? sinc(x) * sinc(x / 3.0f) : 0.0f;
+         }
+         return 0.0f;
+      }
+
+      // Resampling from src_n to dest_n pixels. When shrinking, the filter
+      // is stretched to cover all the source pixels that map to an output.
+      filter_taps resample_taps(int src_n, int dest_n, image_ops::resize_filter filter)
+      {
+         float support = (filter == image_ops::resize_filter::bilinear)? 1.0f : 3.0f;
+         float scale = float(dest_n) / src_n;
+         float stretch = std::min(scale, 1.0f);
+         float radius = support / stretch;
+
+         filter_taps t;
+         t.count = int(std::ceil(radius * 2)) + 1;
+         t.index.resize(std::size_t(dest_n) * t.count);
+         t.weight.resize(t.index.size());
+
+         for (int i = 0; i != dest_n; ++i)
+         {
+            float center = (i + 0.5f) / scale - 0.5f;
+            int start = int(std::ceil(center - radius));
+            auto index = &t.index[i * t.count];
+            auto weight = &t.weight[i * t.count];
+
+            float total = 0.0f;
+            for (int j = 0; j != t.count; ++j)
+            {
+               index[j] = std::clamp(start + j, 0, src_n - 1);
+               weight[j] = filter_weight(filter, (start + j - center) * stretch);
+               total += weight[j];
+            }
+            if (total != 0.0f)
+            {
+               for (int j = 0; j != t.count; ++j)
+                  weight[j] /= total;
+            }
+         }
+         return t;
+      }
+
+      // Note: The SIMD kernels below accumulate in float with the same
+      // operations, in the same order, as the scalar code (no FMA), and
+      // round the same way, so they give the same results. The scalar
+      // code is also used to mop up the remaining pixels.
+
+      byte to_byte(float v)
+      {
+         // Same as _mm_cvtps_epi32 followed by saturating packs
+         v = std::nearbyint(v);
+         return byte(v < 0.0f? 0.0f : v > 255.0f? 255.0f : v);
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // Scalar
+      /////////////////////////////////////////////////////////////////////////
+
+      // Horizontal pass: filters pixels [x0, x1) of a row
+      void hpass_scalar(byte const* src, byte* dest, filter_taps const& t, int x0, int x1)
+      {
+         auto n = t.count;
+         for (int x = x0; x != x1; ++x)
+         {
+            auto index = &t.index[x * n];
+            auto weight = &t.weight[x * n];
+            float acc[4] = {};
+            for (int j = 0; j != n; ++j)
+            {
+               auto p = src + index[j] * 4;
+               for (int c = 0; c != 4; ++c)
+                  acc[c] += weight[j] * p[c];
+            }
+            for (int c = 0; c != 4; ++c)
+               dest[x * 4 + c] = to_byte(acc[c]);
+         }
+      }
+
+      // Vertical pass: filters bytes [x0, x1) of n rows into dest
+      void vpass_scalar(
+         byte const* const rows[], float const weight[], int n
+       , byte* dest, std::size_t x0, std::size_t x1)
+      {
+         for (auto x = x0; x != x1; ++x)
+         {
+            float acc = 0.0f;
+            for (int j = 0; j != n; ++j)
+               acc += weight[j] * rows[j][x];
+            dest[x] = to_byte(acc);
+         }
+      }
+
+      // 2D convolution of pixels [x0, x1), given the size rows of a padded
+      // source where pixel x of the output is centered at x + size/2.
+      void convolve_scalar(
+         byte const* const rows[], float const kernel[], int size
+       , byte* dest, int x0, int x1)
+      {
+         for (int x = x0; x != x1; ++x)
+         {
+            float acc[4] = {};
+            for (int ky = 0; ky != size; ++ky)
+            {
+               for (int kx = 0; kx != size; ++kx)
+               {
+                  auto p = rows[ky] + (x + kx) * 4;
+                  auto k = kernel[ky * size + kx];
+                  for (int c = 0; c != 4; ++c)
+                     acc[c] += k * p[c];
+               }
+            }
+            for (int c = 0; c != 4; ++c)
+               dest[x * 4 + c] = to_byte(acc[c]);
+         }
+      }
+
+#if defined(ARTIST_SIMD_X86)
+
+      /////////////////////////////////////////////////////////////////////////
+      // SSE2 (one pixel per vector)
+      /////////////////////////////////////////////////////////////////////////
+      std::int32_t load_u32(byte const* p)
+      {
+         std::int32_t v;
+         std::memcpy(&v, p, sizeof(v));
+         return v;
+      }
+
+      __m128 load_pixel(byte const* p)
+      {
+         auto const zero = _mm_setzero_si128();
+         auto v = _mm_cvtsi32_si128(load_u32(p));
+         v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+         return _mm_cvtepi32_ps(v);
+      }
+
+      void store_pixel(byte* p, __m128 v)
+      {
+         auto i = _mm_cvtps_epi32(v);
+         i = _mm_packs_epi32(i, i);
+         i = _mm_packus_epi16(i, i);
+         auto u = _mm_cvtsi128_si32(i);
+         std::memcpy(p, &u, sizeof(u));
+      }
+
+      void hpass_sse2(byte const* src, byte* dest, filter_taps const& t, int x0, int x1)
+      {
+         auto n = t.count;
+         for (int x = x0; x != x1; ++x)
+         {
+            auto index = &t.index[x * n];
+            auto weight = &t.weight[x * n];
+            auto acc = _mm_setzero_ps();
+            for (int j = 0; j != n; ++j)
+            {
+               auto p = load_pixel(src + index[j] * 4);
+               acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weight[j]), p));
+            }
+            store_pixel(dest + x * 4, acc);
+         }
+      }
+
+      void vpass_sse2(
+         byte const* const rows[], float const weight[], int n
+       , byte* dest, std::size_t x0, std::size_t x1)
+      {
+         auto const zero = _mm_setzero_si128();
+         auto x = x0;
+         for (; x + 16 <= x1; x += 16)
+         {
+            __m128 acc[4] = {
+               _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps()
+            };
+            for (int j = 0; j != n; ++j)
+            {
+               auto v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[j] + x));
+               auto lo = _mm_unpacklo_epi8(v, zero);
+               auto hi = _mm_unpackhi_epi8(v, zero);
+               auto w = _mm_set1_ps(weight[j]);
+               acc[0] = _mm_add_ps(acc[0],
+                  _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero))));
+               acc[1] = _mm_add_ps(acc[1],
+                  _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero))));
+               acc[2] = _mm_add_ps(acc[2],
+                  _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero))));
+               acc[3] = _mm_add_ps(acc[3],
+                  _mm_mul_ps(w, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero))));
+            }
+            auto lo = _mm_packs_epi32(_mm_cvtps_epi32(acc[0]), _mm_cvtps_epi32(acc[1]));
+            auto hi = _mm_packs_epi32(_mm_cvtps_epi32(acc[2]), _mm_cvtps_epi32(acc[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x), _mm_packus_epi16(lo, hi));
+         }
+         vpass_scalar(rows, weight, n, dest, x, x1);
+      }
+
+      void convolve_sse2(
+         byte const* const rows[], float const kernel[], int size
+       , byte* dest, int x0, int x1)
+      {
+         for (int x = x0; x != x1; ++x)
+         {
+            auto acc = _mm_setzero_ps();
+            for (int ky = 0; ky != size; ++ky)
+            {
+               for (int kx = 0; kx != size; ++kx)
+               {
+                  auto p = load_pixel(rows[ky] + (x + kx) * 4);
+                  auto k = _mm_set1_ps(kernel[ky * size + kx]);
+                  acc = _mm_add_ps(acc, _mm_mul_ps(k, p));
+               }
+            }
+            store_pixel(dest + x * 4, acc);
+         }
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // AVX2 (two pixels per vector)
+      /////////////////////////////////////////////////////////////////////////
+      ARTIST_TARGET_AVX2
+      __m256 load_pixels(byte const* a, byte const* b)
+      {
+         auto ab = _mm_unpacklo_epi32(
+            _mm_cvtsi32_si128(load_u32(a)), _mm_cvtsi32_si128(load_u32(b)));
+         return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(ab));
+      }
+
+      ARTIST_TARGET_AVX2
+      __m128i pack_bytes(__m256 v)
+      {
+         // 8 floats to 8 bytes, in the low half
+         auto i = _mm256_cvtps_epi32(v);
+         auto s = _mm_packs_epi32(_mm256_castsi256_si128(i), _mm256_extracti128_si256(i, 1));
+         return _mm_packus_epi16(s, s);
+      }
+
+      ARTIST_TARGET_AVX2
+      void hpass_avx2(byte const* src, byte* dest, filter_taps const& t, int x0, int x1)
+      {
+         auto n = t.count;
+         int x = x0;
+         for (; x + 2 <= x1; x += 2)
+         {
+            auto index = &t.index[x * n];
+            auto weight = &t.weight[x * n];
+            auto acc = _mm256_setzero_ps();
+            for (int j = 0; j != n; ++j)
+            {
+               auto p = load_pixels(src + index[j] * 4, src + index[n + j] * 4);
+               auto w = _mm256_insertf128_ps(
+                  _mm256_castps128_ps256(_mm_set1_ps(weight[j])), _mm_set1_ps(weight[n + j]), 1);
+               acc = _mm256_add_ps(acc, _mm256_mul_ps(w, p));
+            }
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + x * 4), pack_bytes(acc));
+         }
+         hpass_sse2(src, dest, t, x, x1);
+      }
+
+      ARTIST_TARGET_AVX2
+      void vpass_avx2(
+         byte const* const rows[], float const weight[], int n
+       , byte* dest, std::size_t x0, std::size_t x1)
+      {
+         auto x = x0;
+         for (; x + 16 <= x1; x += 16)
+         {
+            auto acc0 = _mm256_setzero_ps();
+            auto acc1 = _mm256_setzero_ps();
+            for (int j = 0; j != n; ++j)
+            {
+               auto v = _mm_loadu_si128(reinterpret_cast<__m128i const*>(rows[j] + x));
+               auto w = _mm256_set1_ps(weight[j]);
+               acc0 = _mm256_add_ps(acc0,
+                  _mm256_mul_ps(w, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v))));
+               acc1 = _mm256_add_ps(acc1,
+                  _mm256_mul_ps(w, _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(v, 8)))));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + x),
+               _mm_unpacklo_epi64(pack_bytes(acc0), pack_bytes(acc1)));
+         }
+         vpass_scalar(rows, weight, n, dest, x, x1);
+      }
+
+      ARTIST_TARGET_AVX2
+      void convolve_avx2(
+         byte const* const rows[], float const kernel[], int size
+       , byte* dest, int x0, int x1)
+      {
+         int x = x0;
+         for (; x + 2 <= x1; x += 2)
+         {
+            auto acc = _mm256_setzero_ps();
+            for (int ky = 0; ky != size; ++ky)
+            {
+               for (int kx = 0; kx != size; ++kx)
+               {
+                  // Two adjacent pixels
+                  auto v = _mm_loadl_epi64(
+                     reinterpret_cast<__m128i const*>(rows[ky] + (x + kx) * 4));
+                  auto p = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+                  auto k = _mm256_set1_ps(kernel[ky * size + kx]);
+                  acc = _mm256_add_ps(acc, _mm256_mul_ps(k, p));
+               }
+            }
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(dest + x * 4), pack_bytes(acc));
+         }
+         convolve_sse2(rows, kernel, size, dest, x, x1);
+      }
+
+#endif // ARTIST_SIMD_X86
+
+      /////////////////////////////////////////////////////////////////////////
+      // Dispatch
+      /////////////////////////////////////////////////////////////////////////
+      void hpass(byte const* src, byte* dest, filter_taps const& t, int width)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: hpass_avx2(src, dest, t, 0, width); return;
+            case detail::simd_isa::sse2: hpass_sse2(src, dest, t, 0, width); return;
+            default: break;
+         }
+#endif
+         hpass_scalar(src, dest, t, 0, width);
+      }
+
+      void vpass(
+         byte const* const rows[], float const weight[], int n
+       , byte* dest, std::size_t size)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: vpass_avx2(rows, weight, n, dest, 0, size); return;
+            case detail::simd_isa::sse2: vpass_sse2(rows, weight, n, dest, 0, size); return;
+            default: break;
+         }
+#endif
+         vpass_scalar(rows, weight, n, dest, 0, size);
+      }
+
+      void convolve_row(
+         byte const* const rows[], float const kernel[], int size
+       , byte* dest, int width)
+      {
+#if defined(ARTIST_SIMD_X86)
+         switch (detail::simd_level())
+         {
+            case detail::simd_isa::avx2: convolve_avx2(rows, kernel, size, dest, 0, width); return;
+            case detail::simd_isa::sse2: convolve_sse2(rows, kernel, size, dest, 0, width); return;
+            default: break;
+         }
+#endif
+         convolve_scalar(rows, kernel, size, dest, 0, width);
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // Calls f(y0, y1) for bands of rows in [0, n), one band per core, on
+      // separate threads. Small images are done in one band, on the calling
+      // thread, where starting threads would cost more than it saves.
+      /////////////////////////////////////////////////////////////////////////
+      template <typename F>
+      void for_each_band(int n, int width, F f)
+      {
+         constexpr std::size_t min_band_pixels = 64 * 1024;
+
+         std::size_t cores = std::max(1u, std::thread::hardware_concurrency());
+         auto bands = std::min({
+            cores
+          , std::size_t(n) * std::size_t(width) / min_band_pixels
+          , std::size_t(n)
+         });
+
+         if (bands <= 1)
+         {
+            f(0, n);
+            return;
+         }
+
+         std::vector<std::thread> threads;
+         for (std::size_t b = 1; b != bands; ++b)
+            threads.emplace_back(f, int(n * b / bands), int(n * (b + 1) / bands));
+         f(0, int(n / bands));
+         for (auto& t : threads)
+            t.join();
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // Separable filtering of src into dest: a horizontal pass into a
+      // temporary buffer (dest.width x src.height), then a vertical pass.
+      // src and dest may be the same pixels.
+      /////////////////////////////////////////////////////////////////////////
+      void separable(
+         pixmap_view src, pixmap_view dest
+       , filter_taps const& xtaps, filter_taps const& ytaps)
+      {
+         auto tmp_row_bytes = std::size_t(dest.width) * 4;
+         std::vector<byte> tmp(tmp_row_bytes * src.height);
+
+         for_each_band(src.height, dest.width,
+            [&](int y0, int y1)
+            {
+               for (int y = y0; y != y1; ++y)
+                  hpass(src.row(y), tmp.data() + y * tmp_row_bytes, xtaps, dest.width);
+            }
+         );
+
+         auto n = ytaps.count;
+         for_each_band(dest.height, dest.width,
+            [&, n](int y0, int y1)
+            {
+               std::unique_ptr<byte const*[]> rows{new byte const*[n]};
+               for (int y = y0; y != y1; ++y)
+               {
+                  for (int j = 0; j != n; ++j)
+                     rows[j] = tmp.data() + ytaps.index[y * n + j] * tmp_row_bytes;
+                  vpass(rows.get(), &ytaps.weight[y * n], n, dest.row(y), tmp_row_bytes);
+               }
+            }
+         );
+      }
+
+      bool is_premultiplied(pixel_format fmt)
+      {
+         return fmt == pixel_format::bgra32_premul || fmt == pixel_format::rgba32_premul;
+      }
+
+      // Premultiplied colors are never more than alpha, but filters with
+      // negative weights (lanczos3, or a sharpen kernel) ring past it, so
+      // clamp them.
+      void clamp_to_alpha(pixmap_view pm)
+      {
+         for_each_band(pm.height, pm.width,
+            [&](int y0, int y1)
+            {
+               for (int y = y0; y != y1; ++y)
+               {
+                  auto p = pm.row(y);
+                  for (int x = 0; x != pm.width; ++x, p += 4)
+                  {
+                     for (int c = 0; c != 3; ++c)
+                        p[c] = std::min(p[c], p[3]);
+                  }
+               }
+            }
+         );
+      }
+
+      void filter(image& img, std::vector<float> const& kernel)
+      {
+         auto pm = pixmap_of(img);
+         separable(pm, pm, kernel_taps(pm.width, kernel), kernel_taps(pm.height, kernel));
+         img.pixels_changed();
+      }
+
+      template <pixel_format fmt>
+      image make_owned(std::uint32_t* pixels, extent size)
+      {
+         return make_image<fmt>(
+            pixels, size, std::size_t(size.x) * 4, [pixels]() { delete[] pixels; });
+      }
+   }
+
+   namespace image_ops
+   {
+      void box_blur(image& img, int radius)
+      {
+         if (radius <= 0)
+            return;
+         auto n = 2 * radius + 1;
+         filter(img, std::vector<float>(n, 1.0f / n));
+      }
+
+      void gaussian_blur(image& img, float sigma)
+      {
+         if (sigma <= 0.0f)
+            return;
+
+         auto radius = int(std::ceil(sigma * 3));
+         std::vector<float> kernel(2 * radius + 1);
+         float total = 0.0f;
+         for (int i = -radius; i <= radius; ++i)
+         {
+            kernel[i + radius] = std::exp(-(i * i) / (2 * sigma * sigma));
+            total += kernel[i + radius];
+         }
+         for (auto& k : kernel)
+            k /= total;
+         filter(img, kernel);
+      }
+
+      void convolve(image& img, float const kernel[], int size)
+      {
+         if (size < 1 || size % 2 == 0)
+            throw std::runtime_error{"Error: convolve needs an odd kernel size."};
+
+         auto pm = pixmap_of(img);
+         auto radius = size / 2;
+
+         // A copy of the source, with the edge pixels repeated all around
+         auto padded_width = pm.width + 2 * radius;
+         auto padded_row_bytes = std::size_t(padded_width) * 4;
+         std::vector<byte> padded(padded_row_bytes * (pm.height + 2 * radius));
+         for (int y = 0; y != pm.height + 2 * radius; ++y)
+         {
+            auto src = pm.row(std::clamp(y - radius, 0, pm.height - 1));
+            auto dest = padded.data() + y * padded_row_bytes;
+            for (int x = 0; x != radius; ++x)
+            {
+               std::memcpy(dest + x * 4, src, 4);
+               std::memcpy(dest + (radius + pm.width + x) * 4, src + (pm.width - 1) * 4, 4);
+            }
+            std::memcpy(dest + radius * 4, src, std::size_t(pm.width) * 4);
+         }
+
+         for_each_band(pm.height, pm.width,
+            [&](int y0, int y1)
+            {
+               std::unique_ptr<byte const*[]> rows{new byte const*[size]};
+               for (int y = y0; y != y1; ++y)
+               {
+                  for (int ky = 0; ky != size; ++ky)
+                     rows[ky] = padded.data() + (y + ky) * padded_row_bytes;
+                  convolve_row(rows.get(), kernel, size, pm.row(y), pm.width);
+               }
+            }
+         );
+         if (is_premultiplied(img.format()))
+            clamp_to_alpha(pm);
+         img.pixels_changed();
+      }
+
+      image resize(image const& img, extent size, resize_filter filter)
+      {
+         auto src = pixmap_of(img);
+         auto width = int(size.x);
+         auto height = int(size.y);
+         if (width <= 0 || height <= 0)
+            throw std::runtime_error{"Error: resize needs a non-empty size."};
+
+         auto pixels = new std::uint32_t[std::size_t(width) * height];
+         try
+         {
+            pixmap_view dest{
+               reinterpret_cast<byte*>(pixels), width, height, std::size_t(width) * 4};
+            separable(
+               src, dest
+             , resample_taps(src.width, width, filter)
+             , resample_taps(src.height, height, filter)
+            );
+            if (is_premultiplied(img.format()))
+               clamp_to_alpha(dest);
+         }
+         catch (...)
+         {
+            delete[] pixels;
+            throw;
+         }
+
+         // make_image calls the release function if it throws
+         size = {float(width), float(height)};
+         switch (img.format())
+         {
+            case pixel_format::rgb32:
+               return make_owned<pixel_format::rgb32>(pixels, size);
+            case pixel_format::rgba32:
+               return make_owned<pixel_format::rgba32>(pixels, size);
+            case pixel_format::bgra32:
+               return make_owned<pixel_format::bgra32>(pixels, size);
+            case pixel_format::bgra32_premul:
+               return make_owned<pixel_format::bgra32_premul>(pixels, size);
+            default:
+               return make_owned<pixel_format::rgba32_premul>(pixels, size);
+         }
+      }
+   }
+}
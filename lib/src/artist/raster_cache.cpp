@@ -0,0 +1,384 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/raster_cache.hpp>
+#include <artist/image_memory.hpp>
+#include <cmath>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      // Keys seen, including the many that never get a raster
+      constexpr std::size_t max_entries = 4096;
+
+      struct entry
+      {
+         using lru_iterator = std::list<std::size_t>::iterator;
+
+         rect              bounds;
+         point             scale;
+         int               frames = 0;       // Drawn in a row, unchanged
+         std::uint64_t     last_frame = 0;   // The frame it was last drawn in
+         image_ptr         raster;
+         std::size_t       bytes = 0;
+         lru_iterator      lru;              // In cache_state::lru
+      };
+
+      struct cache_state
+      {
+                           cache_state();
+                           ~cache_state();
+
+         void              touch(entry& e);
+         void              count_frame(entry& e);
+         void              add_raster(entry& e, image_ptr raster, std::size_t bytes);
+         void              drop_raster(entry& e);
+         void              trim(std::size_t max_bytes, std::vector<image_ptr>& dropped);
+         void              evict(std::size_t bytes);
+         void              report(std::size_t from);
+
+         std::mutex        mutex;
+         std::unordered_map<std::size_t, entry> entries;
+         std::list<std::size_t> lru;         // Keys, most recently drawn first
+         raster_cache_stats stats;
+         int               min_frames = raster_cache::default_min_frames;
+         std::uint64_t     frame = 1;
+         std::size_t       evictor;
+      };
+
+      cache_state::cache_state()
+      {
+         stats.max_bytes = raster_cache::default_max_bytes;
+         evictor = add_image_evictor([this](std::size_t bytes) { evict(bytes); });
+      }
+
+      cache_state::~cache_state()
+      {
+         remove_image_evictor(evictor);
+      }
+
+      // Keeps image_memory's count of the raster bytes in step. Called
+      // with the lock held, after stats.bytes changed from `from`.
+      void cache_state::report(std::size_t from)
+      {
+         image_memory_stats before, now;
+         before.raster_cache_bytes = from;
+         now.raster_cache_bytes = stats.bytes;
+         detail::update_cache_memory(before, now);
+      }
+
+      void cache_state::touch(entry& e)
+      {
+         lru.splice(lru.begin(), lru, e.lru);
+      }
+
+      // Counts the frames the entry was drawn in, in a row. Drawing it
+      // again in the same frame does not count; skipping a frame starts
+      // the count again.
+      void cache_state::count_frame(entry& e)
+      {
+         if (e.last_frame == frame)
+            return;
+         e.frames = e.last_frame + 1 == frame? e.frames + 1 : 1;
+         e.last_frame = frame;
+      }
+
+      void cache_state::add_raster(entry& e, image_ptr raster, std::size_t bytes)
+      {
+         e.raster = std::move(raster);
+         e.bytes = bytes;
+         stats.bytes += bytes;
+         ++stats.rasters;
+         ++stats.rasterizations;
+         report(stats.bytes - bytes);
+      }
+
+      void cache_state::drop_raster(entry& e)
+      {
+         if (e.raster)
+         {
+            stats.bytes -= e.bytes;
+            --stats.rasters;
+            report(stats.bytes + e.bytes);
+            e.raster.reset();
+            e.bytes = 0;
+         }
+      }
+
+      // Drops the rasters of the least recently drawn entries until the
+      // rasters fit in max_bytes. Their entries are kept, counting frames
+      // again from the start, so they are not rasterized again right away.
+      // Entries without a raster are only dropped once they are stale (see
+      // raster_cache::next_frame), or past max_entries. The images are
+      // freed by the caller, outside the lock.
+      void cache_state::trim(std::size_t max_bytes, std::vector<image_ptr>& dropped)
+      {
+         for (auto i = lru.rbegin(); stats.bytes > max_bytes && i != lru.rend(); ++i)
+         {
+            auto& e = entries.find(*i)->second;
+            if (e.raster)
+            {
+               dropped.push_back(e.raster);
+               drop_raster(e);
+               e.frames = 0;
+               ++stats.evictions;
+            }
+         }
+
+         while (entries.size() > max_entries)
+         {
+            auto i = entries.find(lru.back());
+            if (i->second.raster)
+            {
+               dropped.push_back(i->second.raster);
+               drop_raster(i->second);
+               ++stats.evictions;
+            }
+            entries.erase(i);
+            lru.pop_back();
+         }
+         stats.entries = entries.size();
+      }
+
+      // Over the image memory budget
+      void cache_state::evict(std::size_t bytes)
+      {
+         std::vector<image_ptr> dropped;
+         std::lock_guard<std::mutex> lock{mutex};
+         trim(stats.bytes > bytes? stats.bytes - bytes : 0, dropped);
+      }
+
+      cache_state& cache()
+      {
+         static cache_state state;
+         return state;
+      }
+
+      bool same(point a, point b)
+      {
+         return a.x == b.x && a.y == b.y;
+      }
+
+      bool same(rect const& a, rect const& b)
+      {
+         return a.left == b.left && a.top == b.top
+            && a.right == b.right && a.bottom == b.bottom;
+      }
+   }
+
+   void canvas::cached(std::size_t key, rect const& bounds, draw_function const& draw_fn)
+   {
+      auto draw_directly =
+         [&]
+         {
+            auto state = new_state();
+            clip(path{bounds});
+            draw_fn(*this);
+         };
+
+      // Rasters are only blitted 1:1, so the transform may only scale
+      // and translate (Quartz flips y with a negative scale)
+      auto xf = transform();
+      point scale{float(std::abs(xf.a)), float(std::abs(xf.d))};
+      extent size{
+         std::ceil(bounds.width() * scale.x)
+       , std::ceil(bounds.height() * scale.y)
+      };
+      auto& c = cache();
+      if (xf.b != 0 || xf.c != 0 || size.x <= 0 || size.y <= 0)
+      {
+         {
+            std::lock_guard<std::mutex> lock{c.mutex};
+            ++c.stats.misses;
+         }
+         draw_directly();
+         return;
+      }
+
+      image_ptr raster;
+      bool rasterize = false;
+      std::vector<image_ptr> dropped;
+      {
+         std::lock_guard<std::mutex> lock{c.mutex};
+         auto [i, added] = c.entries.try_emplace(key);
+         auto& e = i->second;
+         if (added)
+         {
+            c.lru.push_front(key);
+            e.lru = c.lru.begin();
+            e.bounds = bounds;
+            e.scale = scale;
+            c.trim(c.stats.max_bytes, dropped);
+         }
+         else
+         {
+            c.touch(e);
+         }
+
+         if (!same(e.bounds, bounds) || !same(e.scale, scale))
+         {
+            c.drop_raster(e);
+            e.bounds = bounds;
+            e.scale = scale;
+            e.frames = 0;
+            e.last_frame = 0;
+         }
+         c.count_frame(e);
+
+         if (e.raster)
+         {
+            raster = e.raster;
+            ++c.stats.hits;
+         }
+         else
+         {
+            ++c.stats.misses;
+            rasterize = e.frames >= c.min_frames
+               && std::size_t(size.x * size.y * 4) <= c.stats.max_bytes;
+         }
+      }
+
+      if (rasterize)
+      {
+         raster = std::make_shared<image>(detail::rasterize(size,
+            [&](canvas& cnv)
+            {
+               cnv.scale(scale.x, scale.y);
+               cnv.translate(-bounds.left, -bounds.top);
+               cnv.clip(path{bounds});
+               draw_fn(cnv);
+            }
+         ));
+
+         {
+            std::lock_guard<std::mutex> lock{c.mutex};
+            auto i = c.entries.find(key);
+            if (i != c.entries.end() && !i->second.raster
+               && same(i->second.bounds, bounds) && same(i->second.scale, scale))
+            {
+               c.add_raster(i->second, raster, std::size_t(size.x * size.y * 4));
+               c.trim(c.stats.max_bytes, dropped);
+            }
+         }
+         detail::enforce_image_memory_budget();
+      }
+
+      if (raster)
+      {
+         // One raster pixel per device pixel
+         auto state = new_state();
+         image_sampling(nearest);
+         draw(*raster, rect{
+            bounds.left, bounds.top
+          , bounds.left + size.x / scale.x, bounds.top + size.y / scale.y
+         });
+      }
+      else
+      {
+         draw_directly();
+      }
+   }
+
+   namespace raster_cache
+   {
+      std::size_t max_bytes()
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         return c.stats.max_bytes;
+      }
+
+      void max_bytes(std::size_t bytes)
+      {
+         std::vector<image_ptr> dropped;
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         c.stats.max_bytes = bytes;
+         c.trim(bytes, dropped);
+      }
+
+      int min_frames()
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         return c.min_frames;
+      }
+
+      void min_frames(int frames)
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         c.min_frames = frames;
+      }
+
+      void next_frame()
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         ++c.frame;
+
+         // Entries without a raster that were not drawn in the frame that
+         // just ended have lost their count: they are stale
+         for (auto i = c.entries.begin(); i != c.entries.end();)
+         {
+            auto& e = i->second;
+            if (!e.raster && e.last_frame + 1 < c.frame)
+            {
+               c.lru.erase(e.lru);
+               i = c.entries.erase(i);
+            }
+            else
+            {
+               ++i;
+            }
+         }
+         c.stats.entries = c.entries.size();
+      }
+
+      void invalidate(std::size_t key)
+      {
+         image_ptr dropped;
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         auto i = c.entries.find(key);
+         if (i != c.entries.end())
+         {
+            dropped = i->second.raster;
+            c.drop_raster(i->second);
+            c.lru.erase(i->second.lru);
+            c.entries.erase(i);
+            c.stats.entries = c.entries.size();
+         }
+      }
+
+      void clear()
+      {
+         std::unordered_map<std::size_t, entry> dropped;
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         dropped.swap(c.entries);
+         c.lru.clear();
+         auto from = c.stats.bytes;
+         c.stats.entries = 0;
+         c.stats.rasters = 0;
+         c.stats.bytes = 0;
+         c.report(from);
+      }
+
+      raster_cache_stats stats()
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         return c.stats;
+      }
+   }
+}
@@ -0,0 +1,433 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/region.hpp>
+#include <algorithm>
+#include <limits>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      struct span
+      {
+         float left;
+         float right;
+
+         bool operator==(span const& other) const
+         {
+            return left == other.left && right == other.right;
+         }
+      };
+
+      using span_vector = std::vector<span>;
+
+      struct band
+      {
+         float       top;
+         float       bottom;
+         span_vector spans;
+      };
+
+      using band_vector = std::vector<band>;
+      using rect_iterator = std::vector<rect>::const_iterator;
+
+      // Returns the end of the band that starts at `first`
+      rect_iterator band_end(rect_iterator first, rect_iterator last)
+      {
+         auto top = first->top;
+         return std::find_if(first, last, [top](rect const& r) { return r.top != top; });
+      }
+
+      void get_spans(rect_iterator first, rect_iterator last, span_vector& spans)
+      {
+         spans.clear();
+         for (auto i = first; i != last; ++i)
+            spans.push_back({i->left, i->right});
+      }
+
+      // Given two sorted, disjoint span lists, compute the spans where
+      // op(in_a, in_b) is true. Touching output spans are merged.
+      template <typename Op>
+      void combine_spans(
+         span_vector const& a, span_vector const& b
+       , Op op, span_vector& out
+      )
+      {
+         out.clear();
+         std::vector<float> xs;
+         xs.reserve((a.size() + b.size()) * 2);
+         for (auto const& s : a)
+         {
+            xs.push_back(s.left);
+            xs.push_back(s.right);
+         }
+         auto mid = xs.size();
+         for (auto const& s : b)
+         {
+            xs.push_back(s.left);
+            xs.push_back(s.right);
+         }
+         std::inplace_merge(xs.begin(), xs.begin() + mid, xs.end());
+         xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+
+         std::size_t ia = 0, ib = 0;
+         for (std::size_t k = 0; k + 1 < xs.size(); ++k)
+         {
+            auto x = xs[k];
+            while (ia < a.size() && a[ia].right <= x)
+               ++ia;
+            while (ib < b.size() && b[ib].right <= x)
+               ++ib;
+            bool in_a = ia < a.size() && a[ia].left <= x;
+            bool in_b = ib < b.size() && b[ib].left <= x;
+            if (op(in_a, in_b))
+            {
+               if (!out.empty() && out.back().right == x)
+                  out.back().right = xs[k+1];
+               else
+                  out.push_back({x, xs[k+1]});
+            }
+         }
+      }
+
+      float spans_width(span_vector const& spans)
+      {
+         float w = 0;
+         for (auto const& s : spans)
+            w += s.right - s.left;
+         return w;
+      }
+
+      band_vector get_bands(std::vector<rect> const& rects)
+      {
+         band_vector bands;
+         for (auto i = rects.begin(); i != rects.end();)
+         {
+            auto last = band_end(i, rects.end());
+            band b{i->top, i->bottom, {}};
+            get_spans(i, last, b.spans);
+            bands.push_back(std::move(b));
+            i = last;
+         }
+         return bands;
+      }
+
+      void set_bands(std::vector<rect>& rects, band_vector const& bands)
+      {
+         rects.clear();
+         for (auto const& b : bands)
+            for (auto const& s : b.spans)
+               rects.push_back({s.left, b.top, s.right, b.bottom});
+      }
+   }
+
+   region::region(rect const& r)
+   {
+      if (is_valid(r) && !r.is_empty())
+         _rects.push_back(r);
+   }
+
+   region::region(std::initializer_list<rect> rects)
+   {
+      for (auto const& r : rects)
+         *this |= region(r);
+   }
+
+   rect region::bounds() const
+   {
+      if (_rects.empty())
+         return {};
+
+      rect r = _rects.front();
+      r.bottom = _rects.back().bottom;
+      for (auto const& i : _rects)
+      {
+         r.left = std::min(r.left, i.left);
+         r.right = std::max(r.right, i.right);
+      }
+      return r;
+   }
+
+   bool region::contains(point p) const
+   {
+      // Find the first band that ends below p.y (bottoms are sorted)
+      auto i = std::partition_point(_rects.begin(), _rects.end(),
+         [&](rect const& r) { return r.bottom <= p.y; });
+
+      if (i == _rects.end() || i->top > p.y)
+         return false;
+
+      for (auto last = band_end(i, _rects.end()); i != last; ++i)
+      {
+         if (p.x < i->left)
+            return false;
+         if (p.x < i->right)
+            return true;
+      }
+      return false;
+   }
+
+   bool region::contains(rect const& r) const
+   {
+      return (region(r) - *this).is_empty();
+   }
+
+   bool region::intersects(rect const& r) const
+   {
+      if (!is_valid(r) || r.is_empty())
+         return false;
+
+      auto i = std::partition_point(_rects.begin(), _rects.end(),
+         [&](rect const& ri) { return ri.bottom <= r.top; });
+
+      for (; i != _rects.end() && i->top < r.bottom; ++i)
+      {
+         if (i->left < r.right && r.left < i->right)
+            return true;
+      }
+      return false;
+   }
+
+   region& region::move(float dx, float dy)
+   {
+      for (auto& r : _rects)
+         r = r.move(dx, dy);
+      return *this;
+   }
+
+   region region::combine(region const& a, region const& b, op_enum op)
+   {
+      // Quick outs
+      switch (op)
+      {
+         case op_union:
+         case op_xor:
+            if (a.is_empty())
+               return b;
+            if (b.is_empty())
+               return a;
+            break;
+         case op_intersect:
+            if (a.is_empty() || b.is_empty())
+               return {};
+            break;
+         case op_difference:
+            if (a.is_empty() || b.is_empty())
+               return a;
+            break;
+      }
+
+      auto span_op = [op](bool in_a, bool in_b)
+      {
+         switch (op)
+         {
+            case op_union:       return in_a || in_b;
+            case op_intersect:   return in_a && in_b;
+            case op_difference:  return in_a && !in_b;
+            case op_xor:         return in_a != in_b;
+         }
+         return false;
+      };
+
+      // Collect all the band edges of both regions. Between two consecutive
+      // edges, each region has at most one band, so the result is computed
+      // one horizontal slice at a time. coalesce() merges the slices back.
+      std::vector<float> ys;
+      for (auto const* rgn : {&a, &b})
+      {
+         for (auto i = rgn->_rects.begin(); i != rgn->_rects.end(); i = band_end(i, rgn->_rects.end()))
+         {
+            ys.push_back(i->top);
+            ys.push_back(i->bottom);
+         }
+      }
+      std::sort(ys.begin(), ys.end());
+      ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+      region result;
+      span_vector spans_a, spans_b, spans;
+      auto ia = a._rects.begin(), ib = b._rects.begin();
+
+      auto get_band_spans =
+         [](rect_iterator& i, rect_iterator last, float y, span_vector& spans_)
+         {
+            while (i != last && i->bottom <= y)
+               i = band_end(i, last);
+            if (i != last && i->top <= y)
+               get_spans(i, band_end(i, last), spans_);
+            else
+               spans_.clear();
+         };
+
+      for (std::size_t k = 0; k + 1 < ys.size(); ++k)
+      {
+         auto y = ys[k];
+         get_band_spans(ia, a._rects.end(), y, spans_a);
+         get_band_spans(ib, b._rects.end(), y, spans_b);
+         combine_spans(spans_a, spans_b, span_op, spans);
+         for (auto const& s : spans)
+            result._rects.push_back({s.left, y, s.right, ys[k+1]});
+      }
+
+      result.coalesce();
+      return result;
+   }
+
+   void region::coalesce()
+   {
+      // Merge vertically adjacent bands having identical spans
+      std::vector<rect> rects;
+      rects.reserve(_rects.size());
+
+      auto prev_first = std::size_t(0);
+      auto prev_last = std::size_t(0);
+
+      for (auto i = _rects.cbegin(); i != _rects.cend();)
+      {
+         auto last = band_end(i, _rects.cend());
+         auto n = std::size_t(last - i);
+
+         bool merge = prev_last != prev_first
+            && (prev_last - prev_first) == n
+            && rects[prev_first].bottom == i->top
+            && std::equal(i, last, rects.begin() + prev_first,
+               [](rect const& a, rect const& b)
+               {
+                  return a.left == b.left && a.right == b.right;
+               });
+
+         if (merge)
+         {
+            for (auto j = prev_first; j != prev_last; ++j)
+               rects[j].bottom = i->bottom;
+         }
+         else
+         {
+            prev_first = rects.size();
+            rects.insert(rects.end(), i, last);
+            prev_last = rects.size();
+         }
+         i = last;
+      }
+      _rects.swap(rects);
+   }
+
+   region& region::simplify(std::size_t max_rects)
+   {
+      max_rects = std::max<std::size_t>(max_rects, 1);
+      auto bands = get_bands(_rects);
+      auto count = _rects.size();
+      span_vector merged;
+
+      // Merge band i with the band below it if they touch and have the
+      // same spans
+      auto coalesce_band =
+         [&](std::size_t i)
+         {
+            if (i + 1 < bands.size()
+               && bands[i].bottom == bands[i+1].top
+               && bands[i].spans == bands[i+1].spans)
+            {
+               count -= bands[i].spans.size();
+               bands[i].bottom = bands[i+1].bottom;
+               bands.erase(bands.begin() + i + 1);
+            }
+         };
+
+      while (count > max_rects)
+      {
+         // Find the cheapest (least added area per rectangle removed) of:
+         //    1. Closing a gap between two adjacent spans within a band.
+         //    2. Merging two consecutive bands into one.
+         constexpr auto inf = std::numeric_limits<float>::infinity();
+         float best_cost = inf;
+         float best_no_gain_cost = inf;
+         std::size_t best_band = 0, best_span = 0;
+         bool best_is_merge = false;
+         std::size_t no_gain_band = 0;
+
+         for (std::size_t i = 0; i != bands.size(); ++i)
+         {
+            auto const& b = bands[i];
+            auto height = b.bottom - b.top;
+            for (std::size_t j = 0; j + 1 < b.spans.size(); ++j)
+            {
+               auto cost = (b.spans[j+1].left - b.spans[j].right) * height;
+               if (cost < best_cost)
+               {
+                  best_cost = cost;
+                  best_band = i;
+                  best_span = j;
+                  best_is_merge = false;
+               }
+            }
+
+            if (i + 1 < bands.size())
+            {
+               auto const& next = bands[i+1];
+               combine_spans(b.spans, next.spans,
+                  [](bool in_a, bool in_b) { return in_a || in_b; }, merged);
+               auto added =
+                  spans_width(merged) * (next.bottom - b.top)
+                  - spans_width(b.spans) * height
+                  - spans_width(next.spans) * (next.bottom - next.top)
+                  ;
+               auto gain = b.spans.size() + next.spans.size() - merged.size();
+               if (gain == 0)
+               {
+                  if (added < best_no_gain_cost)
+                  {
+                     best_no_gain_cost = added;
+                     no_gain_band = i;
+                  }
+               }
+               else if (added / gain < best_cost)
+               {
+                  best_cost = added / gain;
+                  best_band = i;
+                  best_is_merge = true;
+               }
+            }
+         }
+
+         if (best_cost == inf)
+         {
+            // Every band has a single span and no two bands can be merged
+            // without keeping both spans. Merge the cheapest pair anyway. The
+            // merged band will have a gap we can close on the next round.
+            best_band = no_gain_band;
+            best_is_merge = true;
+         }
+
+         if (best_is_merge)
+         {
+            auto& b = bands[best_band];
+            auto& next = bands[best_band+1];
+            combine_spans(b.spans, next.spans,
+               [](bool in_a, bool in_b) { return in_a || in_b; }, merged);
+            count -= b.spans.size() + next.spans.size() - merged.size();
+            b.bottom = next.bottom;
+            b.spans = merged;
+            bands.erase(bands.begin() + best_band + 1);
+         }
+         else
+         {
+            auto& spans = bands[best_band].spans;
+            spans[best_span].right = spans[best_span+1].right;
+            spans.erase(spans.begin() + best_span + 1);
+            --count;
+         }
+
+         coalesce_band(best_band);
+         if (best_band > 0)
+            coalesce_band(best_band-1);
+      }
+
+      set_bands(_rects, bands);
+      coalesce();
+      return *this;
+   }
+}
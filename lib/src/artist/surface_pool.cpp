@@ -0,0 +1,269 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/surface_pool.hpp>
+#include <artist/image_memory.hpp>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      constexpr std::size_t min_bucket = 4096;
+
+      // Rounds up to a quarter of the highest power of two, e.g. sizes in
+      // (1M, 1.25M] all go to the 1.25M bucket.
+      std::size_t bucket_size(std::size_t bytes)
+      {
+         if (bytes <= min_bucket)
+            return min_bucket;
+         std::size_t p = min_bucket;
+         while (p <= bytes / 2)
+            p *= 2;
+         auto step = p / 4;
+         return (bytes + step - 1) / step * step;
+      }
+
+      /////////////////////////////////////////////////////////////////////////
+      // The idle buffers, by size bucket, so a borrow only looks at the
+      // buffers of its own size. Each is stamped when it is returned; to
+      // stay under max_bytes, the oldest is freed first, found among the
+      // oldest of each bucket (there are few buckets: one per distinct
+      // surface size in use).
+      //
+      // The idle bytes are reported to image_memory, and count against its
+      // budget; over the budget, the pool's evictor frees the oldest.
+      /////////////////////////////////////////////////////////////////////////
+      struct pool_state
+      {
+         struct block
+         {
+            std::uint64_t                    stamp;
+            std::unique_ptr<std::uint8_t[]>  data;
+         };
+
+         using bucket = std::list<block>;    // Most recently returned first
+         using bucket_map = std::unordered_map<std::size_t, bucket>;
+
+                              pool_state();
+                              ~pool_state();
+
+         void                 give_back(
+                                 std::size_t size, std::unique_ptr<std::uint8_t[]> data
+                               , bucket& freed);
+         std::uint8_t*        take(std::size_t size);
+         void                 trim(std::size_t max_bytes, bucket& freed);
+         void                 evict(std::size_t bytes);
+         void                 report(std::size_t from);
+
+         std::mutex           mutex;
+         bucket_map           idle;
+         std::uint64_t        clock = 0;
+         surface_pool_stats   stats;
+         std::size_t          evictor;
+      };
+
+      pool_state::pool_state()
+      {
+         stats.max_bytes = surface_pool::default_max_bytes;
+         evictor = add_image_evictor([this](std::size_t bytes) { evict(bytes); });
+      }
+
+      pool_state::~pool_state()
+      {
+         remove_image_evictor(evictor);
+      }
+
+      // Keeps image_memory's count of the idle bytes in step. Called with
+      // the lock held, after bytes_pooled changed from `from`.
+      void pool_state::report(std::size_t from)
+      {
+         image_memory_stats before, now;
+         before.surface_pool_bytes = from;
+         now.surface_pool_bytes = stats.bytes_pooled;
+         detail::update_cache_memory(before, now);
+      }
+
+      void pool_state::give_back(
+         std::size_t size, std::unique_ptr<std::uint8_t[]> data, bucket& freed)
+      {
+         idle[size].push_front(block{++clock, std::move(data)});
+         stats.bytes_pooled += size;
+         report(stats.bytes_pooled - size);
+         trim(stats.max_bytes, freed);
+      }
+
+      std::uint8_t* pool_state::take(std::size_t size)
+      {
+         auto i = idle.find(size);
+         if (i == idle.end())
+            return nullptr;
+         auto data = i->second.front().data.release();
+         i->second.pop_front();
+         if (i->second.empty())
+            idle.erase(i);
+         stats.bytes_pooled -= size;
+         report(stats.bytes_pooled + size);
+         return data;
+      }
+
+      // Drops the oldest idle buffers until bytes_pooled is within
+      // max_bytes. They are moved to freed, for the caller to free outside
+      // the lock.
+      void pool_state::trim(std::size_t max_bytes, bucket& freed)
+      {
+         auto from = stats.bytes_pooled;
+         while (stats.bytes_pooled > max_bytes && !idle.empty())
+         {
+            auto oldest = idle.begin();
+            for (auto i = idle.begin(); i != idle.end(); ++i)
+            {
+               if (i->second.back().stamp < oldest->second.back().stamp)
+                  oldest = i;
+            }
+            stats.bytes_pooled -= oldest->first;
+            ++stats.evictions;
+            freed.splice(freed.end(), oldest->second, std::prev(oldest->second.end()));
+            if (oldest->second.empty())
+               idle.erase(oldest);
+         }
+         if (stats.bytes_pooled != from)
+            report(from);
+      }
+
+      // Over the image memory budget
+      void pool_state::evict(std::size_t bytes)
+      {
+         bucket freed;
+         std::lock_guard<std::mutex> lock{mutex};
+         trim(stats.bytes_pooled > bytes? stats.bytes_pooled - bytes : 0, freed);
+      }
+
+      pool_state& pool()
+      {
+         static pool_state state;
+         return state;
+      }
+   }
+
+   class surface_pool_access
+   {
+   public:
+
+      static pooled_buffer make(std::uint8_t* data, std::size_t size)
+      {
+         return {data, size};
+      }
+
+      static void give_back(pooled_buffer& buf)
+      {
+         if (!buf._data)
+            return;
+
+         auto& p = pool();
+         std::unique_ptr<std::uint8_t[]> data{buf._data};
+         pool_state::bucket freed;     // Freed outside the lock
+         {
+            std::lock_guard<std::mutex> lock{p.mutex};
+            p.stats.bytes_in_use -= buf._size;
+            if (buf._size <= p.stats.max_bytes)
+               p.give_back(buf._size, std::move(data), freed);
+         }
+         buf._data = nullptr;
+         buf._size = 0;
+         detail::enforce_image_memory_budget();
+      }
+   };
+
+   pooled_buffer::~pooled_buffer()
+   {
+      surface_pool_access::give_back(*this);
+   }
+
+   pooled_buffer& pooled_buffer::operator=(pooled_buffer&& rhs) noexcept
+   {
+      if (this != &rhs)
+      {
+         surface_pool_access::give_back(*this);
+         std::swap(_data, rhs._data);
+         std::swap(_size, rhs._size);
+      }
+      return *this;
+   }
+
+   namespace surface_pool
+   {
+      pooled_buffer acquire(std::size_t bytes)
+      {
+         auto size = bucket_size(bytes);
+         auto& p = pool();
+         {
+            std::lock_guard<std::mutex> lock{p.mutex};
+            if (auto data = p.take(size))
+            {
+               p.stats.bytes_in_use += size;
+               ++p.stats.hits;
+               return surface_pool_access::make(data, size);
+            }
+            ++p.stats.misses;
+            p.stats.bytes_in_use += size;
+         }
+
+         // Allocate outside the lock
+         try
+         {
+            return surface_pool_access::make(new std::uint8_t[size], size);
+         }
+         catch (...)
+         {
+            std::lock_guard<std::mutex> lock{p.mutex};
+            p.stats.bytes_in_use -= size;
+            throw;
+         }
+      }
+
+      std::size_t max_bytes()
+      {
+         auto& p = pool();
+         std::lock_guard<std::mutex> lock{p.mutex};
+         return p.stats.max_bytes;
+      }
+
+      void max_bytes(std::size_t bytes)
+      {
+         pool_state::bucket freed;     // Freed outside the lock
+         auto& p = pool();
+         std::lock_guard<std::mutex> lock{p.mutex};
+         p.stats.max_bytes = bytes;
+         p.trim(bytes, freed);
+      }
+
+      surface_pool_stats stats()
+      {
+         auto& p = pool();
+         std::lock_guard<std::mutex> lock{p.mutex};
+         return p.stats;
+      }
+
+      void clear()
+      {
+         pool_state::bucket_map idle;
+         auto& p = pool();
+         {
+            std::lock_guard<std::mutex> lock{p.mutex};
+            idle.swap(p.idle);
+            auto from = p.stats.bytes_pooled;
+            p.stats.bytes_pooled = 0;
+            p.report(from);
+         }
+         // The buffers are freed here, outside the lock
+      }
+   }
+}
@@ -4,6 +4,7 @@
    Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
 =============================================================================*/
 #include <artist/path.hpp>
+#include <artist/detail/arc_to_curve.hpp>
 #include <cctype>
 #include <cstdlib>
 #include <cmath>
@@ -14,150 +15,6 @@ namespace cycfi::artist
 {
    namespace
    {
-      // Arc calculation code based on canvg (https://code.google.com/p/canvg/)
-      // Ported to C++ by Joel de Gzman from C port by Mikko Mononen:
-      // https://github.com/memononen/nanosvg/blob/master/src/nanosvg.h
-      // Copyright (c) 2013-14 Mikko Mononen memon@inside.org
-
-      float sqr(float x) { return x*x; }
-      float vmag(float x, float y) { return sqrtf(x*x + y*y); }
-
-      void xform_point(float& dx, float& dy, float x, float y, float* t)
-      {
-         dx = x*t[0] + y*t[2] + t[4];
-         dy = x*t[1] + y*t[3] + t[5];
-      }
-
-      void xform_vec(float& dx, float& dy, float x, float y, float* t)
-      {
-         dx = x*t[0] + y*t[2];
-         dy = x*t[1] + y*t[3];
-      }
-
-      float vecrat(float ux, float uy, float vx, float vy)
-      {
-         return (ux*vx + uy*vy) / (vmag(ux,uy) * vmag(vx,vy));
-      }
-
-      float vecang(float ux, float uy, float vx, float vy)
-      {
-         float r = vecrat(ux,uy, vx,vy);
-         if (r < -1.0f) r = -1.0f;
-         if (r > 1.0f) r = 1.0f;
-         return ((ux*vy < uy*vx) ? -1.0f : 1.0f) * acosf(r);
-      }
-
-      void arc_to_curve(
-         path& path_
-       , point& p, point radius, float rotx_
-       , bool large_arc, bool sweep, point end
-      )
-      {
-         // Ported from canvg (https://code.google.com/p/canvg/)
-
-         float rx    = fabsf(radius.x);         // x radius
-         float ry    = fabsf(radius.y);         // y radius
-         float rotx  = rotx_ / 180.0f * pi;	   // x rotation angle
-         bool  fa    = large_arc;	            // Large arc
-         bool  fs    = sweep;	                  // Sweep direction
-         float x1    = p.x;							// start point
-         float y1    = p.y;
-         float x2    = end.x;
-         float y2    = end.y;
-
-         float dx = x1 - x2;
-         float dy = y1 - y2;
-         float d = sqrtf(dx*dx + dy*dy);
-         if (d < 1e-6f || rx < 1e-6f || ry < 1e-6f)
-         {
-            // The arc degenerates to a line
-            path_.line_to(x2, y2);
-            p.x = x2;
-            p.y = y2;
-            return;
-         }
-
-         float sinrx = sinf(rotx);
-         float cosrx = cosf(rotx);
-
-         // Convert to center point parameterization.
-         // http://www.w3.org/TR/SVG11/implnote.html#ArcImplementationNotes
-         // 1) Compute x1', y1'
-         float x1p = cosrx * dx / 2.0f + sinrx * dy / 2.0f;
-         float y1p = -sinrx * dx / 2.0f + cosrx * dy / 2.0f;
-         d = sqr(x1p)/sqr(rx) + sqr(y1p)/sqr(ry);
-         if (d > 1)
-         {
-            d = sqrtf(d);
-            rx *= d;
-            ry *= d;
-         }
-         // 2) Compute cx', cy'
-         float s = 0.0f;
-         float sa = sqr(rx)*sqr(ry) - sqr(rx)*sqr(y1p) - sqr(ry)*sqr(x1p);
-         float sb = sqr(rx)*sqr(y1p) + sqr(ry)*sqr(x1p);
-         if (sa < 0.0f) sa = 0.0f;
-         if (sb > 0.0f)
-            s = sqrtf(sa / sb);
-         if (fa == fs)
-            s = -s;
-         float cxp = s * rx * y1p / ry;
-         float cyp = s * -ry * x1p / rx;
-
-         // 3) Compute cx,cy from cx',cy'
-         float cx = (x1 + x2)/2.0f + cosrx*cxp - sinrx*cyp;
-         float cy = (y1 + y2)/2.0f + sinrx*cxp + cosrx*cyp;
-
-         // 4) Calculate theta1, and delta theta.
-         float ux = (x1p - cxp) / rx;
-         float uy = (y1p - cyp) / ry;
-         float vx = (-x1p - cxp) / rx;
-         float vy = (-y1p - cyp) / ry;
-         float a1 = vecang(1.0f,0.0f, ux,uy);	// Initial angle
-         float da = vecang(ux,uy, vx,vy);		// Delta angle
-
-         // if (vecrat(ux,uy,vx,vy) <= -1.0f) da = pi;
-         // if (vecrat(ux,uy,vx,vy) >= 1.0f) da = 0;
-
-         if (fs == 0 && da > 0)
-            da -= 2 * pi;
-         else if (fs == 1 && da < 0)
-            da += 2 * pi;
-
-         // Approximate the arc using cubic spline segments.
-         float t[6] = {cosrx, sinrx, -sinrx, cosrx, cx, cy};
-
-         // Split arc into max 90 degree segments.
-         // The loop assumes an iteration per end point
-         // (including start and end), this +1.
-         int ndivs = int(fabsf(da) / (pi*0.5f) + 1.0f);
-         float hda = (da / (float)ndivs) / 2.0f;
-         float kappa = fabsf(4.0f / 3.0f * (1.0f - cosf(hda)) / sinf(hda));
-         if (da < 0.0f)
-            kappa = -kappa;
-
-         float px = 0, py = 0;
-         float ptanx = 0, ptany = 0;
-         for (int i = 0; i <= ndivs; i++)
-         {
-            float a = a1 + da * ((float)i/(float)ndivs);
-            dx = cosf(a);
-            dy = sinf(a);
-            float x, y;
-            xform_point(x, y, dx*rx, dy*ry, t); // position
-            float tanx, tany;
-            xform_vec(tanx, tany, -dy*rx * kappa, dx*ry * kappa, t); // tangent
-            if (i > 0)
-               path_.bezier_curve_to(px+ptanx, py+ptany, x-tanx, y-tany, x, y);
-            px = x;
-            py = y;
-            ptanx = tanx;
-            ptany = tany;
-         }
-         p.x = x2;
-         p.y = y2;
-      }
-
       void skip_to_next(char const*& s)
       {
          for (char c = *s; (c = *s) != 0; ++s)
@@ -314,7 +171,8 @@ namespace cycfi::artist
                coord(s, end.x, abs, p.x) &&
                coord(s, end.y, abs, p.y))
             {
-               arc_to_curve(_path, p, radius, rotx, large_arc, sweep, end);
+               detail::arc_to_curve<detail::runtime_math>(
+                  _path, p, radius, rotx, large_arc, sweep, end);
             }
          }
 
@@ -0,0 +1,250 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#include <artist/text_cache.hpp>
+#include <artist/image_memory.hpp>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cycfi::artist
+{
+   namespace
+   {
+      std::size_t hash_of(std::uint64_t font_id, std::string_view utf8)
+      {
+         return std::hash<std::string_view>{}(utf8) ^ font_id;
+      }
+
+      // The shaped text is the backend's own, of unknown size. It is
+      // estimated from the size of the text: its glyphs and their
+      // positions, plus the entry, its index and the backend's object.
+      constexpr std::size_t shaped_bytes_per_byte = 16;
+      constexpr std::size_t entry_overhead = 256;
+
+      std::size_t entry_bytes(std::string_view utf8)
+      {
+         return entry_overhead + utf8.size() * (1 + shaped_bytes_per_byte);
+      }
+
+      struct entry
+      {
+         std::uint64_t              font_id;
+         float                      size;
+         std::string                text;
+         detail::shaped_text_ptr    shaped;
+      };
+
+      using entry_list = std::list<entry>;
+
+      struct cache_state
+      {
+                              cache_state();
+                              ~cache_state();
+
+         entry_list::iterator find(
+                                 std::size_t hash, std::uint64_t font_id
+                               , float size, std::string_view utf8);
+         void                 add(
+                                 std::size_t hash, std::uint64_t font_id
+                               , float size, std::string_view utf8
+                               , detail::shaped_text_ptr shaped);
+         void                 trim(
+                                 std::size_t max_entries, std::size_t max_bytes
+                               , std::vector<detail::shaped_text_ptr>& dropped);
+         void                 evict(std::size_t bytes);
+         void                 report(std::size_t from);
+
+         std::mutex           mutex;
+         entry_list           lru;     // Most recently used first
+
+         // By hash, so that lookups need not copy the text
+         std::unordered_multimap<std::size_t, entry_list::iterator> index;
+         text_cache_stats     stats;
+         std::size_t          evictor;
+
+         // max_entries is not 0. Checked without the lock, so that text
+         // is shaped without touching the cache at all when it is off.
+         std::atomic<bool>    enabled{true};
+      };
+
+      cache_state::cache_state()
+      {
+         stats.max_entries = text_cache::default_max_entries;
+         evictor = add_image_evictor([this](std::size_t bytes) { evict(bytes); });
+      }
+
+      cache_state::~cache_state()
+      {
+         remove_image_evictor(evictor);
+      }
+
+      // Keeps image_memory's count of the cache's bytes in step. Called
+      // with the lock held, after stats.bytes changed from `from`.
+      void cache_state::report(std::size_t from)
+      {
+         image_memory_stats before, now;
+         before.text_cache_bytes = from;
+         now.text_cache_bytes = stats.bytes;
+         detail::update_cache_memory(before, now);
+      }
+
+      entry_list::iterator cache_state::find(
+         std::size_t hash, std::uint64_t font_id, float size, std::string_view utf8)
+      {
+         auto [first, last] = index.equal_range(hash);
+         for (auto i = first; i != last; ++i)
+         {
+            auto const& e = *i->second;
+            if (e.font_id == font_id && e.size == size && e.text == utf8)
+               return i->second;
+         }
+         return lru.end();
+      }
+
+      void cache_state::add(
+         std::size_t hash, std::uint64_t font_id, float size, std::string_view utf8
+       , detail::shaped_text_ptr shaped)
+      {
+         lru.push_front({font_id, size, std::string{utf8}, std::move(shaped)});
+         index.emplace(hash, lru.begin());
+         stats.bytes += entry_bytes(utf8);
+         stats.entries = lru.size();
+         report(stats.bytes - entry_bytes(utf8));
+      }
+
+      // Drops the least recently used entries until there are no more
+      // than max_entries, holding no more than max_bytes. The shaped text
+      // is freed by the caller, outside the lock.
+      void cache_state::trim(
+         std::size_t max_entries, std::size_t max_bytes
+       , std::vector<detail::shaped_text_ptr>& dropped)
+      {
+         auto from = stats.bytes;
+         while (!lru.empty() && (lru.size() > max_entries || stats.bytes > max_bytes))
+         {
+            auto& e = lru.back();
+            auto [first, last] = index.equal_range(hash_of(e.font_id, e.text));
+            for (auto i = first; i != last; ++i)
+            {
+               if (i->second == std::prev(lru.end()))
+               {
+                  index.erase(i);
+                  break;
+               }
+            }
+            stats.bytes -= entry_bytes(e.text);
+            dropped.push_back(std::move(e.shaped));
+            lru.pop_back();
+            ++stats.evictions;
+         }
+         stats.entries = lru.size();
+         if (stats.bytes != from)
+            report(from);
+      }
+
+      // Over the image memory budget
+      void cache_state::evict(std::size_t bytes)
+      {
+         std::vector<detail::shaped_text_ptr> dropped;
+         std::lock_guard<std::mutex> lock{mutex};
+         trim(stats.max_entries, stats.bytes > bytes? stats.bytes - bytes : 0, dropped);
+      }
+
+      cache_state& cache()
+      {
+         static cache_state state;
+         return state;
+      }
+   }
+
+   namespace detail
+   {
+      shaped_text_ptr find_shaped_text(
+         std::uint64_t font_id, float size, std::string_view utf8)
+      {
+         auto& c = cache();
+         if (utf8.size() > text_cache::max_text_size || !c.enabled)
+            return {};
+
+         auto hash = hash_of(font_id, utf8);
+         std::lock_guard<std::mutex> lock{c.mutex};
+         auto i = c.find(hash, font_id, size, utf8);
+         if (i == c.lru.end())
+         {
+            ++c.stats.misses;
+            return {};
+         }
+         ++c.stats.hits;
+         c.lru.splice(c.lru.begin(), c.lru, i);
+         return i->shaped;
+      }
+
+      void add_shaped_text(
+         std::uint64_t font_id, float size, std::string_view utf8
+       , shaped_text_ptr shaped)
+      {
+         auto& c = cache();
+         if (utf8.size() > text_cache::max_text_size || !c.enabled)
+            return;
+
+         std::vector<shaped_text_ptr> dropped;
+         auto hash = hash_of(font_id, utf8);
+         {
+            std::lock_guard<std::mutex> lock{c.mutex};
+            if (c.find(hash, font_id, size, utf8) != c.lru.end())
+               return;  // Another thread added it first
+            c.add(hash, font_id, size, utf8, std::move(shaped));
+            c.trim(c.stats.max_entries, std::size_t(-1), dropped);
+         }
+         enforce_image_memory_budget();
+      }
+   }
+
+   namespace text_cache
+   {
+      std::size_t max_entries()
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         return c.stats.max_entries;
+      }
+
+      void max_entries(std::size_t n)
+      {
+         std::vector<detail::shaped_text_ptr> dropped;
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         c.stats.max_entries = n;
+         c.enabled = n != 0;
+         c.trim(n, std::size_t(-1), dropped);
+      }
+
+      text_cache_stats stats()
+      {
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         return c.stats;
+      }
+
+      void clear()
+      {
+         entry_list dropped;
+         auto& c = cache();
+         std::lock_guard<std::mutex> lock{c.mutex};
+         dropped.swap(c.lru);
+         c.index.clear();
+         auto from = c.stats.bytes;
+         c.stats.entries = 0;
+         c.stats.bytes = 0;
+         c.report(from);
+      }
+   }
+}
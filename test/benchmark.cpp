@@ -0,0 +1,465 @@
+/*=============================================================================
+   Copyright (c) 2016-2023 Joel de Guzman
+
+   Distributed under the MIT License [ https://opensource.org/licenses/MIT ]
+=============================================================================*/
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <infra/catch.hpp>
+#include <artist/affine_transform.hpp>
+#include <artist/color.hpp>
+#include <artist/colormap.hpp>
+#include <artist/font.hpp>
+#include <artist/image_atlas.hpp>
+#include <artist/image_ops.hpp>
+#include <artist/surface_pool.hpp>
+#include <artist/text_cache.hpp>
+#include <artist/text_layout.hpp>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <thread>
+#include <algorithm>
+#include <vector>
+
+using namespace cycfi::artist;
+
+// Benchmarks are not part of the test suite. Run artist_benchmark manually
+// (Release build) to compare the optimized code paths against the plain
+// scalar code they replace.
+
+namespace
+{
+   // This is what affine_transform::apply(point p[], std::size_t n) used to
+   // be: a plain loop over the single point apply.
+   void scalar_apply(affine_transform const& mat, point p[], std::size_t n)
+   {
+      for (std::size_t i = 0; i != n; ++i)
+         p[i] = mat.apply(p[i]);
+   }
+
+   // Packing colors by hand, the way users had to before to_rgba8
+   void scalar_to_rgba8(color const src[], std::uint32_t dest[], std::size_t n)
+   {
+      auto to_byte = [](float v)
+      {
+         return std::uint32_t(std::clamp(v, 0.0f, 1.0f) * 255.0f + 0.5f);
+      };
+
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         dest[i] =
+            to_byte(src[i].red)
+            | (to_byte(src[i].green) << 8)
+            | (to_byte(src[i].blue) << 16)
+            | (to_byte(src[i].alpha) << 24)
+            ;
+      }
+   }
+
+   // A plain separable gaussian blur, one channel at a time, with no SIMD
+   // and no threads: the reference for image_ops::gaussian_blur.
+   void scalar_gaussian_blur(std::uint32_t* pixels, int w, int h, float sigma)
+   {
+      auto radius = int(std::ceil(sigma * 3));
+      std::vector<float> kernel(2 * radius + 1);
+      float total = 0.0f;
+      for (int i = -radius; i <= radius; ++i)
+         total += kernel[i + radius] = std::exp(-(i * i) / (2 * sigma * sigma));
+      for (auto& k : kernel)
+         k /= total;
+
+      auto blur = [&](std::uint32_t const* src, std::uint32_t* dest, int n, int stride)
+      {
+         for (int i = 0; i != n; ++i)
+         {
+            std::uint32_t p = 0;
+            for (int c = 0; c != 32; c += 8)
+            {
+               float acc = 0.0f;
+               for (int j = -radius; j <= radius; ++j)
+               {
+                  auto k = std::clamp(i + j, 0, n - 1);
+                  acc += kernel[j + radius] * ((src[k * stride] >> c) & 0xff);
+               }
+               p |= std::uint32_t(std::clamp(acc + 0.5f, 0.0f, 255.0f)) << c;
+            }
+            dest[i * stride] = p;
+         }
+      };
+
+      std::vector<std::uint32_t> tmp(std::size_t(w) * h);
+      for (int y = 0; y != h; ++y)
+         blur(pixels + y * w, tmp.data() + y * w, w, 1);
+      for (int x = 0; x != w; ++x)
+         blur(tmp.data() + x, pixels + x, h, w);
+   }
+}
+
+TEST_CASE("Batch Transform")
+{
+   constexpr std::size_t n = 1000000;
+   auto mat = affine_identity.translate(10, 20).rotate(0.5).scale(1.5);
+   auto mat_f = affine_transform_f(mat);
+
+   std::vector<point> pts(n);
+   std::vector<float> x(n), y(n);
+   for (std::size_t i = 0; i != n; ++i)
+   {
+      pts[i] = {float(i % 1000), float(i / 1000)};
+      x[i] = pts[i].x;
+      y[i] = pts[i].y;
+   }
+
+   BENCHMARK("scalar loop")
+   {
+      scalar_apply(mat, pts.data(), n);
+      return pts[0];
+   };
+
+   BENCHMARK("transform_points (double)")
+   {
+      transform_points(mat, pts.data(), pts.data(), n);
+      return pts[0];
+   };
+
+   BENCHMARK("transform_points (float)")
+   {
+      transform_points(mat_f, pts.data(), pts.data(), n);
+      return pts[0];
+   };
+
+   BENCHMARK("transform_points SoA (float)")
+   {
+      transform_points(mat_f, x.data(), y.data(), x.data(), y.data(), n);
+      return x[0];
+   };
+}
+
+TEST_CASE("Batch Color Conversion")
+{
+   constexpr std::size_t n = 1000000;
+   std::vector<color> colors(n);
+   std::vector<std::uint32_t> pixels(n);
+   std::vector<float> h(n), s(n), l(n);
+   for (std::size_t i = 0; i != n; ++i)
+   {
+      h[i] = (i % 360);
+      s[i] = (i % 100) / 100.0f;
+      l[i] = (i % 50) / 50.0f;
+      colors[i] = hsl(h[i], s[i], l[i]);
+   }
+
+   BENCHMARK("scalar to_rgba8")
+   {
+      scalar_to_rgba8(colors.data(), pixels.data(), n);
+      return pixels[0];
+   };
+
+   BENCHMARK("to_rgba8")
+   {
+      to_rgba8(colors.data(), pixels.data(), n);
+      return pixels[0];
+   };
+
+   BENCHMARK("from_rgba8")
+   {
+      from_rgba8(pixels.data(), colors.data(), n);
+      return colors[0];
+   };
+
+   BENCHMARK("premultiply (rgba8)")
+   {
+      premultiply(pixels.data(), n);
+      return pixels[0];
+   };
+
+   BENCHMARK("scalar hsl")
+   {
+      for (std::size_t i = 0; i != n; ++i)
+         colors[i] = hsl(h[i], s[i], l[i]);
+      return colors[0];
+   };
+
+   BENCHMARK("batch hsl")
+   {
+      hsl(h.data(), s.data(), l.data(), colors.data(), n);
+      return colors[0];
+   };
+
+   // Round trip, so repeated runs do not drift towards denormals
+   BENCHMARK("srgb_to_linear + linear_to_srgb")
+   {
+      srgb_to_linear(colors.data(), n);
+      linear_to_srgb(colors.data(), n);
+      return colors[0];
+   };
+}
+
+TEST_CASE("Colormap")
+{
+   // A 4K heatmap
+   constexpr std::size_t n = 3840 * 2160;
+   std::vector<float> values(n);
+   std::vector<std::uint32_t> pixels(n);
+   for (std::size_t i = 0; i != n; ++i)
+      values[i] = (i % 1000) / 10.0f;
+
+   auto cmap = colormaps::viridis(4096);
+   std::vector<color> lut(cmap.size());
+   from_rgba8(cmap.data(), lut.data(), lut.size());
+
+   // Looking up each value and packing it, one at a time
+   BENCHMARK("scalar lookup")
+   {
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         auto x = std::clamp(values[i] / 100.0f, 0.0f, 1.0f);
+         auto c = lut[std::size_t(x * (lut.size() - 1) + 0.5f)];
+         scalar_to_rgba8(&c, &pixels[i], 1);
+      }
+      return pixels[0];
+   };
+
+   BENCHMARK("colormap::apply")
+   {
+      cmap.apply(values.data(), n, pixels.data(), 0.0f, 100.0f);
+      return pixels[0];
+   };
+}
+
+TEST_CASE("Sprite Atlas")
+{
+   // A 512 x 512 sheet of 32 x 32 sprites
+   std::vector<std::uint32_t> pixels(512 * 512);
+   for (std::size_t i = 0; i != pixels.size(); ++i)
+      pixels[i] = 0xff000000 | std::uint32_t(i * 2654435761u);
+   auto sheet = std::make_shared<image>(
+      make_image<pixel_format::rgba32>(pixels.data(), {512, 512}));
+   image_atlas atlas{sheet, {32, 32}};
+
+   constexpr std::size_t n = 5000;
+   for (std::size_t i = 0; i != n; ++i)
+      atlas.add(i % atlas.num_sprites(), point{float(i % 100) * 8, float(i / 100) * 8});
+
+   image pm{{800, 400}};
+   offscreen_image ctx{pm};
+   canvas cnv{ctx.context()};
+
+   // One draw per sprite
+   BENCHMARK("draw per sprite")
+   {
+      for (std::size_t i = 0; i != n; ++i)
+      {
+         auto const& src = atlas.src()[i];
+         auto const& xf = atlas.transforms()[i];
+         cnv.draw(*sheet, src, rect{float(xf.tx), float(xf.ty), src.size()});
+      }
+   };
+
+   BENCHMARK("draw_atlas")
+   {
+      cnv.draw_atlas(atlas);
+   };
+}
+
+TEST_CASE("Image Ops")
+{
+   // A 1080p frame
+   constexpr int w = 1920, h = 1080;
+   std::vector<std::uint32_t> pixels(w * h);
+   for (std::size_t i = 0; i != pixels.size(); ++i)
+      pixels[i] = 0xff000000 | std::uint32_t(i * 2654435761u);
+   auto img = make_image<pixel_format::rgba32_premul>(pixels.data(), {w, h}, 0);
+
+   BENCHMARK("scalar gaussian blur")
+   {
+      scalar_gaussian_blur(pixels.data(), w, h, 4.0f);
+      return pixels[0];
+   };
+
+   BENCHMARK("image_ops::gaussian_blur")
+   {
+      image_ops::gaussian_blur(img, 4.0f);
+      return pixels[0];
+   };
+
+   // Sharpen
+   float const kernel[25] =
+   {
+       0,  0, -1,  0,  0
+    ,  0, -1, -2, -1,  0
+    , -1, -2, 17, -2, -1
+    ,  0, -1, -2, -1,  0
+    ,  0,  0, -1,  0,  0
+   };
+
+   BENCHMARK("image_ops::convolve (5 x 5)")
+   {
+      image_ops::convolve(img, kernel, 5);
+      return pixels[0];
+   };
+
+   BENCHMARK("image_ops::resize (lanczos3, half size)")
+   {
+      return image_ops::resize(img, {w / 2, h / 2}).bitmap_size();
+   };
+}
+
+TEST_CASE("Font Lookup Scaling")
+{
+   // Every thread makes the same number of fonts, from a few descriptions
+   // that are resolved after the first round. Flat times mean lookups
+   // scale: they do not wait for each other.
+   constexpr int fonts_per_thread = 2000;
+   font_descr const descrs[] =
+   {
+      font_descr{"Open Sans", 12}
+    , font_descr{"Open Sans", 14}.bold()
+    , font_descr{"Roboto, Open Sans", 16}.italic()
+    , font_descr{"", 10}
+   };
+   for (auto const& d : descrs)
+      font{d};
+
+   for (int n : {1, 2, 4, 8, 16, 32})
+   {
+      BENCHMARK(std::to_string(n) + " threads")
+      {
+         std::vector<std::thread> threads;
+         for (int t = 0; t != n; ++t)
+         {
+            threads.emplace_back(
+               [&descrs]
+               {
+                  for (int i = 0; i != fonts_per_thread; ++i)
+                     font{descrs[i % std::size(descrs)]};
+               });
+         }
+         for (auto& t : threads)
+            t.join();
+      };
+   }
+}
+
+TEST_CASE("Surface Pool")
+{
+   // A 1080p frame, written once, as a rasterizer would
+   constexpr std::size_t bytes = 1920 * 1080 * 4;
+
+   BENCHMARK("new buffer")
+   {
+      std::unique_ptr<std::uint8_t[]> buf{new std::uint8_t[bytes]};
+      std::fill_n(buf.get(), bytes, 0);
+      return buf[bytes - 1];
+   };
+
+   BENCHMARK("surface_pool::acquire")
+   {
+      auto buf = surface_pool::acquire(bytes);
+      std::fill_n(buf.data(), bytes, 0);
+      return buf.data()[bytes - 1];
+   };
+}
+
+TEST_CASE("Text Cache")
+{
+   // A table of 1000 cells, with a few distinct labels
+   char const* labels[] = {"Open", "Closed", "Pending", "12.50", "Yes", "No"};
+   image pm{{800, 600}};
+   offscreen_image ctx{pm};
+   canvas cnv{ctx.context()};
+   cnv.font(font_descr{"Open Sans", 12});
+   cnv.text_align(canvas::right);
+
+   auto draw_table = [&]
+   {
+      for (int i = 0; i != 1000; ++i)
+         cnv.fill_text(labels[i % std::size(labels)], float(i % 10) * 80 + 70, float(i / 10) * 6);
+   };
+
+   // With the cache off, text is shaped on every draw, without a lookup
+   auto max = text_cache::max_entries();
+   text_cache::max_entries(0);
+   BENCHMARK("fill_text (uncached)")
+   {
+      draw_table();
+   };
+
+   text_cache::max_entries(max);
+   BENCHMARK("fill_text (text_cache)")
+   {
+      draw_table();
+   };
+}
+
+TEST_CASE("Text Layout Creation")
+{
+   // Many short paragraphs in one typeface: the HarfBuzz font is made
+   // once, not once per paragraph
+   BENCHMARK("1000 paragraphs")
+   {
+      std::size_t lines = 0;
+      for (int i = 0; i != 1000; ++i)
+      {
+         text_layout layout{font_descr{"Open Sans", 12}, "A short paragraph of text."};
+         layout.flow(200);
+         lines += layout.num_lines();
+      }
+      return lines;
+   };
+}
+
+TEST_CASE("Text Layout Editing")
+{
+   // Typing into a long document: an edit shapes, breaks and flows its
+   // own paragraph only
+   std::string text;
+   for (int i = 0; i != 200; ++i)
+      text += "The quick brown fox jumps over the lazy dog, again and again.\n";
+
+   text_layout layout{font_descr{"Open Sans", 12}, text};
+   layout.flow(200);
+
+   BENCHMARK("insert and flow")
+   {
+      layout.insert(text.size() / 2, "x");
+      layout.flow(200);
+      return layout.num_lines();
+   };
+
+   BENCHMARK("rebuild and flow")
+   {
+      text_layout rebuilt{font_descr{"Open Sans", 12}, text};
+      rebuilt.flow(200);
+      return rebuilt.num_lines();
+   };
+}
+
+TEST_CASE("Text Layout Caret Lookup")
+{
+   // Caret lookups cost the same anywhere in a long document
+   std::string text;
+   for (int i = 0; i != 20000; ++i)
+      text += "The quick brown fox jumps over the lazy dog, again and again.\n";
+
+   text_layout layout{font_descr{"Open Sans", 12}, text};
+   layout.flow(200);
+
+   BENCHMARK("caret_point near the end")
+   {
+      return layout.caret_point(text.size() - 10);
+   };
+
+   BENCHMARK("caret_index near the end")
+   {
+      return layout.caret_index(layout.caret_point(text.size() - 10));
+   };
+
+   BENCHMARK("flow")
+   {
+      layout.flow(300);
+      layout.flow(200);
+      return layout.num_lines();
+   };
+}
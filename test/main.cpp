@@ -12,13 +12,31 @@
 #define CATCH_CONFIG_MAIN
 #include <infra/catch.hpp>
 #include <artist/affine_transform.hpp>
+#include <artist/static_path.hpp>
+#include <artist/batch_renderer.hpp>
+#include <artist/colormap.hpp>
+#include <artist/disk_image_cache.hpp>
+#include <artist/encode_queue.hpp>
+#include <artist/image_atlas.hpp>
+#include <artist/image_cache.hpp>
+#include <artist/image_memory.hpp>
+#include <artist/image_ops.hpp>
+#include <artist/raster_cache.hpp>
+#include <artist/surface_pool.hpp>
+#include <artist/text_cache.hpp>
 #include "app_paths.hpp"
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <iterator>
+#include <thread>
 
 using namespace cycfi::artist;
 using namespace font_constants;
 using cycfi::codepoint;
+namespace fs = cycfi::fs;
 
 auto constexpr window_size = point{640.0f, 480.0f};
 auto constexpr bkd_color = rgba(54, 52, 55, 255);
@@ -1004,3 +1022,1282 @@ TEST_CASE("Color Maths")
   check(a * 2, color(0.4, 0.5, 1.0, 1.0));
   check(2 * a, color(0.4, 0.5, 1.0, 1.0));
 }
+
+TEST_CASE("Batch Transform")
+{
+   auto mat = affine_identity.translate(3.5, -7.25).rotate(0.7).scale(1.5, 0.25);
+   auto mat_f = affine_transform_f(mat);
+
+   auto check = [](point a, point b)
+   {
+      CHECK(a.x == Approx(b.x).margin(0.001));
+      CHECK(a.y == Approx(b.y).margin(0.001));
+   };
+
+   std::vector<point> src;
+   for (int i = 0; i != 37; ++i)
+      src.push_back({i * 10.5f - 100, i * -3.25f + 40});
+
+   // AoS
+   {
+      std::vector<point> dest(src.size());
+      transform_points(mat, src.data(), dest.data(), src.size());
+      for (std::size_t i = 0; i != src.size(); ++i)
+         check(dest[i], mat.apply(src[i]));
+
+      transform_points(mat_f, src.data(), dest.data(), src.size());
+      for (std::size_t i = 0; i != src.size(); ++i)
+         check(dest[i], mat.apply(src[i]));
+
+      // In place
+      dest = src;
+      transform_points(mat, dest.data(), dest.data(), dest.size());
+      for (std::size_t i = 0; i != src.size(); ++i)
+         check(dest[i], mat.apply(src[i]));
+
+      // The scalar, constexpr, apply
+      dest = src;
+      mat.apply(dest.data(), dest.size());
+      for (std::size_t i = 0; i != src.size(); ++i)
+         check(dest[i], mat.apply(src[i]));
+   }
+
+   // The in-place apply still works at compile time
+   {
+      constexpr auto moved = []
+      {
+         point p[2] = {{1, 2}, {3, 4}};
+         make_translation(10, 20).apply<2>(p);
+         return p[1];
+      }();
+      static_assert(moved.x == 13 && moved.y == 24);
+   }
+
+   // SoA
+   {
+      std::vector<float> x, y;
+      for (auto p : src)
+      {
+         x.push_back(p.x);
+         y.push_back(p.y);
+      }
+      std::vector<float> x_out(x.size()), y_out(y.size());
+      transform_points(mat, x.data(), y.data(), x_out.data(), y_out.data(), x.size());
+      for (std::size_t i = 0; i != src.size(); ++i)
+         check({x_out[i], y_out[i]}, mat.apply(src[i]));
+   }
+}
+
+TEST_CASE("Region")
+{
+   region a = rect{0, 0, 20, 20};
+   region b = rect{10, 10, 30, 30};
+
+   // Union: 3 bands
+   auto u = a | b;
+   CHECK(u.size() == 3);
+   CHECK(u.bounds() == rect{0, 0, 30, 30});
+   CHECK(u.contains(point{5, 5}));
+   CHECK(u.contains(point{25, 25}));
+   CHECK(!u.contains(point{25, 5}));
+   CHECK(!u.contains(point{30, 30})); // half-open
+
+   // Intersection
+   auto i = a & b;
+   CHECK(i.size() == 1);
+   CHECK(*i.begin() == rect{10, 10, 20, 20});
+
+   // Difference
+   auto d = a - b;
+   CHECK(d.contains(point{5, 15}));
+   CHECK(!d.contains(point{15, 15}));
+   CHECK((d & b).is_empty());
+
+   // Xor
+   auto x = a ^ b;
+   CHECK(x == (u - i));
+
+   // Touching rects coalesce into one
+   region c{rect{0, 0, 10, 10}, rect{10, 0, 20, 10}, rect{0, 10, 20, 20}};
+   CHECK(c == a);
+   CHECK(c.size() == 1);
+
+   CHECK(u.contains(rect{5, 5, 15, 15}));
+   CHECK(!u.contains(rect{15, 5, 25, 15}));
+   CHECK(u.intersects(rect{15, 5, 25, 15}));
+   CHECK(!u.intersects(rect{21, 0, 30, 9}));
+
+   // Simplify never loses coverage
+   region s{rect{0, 0, 1, 1}, rect{100, 0, 101, 1}, rect{0, 50, 1, 51}};
+   auto orig = s;
+   s.simplify(2);
+   CHECK(s.size() <= 2);
+   CHECK((orig - s).is_empty());
+}
+
+TEST_CASE("Static Path")
+{
+   constexpr auto icon = static_path("M 0 0 L 10 10 Q 20 0 30 10 c 5 5 10 5 15 0 Z");
+   static_assert(icon.num_verbs == 5);
+   static_assert(icon.num_points == 7);
+   static_assert(icon.verbs[3] == path_verb::cubic);
+   static_assert(icon.points[6] == point{45, 10});
+
+   CHECK(path(icon) == path("M 0 0 L 10 10 Q 20 0 30 10 c 5 5 10 5 15 0 Z"));
+
+   // Arcs are converted to cubic segments at compile time
+   constexpr auto circle = static_path("M 10 50 A 40 40 0 1 1 90 50 A 40 40 0 1 1 10 50 Z");
+   static_assert(circle.verbs[1] == path_verb::cubic);
+   path p = circle;
+   CHECK(p.includes(50, 50));
+   CHECK(p.includes(50, 12));
+   CHECK(!p.includes(12, 12));
+}
+
+TEST_CASE("Batch Color Conversion")
+{
+   std::vector<color> src;
+   for (int i = 0; i != 37; ++i)
+      src.push_back({i / 36.0f, 1.0f - i / 36.0f, (i % 7) / 6.0f, (i % 5) / 4.0f});
+
+   // Pack and unpack round trip
+   std::vector<std::uint32_t> rgba8(src.size()), bgra8(src.size());
+   to_rgba8(src.data(), rgba8.data(), src.size());
+   to_bgra8(src.data(), bgra8.data(), src.size());
+
+   std::vector<color> dest(src.size());
+   from_rgba8(rgba8.data(), dest.data(), src.size());
+   for (std::size_t i = 0; i != src.size(); ++i)
+   {
+      auto p = reinterpret_cast<std::uint8_t const*>(&rgba8[i]);
+      auto q = reinterpret_cast<std::uint8_t const*>(&bgra8[i]);
+      CHECK(dest[i] == rgba(p[0], p[1], p[2], p[3]));
+      CHECK(p[0] == q[2]);
+      CHECK(p[1] == q[1]);
+      CHECK(p[2] == q[0]);
+      CHECK(p[3] == q[3]);
+      CHECK(dest[i].red == Approx(src[i].red).margin(1.0 / 255));
+   }
+
+   from_bgra8(bgra8.data(), dest.data(), src.size());
+   for (std::size_t i = 0; i != src.size(); ++i)
+      CHECK(dest[i].blue == Approx(src[i].blue).margin(1.0 / 255));
+
+   // Premultiply
+   dest = src;
+   premultiply(dest.data(), dest.size());
+   for (std::size_t i = 0; i != src.size(); ++i)
+   {
+      CHECK(dest[i].green == src[i].green * src[i].alpha);
+      CHECK(dest[i].alpha == src[i].alpha);
+   }
+   unpremultiply(dest.data(), dest.size());
+   for (std::size_t i = 0; i != src.size(); ++i)
+   {
+      if (src[i].alpha == 0)
+         CHECK(dest[i].green == 0);
+      else
+         CHECK(dest[i].green == Approx(src[i].green));
+   }
+
+   premultiply(rgba8.data(), rgba8.size());
+   for (std::size_t i = 0; i != src.size(); ++i)
+   {
+      auto p = reinterpret_cast<std::uint8_t const*>(&rgba8[i]);
+      auto a = std::lround(src[i].alpha * 255);
+      CHECK(p[3] == a);
+      CHECK(p[0] == std::lround(std::lround(src[i].red * 255) * a / 255.0));
+   }
+
+   // sRGB
+   dest = src;
+   srgb_to_linear(dest.data(), dest.size());
+   CHECK(dest[18].red == Approx(std::pow((0.5 + 0.055) / 1.055, 2.4)).margin(1e-5));
+   CHECK(dest[18].alpha == src[18].alpha);
+   linear_to_srgb(dest.data(), dest.size());
+   for (std::size_t i = 0; i != src.size(); ++i)
+      CHECK(dest[i].red == Approx(src[i].red).margin(1e-4));
+
+   // hsl
+   std::vector<float> h, s, l;
+   for (int i = 0; i != 37; ++i)
+   {
+      h.push_back(i * 10.0f);
+      s.push_back((i % 4) / 3.0f);
+      l.push_back((i % 6) / 5.0f);
+   }
+   hsl(h.data(), s.data(), l.data(), dest.data(), dest.size());
+   for (std::size_t i = 0; i != dest.size(); ++i)
+   {
+      auto c = hsl(h[i], s[i], l[i]);
+      CHECK(dest[i].red == Approx(c.red).margin(1e-5));
+      CHECK(dest[i].green == Approx(c.green).margin(1e-5));
+      CHECK(dest[i].blue == Approx(c.blue).margin(1e-5));
+      CHECK(dest[i].alpha == 1.0f);
+   }
+}
+
+TEST_CASE("Colormap")
+{
+   colormap cmap{{0.0f, colors::black}, {0.5f, colors::red}, {1.0f, colors::white}};
+   REQUIRE(cmap.size() == colormap::default_size);
+   CHECK(cmap(0.0f) == colors::black);
+   CHECK(cmap(1.0f) == colors::white);
+   CHECK(cmap(0.25f).red == Approx(0.5f).margin(1.0 / 255));
+   CHECK(cmap(0.25f).green == 0.0f);
+
+   // Enough values to exercise the SIMD code and the scalar tail
+   std::vector<float> values;
+   for (int i = 0; i != 1003; ++i)
+      values.push_back(i / 500.0f - 0.5f);   // -0.5 to 1.5
+   values[3] = std::nanf("");
+
+   std::vector<std::uint32_t> pixels(values.size());
+   cmap.apply(values.data(), values.size(), pixels.data());
+   for (std::size_t i = 0; i != values.size(); ++i)
+   {
+      auto v = std::isnan(values[i])? 0.0f : std::clamp(values[i], 0.0f, 1.0f);
+      CHECK(pixels[i] == cmap.data()[std::lround(v * 255)]);
+   }
+
+   // Mapping a range
+   cmap.apply(values.data(), values.size(), pixels.data(), -0.5f, 1.5f);
+   CHECK(pixels[0] == cmap.data()[0]);
+   CHECK(pixels[500] == cmap.data()[128]);
+   CHECK(pixels[1000] == cmap.data()[255]);
+
+   // Named maps
+   auto viridis = colormaps::viridis(4096);
+   REQUIRE(viridis.size() == 4096);
+   CHECK(viridis(0.0f) == rgb(0x440154));
+   CHECK(viridis(1.0f) == rgb(0xFDE725));
+
+   CHECK_THROWS(colormap({}));
+   CHECK_THROWS(colormap({{0.0f, colors::black}}, 1));
+}
+
+TEST_CASE("Zero-Copy Image")
+{
+   // 4 x 3 pixels, with rows padded to 6 pixels
+   std::vector<std::uint32_t> buf(6 * 3, 0xff0000ff);
+   bool released = false;
+   {
+      auto img = make_image<pixel_format::rgba32>(
+         buf.data(), {4, 3}, 6 * sizeof(std::uint32_t), [&]{ released = true; });
+      CHECK(img.size().x == 4);
+      CHECK(img.size().y == 3);
+#if !defined(ARTIST_QUARTZ_2D) // Quartz does not expose the pixels of CGImage backed images
+      CHECK(img.pixels() == buf.data());
+#endif
+      buf[0] = 0xff00ff00;
+      img.pixels_changed();
+      CHECK(!released);
+   }
+   CHECK(released);
+
+   // Rows too short for the width
+   released = false;
+   CHECK_THROWS(make_image<pixel_format::rgba32>(
+      buf.data(), {4, 3}, 2, [&]{ released = true; }));
+   CHECK(released);
+}
+
+TEST_CASE("Native Pixel Formats")
+{
+   std::vector<std::uint32_t> bgra(16 * 16, 0x80402010);
+   std::vector<std::uint8_t> mask(16 * 16, 0x80);
+   std::vector<std::uint64_t> half(16 * 16, 0x3c00380000000000); // A = 1.0, B = 0.5
+
+   auto a = make_image<pixel_format::bgra32_premul>(bgra.data(), {16, 16}, 0);
+   auto b = make_image<pixel_format::bgra32>(bgra.data(), {16, 16}, 0);
+   auto c = make_image<pixel_format::rgba32_premul>(bgra.data(), {16, 16}, 0);
+   auto d = make_image<pixel_format::alpha8>(mask.data(), {16, 16}, 0);
+   auto e = make_image<pixel_format::rgba_f16>(half.data(), {16, 16}, 0);
+   auto f = make_image<pixel_format::rgb565>(
+      reinterpret_cast<std::uint16_t const*>(bgra.data()), {16, 16});
+
+#if !defined(ARTIST_QUARTZ_2D) // Quartz does not expose the pixels of CGImage backed images
+   CHECK(a.pixels() == bgra.data());
+   CHECK(e.bitmap_size() == extent{16, 16});
+   CHECK(d.bytes() == mask.data());
+   CHECK(d.format() == pixel_format::alpha8);
+   CHECK(e.bytes() == reinterpret_cast<std::uint8_t*>(half.data()));
+   CHECK(e.format() == pixel_format::rgba_f16);
+#endif
+
+   // Side by side; alpha8 is drawn in the fill color
+   image pm{{96, 16}};
+   {
+      offscreen_image ctx{pm};
+      canvas cnv{ctx.context()};
+      cnv.fill_style(colors::red);
+      float x = 0;
+      for (auto const* img : {&a, &b, &c, &d, &e, &f})
+      {
+         CHECK(img->size() == extent{16, 16});
+         cnv.draw(*img, x, 0);
+         x += 16;
+      }
+   }
+
+   // Premultiplied R, G, B, A, at the center of each image
+   auto raw = pm.encode(image_format::raw);
+   REQUIRE(raw.size() == 96 * 16 * 4);
+   auto matches = [&](int i, std::array<int, 4> expected)
+   {
+      auto p = &raw[(8 * 96 + i * 16 + 8) * 4];
+      for (int c = 0; c != 4; ++c)
+         if (std::abs(p[c] - expected[c]) > 2)
+            return false;
+      return true;
+   };
+   CHECK(matches(0, {0x40, 0x20, 0x10, 0x80}));    // bgra32_premul
+   CHECK(matches(1, {0x20, 0x10, 0x08, 0x80}));    // bgra32, premultiplied
+   CHECK(matches(2, {0x10, 0x20, 0x40, 0x80}));    // rgba32_premul
+   CHECK(matches(3, {0x80, 0x00, 0x00, 0x80}));    // alpha8, in red
+   CHECK(matches(4, {0x00, 0x00, 0x80, 0xff}));    // rgba_f16
+   CHECK(raw[(8 * 96 + 5 * 16 + 8) * 4 + 3] == 0xff);  // rgb565 is opaque
+}
+
+TEST_CASE("Decode From Memory")
+{
+   auto path = get_images_path() + "logo.png";
+   std::ifstream file{path, std::ios::binary};
+   std::vector<std::uint8_t> encoded{
+      std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+   REQUIRE(!encoded.empty());
+
+   image from_file{path};
+   image from_memory{encoded.data(), encoded.size()};
+   CHECK(from_memory.size().x == from_file.size().x);
+   CHECK(from_memory.size().y == from_file.size().y);
+
+   std::uint8_t const garbage[] = {1, 2, 3, 4};
+   CHECK_THROWS(image(garbage, sizeof(garbage)));
+}
+
+TEST_CASE("Downscaled And Subset Decoding")
+{
+   auto path = get_images_path() + "logo.png";
+   image full{path};
+   auto full_size = full.size();
+
+   // At least as big as the image scaled to fit, never bigger than the image
+   extent target{full_size.x / 4, full_size.y / 4};
+   image thumb{path, target};
+   CHECK(thumb.size().x >= std::floor(target.x));
+   CHECK(thumb.size().y >= std::floor(target.y));
+   CHECK(thumb.size().x <= full_size.x);
+   CHECK(thumb.size().y <= full_size.y);
+
+   image larger{path, extent{full_size.x * 2, full_size.y * 2}};
+   CHECK(larger.size().x == full_size.x);
+   CHECK(larger.size().y == full_size.y);
+
+   image part{path, rect{10, 20, 50, 40}};
+   CHECK(part.size().x == 40);
+   CHECK(part.size().y == 20);
+}
+
+TEST_CASE("Image Sampling")
+{
+   // One pixel wide black and white stripes
+   std::vector<std::uint32_t> buf(64 * 64);
+   for (std::size_t i = 0; i != buf.size(); ++i)
+      buf[i] = (i % 2)? 0xffffffff : 0xff000000;
+   auto stripes = make_image<pixel_format::rgba32>(buf.data(), {64, 64}, 0);
+
+   // Draws the stripes at 1/8 scale, to the left with nearest, and to the
+   // right with mipmap_linear
+   image pm{{16, 8}};
+   auto before = image_memory();
+   image_memory_stats built;
+   {
+      offscreen_image ctx{pm};
+      canvas cnv{ctx.context()};
+      CHECK(cnv.image_sampling() == canvas::nearest);
+      cnv.draw(stripes, rect{0, 0, 8, 8});
+      {
+         auto state = cnv.new_state();
+         cnv.image_sampling(canvas::mipmap_linear);
+         CHECK(cnv.image_sampling() == canvas::mipmap_linear);
+
+         // Minified: builds the mip chain once, then reuses it
+         cnv.draw(stripes, rect{8, 0, 8, 8});
+         built = image_memory();
+         cnv.draw(stripes, rect{8, 0, 8, 8});
+      }
+      CHECK(cnv.image_sampling() == canvas::nearest);
+   }
+
+#if !defined(ARTIST_QUARTZ_2D) // Quartz keeps its own copies for drawing
+   CHECK(built.cached_bytes == before.cached_bytes + (64 * 64 * 4) / 3);
+   CHECK(image_memory().cached_bytes == built.cached_bytes);
+
+   // Changing the pixels drops the chain
+   stripes.pixels_changed();
+   CHECK(image_memory().cached_bytes == before.cached_bytes);
+#endif
+
+   // Nearest picks single stripes; the mip chain averages them to gray
+   auto raw = pm.encode(image_format::raw);
+   REQUIRE(raw.size() == 16 * 8 * 4);
+   auto red = [&](int x, int y) { return int(raw[(y * 16 + x) * 4]); };
+   for (int x = 0; x != 8; ++x)
+   {
+      CHECK((red(x, 4) == 0 || red(x, 4) == 255));
+      CHECK(std::abs(red(x + 8, 4) - 128) <= 32);
+   }
+}
+
+TEST_CASE("Image Atlas")
+{
+   auto sheet = std::make_shared<image>(get_images_path() + "logo.png");
+   image_atlas atlas{sheet, {128, 128}};
+   CHECK(atlas.num_sprites() == 16);
+   CHECK(atlas.sprite(5) == rect{128, 128, 256, 256});
+
+   auto extra = atlas.add_sprite({0, 0, 64, 32});
+   CHECK(extra == 16);
+
+   atlas.add(0, point{10, 10});
+   atlas.add(5, make_rotation(0.5).translate(100, 100));
+   CHECK(!atlas.tinted());
+   atlas.add(extra, point{200, 10}, colors::red);
+   CHECK(atlas.tinted());
+   CHECK(atlas.size() == 3);
+
+   image pm{{256, 256}};
+   {
+      offscreen_image ctx{pm};
+      canvas cnv{ctx.context()};
+      cnv.draw_atlas(atlas);
+
+      // Skewed sprites are drawn one by one
+      atlas.add(1, make_skew(0.3, 0));
+      cnv.draw_atlas(atlas);
+   }
+
+   atlas.clear();
+   CHECK(atlas.empty());
+   CHECK(!atlas.tinted());
+   CHECK(atlas.num_sprites() == 17);
+   CHECK_THROWS(image_atlas(sheet, {0, 128}));
+
+   // A 16 x 4 white strip, drawn tinted blue as is, and tinted red turned
+   // a quarter turn (to 4 x 16) at x = 44
+   std::vector<std::uint32_t> buf(16 * 16, 0xffffffff);
+   auto white = std::make_shared<image>(
+      make_image<pixel_format::rgba32>(buf.data(), {16, 16}, 0));
+   image_atlas strips{white};
+   auto strip = strips.add_sprite({0, 0, 16, 4});
+   strips.add(strip, point{0, 0}, colors::blue);
+   strips.add(strip, affine_transform{0, 1, -1, 0, 48, 0}, colors::red);
+
+   image out{{64, 16}};
+   {
+      offscreen_image ctx{out};
+      canvas cnv{ctx.context()};
+      cnv.draw_atlas(strips);
+   }
+
+   auto raw = out.encode(image_format::raw);
+   REQUIRE(raw.size() == 64 * 16 * 4);
+   auto pixel = [&](int x, int y)
+   {
+      auto p = &raw[(y * 64 + x) * 4];
+      return std::array<int, 4>{p[0], p[1], p[2], p[3]};
+   };
+   CHECK(pixel(8, 2) == std::array<int, 4>{0, 0, 255, 255});
+   CHECK(pixel(8, 8)[3] == 0);
+   CHECK(pixel(46, 12) == std::array<int, 4>{255, 0, 0, 255});
+   CHECK(pixel(40, 2)[3] == 0);
+}
+
+TEST_CASE("Image Encoding")
+{
+   auto img = std::make_shared<image>(get_images_path() + "logo.png");
+   auto size = img->size();
+
+   for (auto format : {image_format::png, image_format::jpeg})
+   {
+      auto encoded = img->encode(format, 80);
+      REQUIRE(!encoded.empty());
+      image decoded{encoded.data(), encoded.size()};
+      CHECK(decoded.size() == size);
+   }
+
+   auto raw = img->encode(image_format::raw);
+   CHECK(raw.size() == std::size_t(size.x) * std::size_t(size.y) * 4);
+
+   encode_queue queue{1024 * 1024, 2};
+   auto png = queue.encode(img, image_format::png);
+   auto saved = queue.save(img, get_results_path() + "encode_queue.jpg", image_format::jpeg);
+   CHECK(png.get().size() > 0);
+   CHECK_NOTHROW(saved.get());
+   queue.wait();
+   CHECK(queue.bytes_queued() == 0);
+}
+
+TEST_CASE("Disk Image Cache")
+{
+   disk_image_cache cache{get_results_path() + "disk_image_cache"};
+   cache.clear();
+
+   auto path = get_images_path() + "logo.png";
+   auto decoded = cache.load(path);
+   auto mapped = cache.load(path);
+   CHECK(mapped->size() == decoded->size());
+
+#if !defined(ARTIST_QUARTZ_2D) // Quartz does not expose the pixels of CGImage backed images
+   auto size = decoded->bitmap_size();
+   REQUIRE(mapped->format() == decoded->format());
+   REQUIRE(mapped->row_bytes() == decoded->row_bytes());
+   CHECK(std::equal(
+      decoded->pixels(), decoded->pixels() + std::size_t(size.x * size.y)
+    , mapped->pixels()));
+#endif
+
+   auto thumb = cache.load(path, {64, 64});
+   CHECK(thumb->size().x < decoded->size().x);
+   CHECK_THROWS(cache.load("no_such_image.png"));
+}
+
+TEST_CASE("Image Ops")
+{
+   constexpr int w = 64, h = 48;
+   std::vector<std::uint32_t> buf(w * h, 0xff204080);
+   auto img = make_image<pixel_format::rgba32_premul>(buf.data(), {w, h}, 0);
+
+#if !defined(ARTIST_QUARTZ_2D) // Quartz does not expose the pixels of CGImage backed images
+   // A flat image stays flat
+   image_ops::box_blur(img, 3);
+   image_ops::gaussian_blur(img, 2.5f);
+   CHECK(std::all_of(buf.begin(), buf.end(), [](auto p) { return p == 0xff204080; }));
+
+   // A white dot spreads evenly
+   buf[20 * w + 30] = 0xffffffff;
+   image_ops::gaussian_blur(img, 1.5f);
+   CHECK(buf[20 * w + 29] == buf[20 * w + 31]);
+   CHECK(buf[19 * w + 30] == buf[21 * w + 30]);
+   CHECK((buf[20 * w + 30] & 0xff) > (buf[20 * w + 31] & 0xff));
+   CHECK((buf[20 * w + 31] & 0xff) > 0x80);
+
+   // Shift left by one pixel
+   float const shift[] = { 0, 0, 0, 0, 0, 1, 0, 0, 0 };
+   auto before = buf;
+   image_ops::convolve(img, shift, 3);
+   CHECK(buf[20 * w + 29] == before[20 * w + 30]);
+   CHECK(buf[20 * w + (w - 1)] == before[20 * w + (w - 1)]);
+   CHECK_THROWS(image_ops::convolve(img, shift, 2));
+
+   auto small = image_ops::resize(img, {16, 12});
+   CHECK(small.bitmap_size() == extent{16, 12});
+   CHECK(small.format() == pixel_format::rgba32_premul);
+   CHECK(small.pixels()[0] == 0xff204080);
+
+   // Lanczos rings past a step, but premultiplied colors stay within alpha
+   std::vector<std::uint32_t> step(16 * 4, 0x80000000);
+   for (int y = 0; y != 4; ++y)
+      std::fill_n(&step[y * 16 + 8], 8, 0x80000080);
+   auto stepped = make_image<pixel_format::rgba32_premul>(step.data(), {16, 4}, 0);
+   auto large = image_ops::resize(stepped, {64, 4});
+   auto bytes = large.bytes();
+   for (int i = 0; i != 64 * 4; ++i)
+      CHECK(bytes[i * 4] <= bytes[i * 4 + 3]);
+   CHECK(bytes[63 * 4] == 0x80);
+
+   // So does sharpening, past an edge from opaque black to half red
+   {
+      float const sharpen[] = { 0, -1, 0, -1, 5, -1, 0, -1, 0 };
+      std::vector<std::uint32_t> edge(16 * 4, 0xff000000);
+      for (int y = 0; y != 4; ++y)
+         std::fill_n(&edge[y * 16 + 8], 8, 0x80000080);
+      auto edged = make_image<pixel_format::rgba32_premul>(edge.data(), {16, 4}, 0);
+      image_ops::convolve(edged, sharpen, 3);
+      auto p = reinterpret_cast<std::uint8_t const*>(edge.data());
+      for (int i = 0; i != 16 * 4; ++i)
+         CHECK(p[i * 4] <= p[i * 4 + 3]);
+      CHECK(p[8 * 4 + 3] < 0x80);     // Alpha, sharpened at the edge
+      CHECK(p[8 * 4] == p[8 * 4 + 3]);
+   }
+
+   // The SIMD code gives the same bytes as plain scalar filters. 37 pixels
+   // wide, for the SIMD tails.
+   constexpr int nw = 37, nh = 9;
+   std::vector<std::uint32_t> noise(nw * nh);
+   std::uint32_t seed = 12345;
+   for (auto& p : noise)
+      p = seed = seed * 1664525 + 1013904223;
+   auto const original = noise;
+   auto noisy = make_image<pixel_format::rgba32>(noise.data(), {nw, nh}, 0);
+
+   auto to_byte = [](float v) { return std::uint8_t(std::clamp(std::nearbyint(v), 0.0f, 255.0f)); };
+   auto at = [&](std::vector<std::uint8_t> const& v, int x, int y)
+   {
+      return &v[(std::clamp(y, 0, nh - 1) * nw + std::clamp(x, 0, nw - 1)) * 4];
+   };
+   auto as_bytes = [](std::vector<std::uint32_t> const& v)
+   {
+      auto p = reinterpret_cast<std::uint8_t const*>(v.data());
+      return std::vector<std::uint8_t>(p, p + v.size() * 4);
+   };
+
+   // Box blur: a horizontal, then a vertical pass
+   {
+      constexpr int radius = 2, n = 2 * radius + 1;
+      float const w = 1.0f / n;
+      auto src = as_bytes(original);
+      std::vector<std::uint8_t> tmp(src.size()), expected(src.size());
+      for (int y = 0; y != nh; ++y)
+         for (int x = 0; x != nw; ++x)
+            for (int c = 0; c != 4; ++c)
+            {
+               float acc = 0.0f;
+               for (int j = 0; j != n; ++j)
+                  acc += w * at(src, x + j - radius, y)[c];
+               tmp[(y * nw + x) * 4 + c] = to_byte(acc);
+            }
+      for (int y = 0; y != nh; ++y)
+         for (int x = 0; x != nw; ++x)
+            for (int c = 0; c != 4; ++c)
+            {
+               float acc = 0.0f;
+               for (int j = 0; j != n; ++j)
+                  acc += w * at(tmp, x, y + j - radius)[c];
+               expected[(y * nw + x) * 4 + c] = to_byte(acc);
+            }
+
+      image_ops::box_blur(noisy, radius);
+      CHECK(as_bytes(noise) == expected);
+   }
+
+   // Convolution, with negative weights so that results clip both ways
+   {
+      float const sharpen[] = { 0, -0.5f, 0, -0.5f, 3, -0.5f, 0, -0.5f, 0 };
+      noise = original;
+      auto src = as_bytes(original);
+      std::vector<std::uint8_t> expected(src.size());
+      for (int y = 0; y != nh; ++y)
+         for (int x = 0; x != nw; ++x)
+         {
+            float acc[4] = {};
+            for (int ky = 0; ky != 3; ++ky)
+               for (int kx = 0; kx != 3; ++kx)
+               {
+                  auto p = at(src, x + kx - 1, y + ky - 1);
+                  for (int c = 0; c != 4; ++c)
+                     acc[c] += sharpen[ky * 3 + kx] * p[c];
+               }
+            for (int c = 0; c != 4; ++c)
+               expected[(y * nw + x) * 4 + c] = to_byte(acc[c]);
+         }
+
+      noisy.pixels_changed();
+      image_ops::convolve(noisy, sharpen, 3);
+      CHECK(as_bytes(noise) == expected);
+   }
+#endif
+
+   image picture{{32, 32}};
+   CHECK_THROWS(image_ops::box_blur(picture, 2));
+}
+
+TEST_CASE("Image Cache")
+{
+   auto path = get_images_path() + "logo.png";
+   image_cache cache;
+
+   // Concurrent loads of the same image share one decode
+   auto f1 = cache.load(path);
+   auto f2 = cache.load(path);
+   auto img = f1.get();
+   REQUIRE(img != nullptr);
+   CHECK(f2.get() == img);
+   CHECK(cache.find(path) == img);
+   CHECK(cache.load(path).get() == img);
+   CHECK(cache.bytes_used() > 0);
+
+   // Different decode targets are different entries
+   auto thumb = cache.load(path, {64, 64}).get();
+   REQUIRE(thumb != nullptr);
+   CHECK(thumb != img);
+   CHECK(thumb->size().x < img->size().x);
+
+   // Callbacks
+   std::promise<image_ptr> done;
+   cache.load(path, [&](image_ptr p) { done.set_value(p); });
+   CHECK(done.get_future().get() == img);
+
+   // Errors
+   CHECK_THROWS(cache.load("no_such_image.png").get());
+
+   // Cache hits do not look for the file again
+   {
+      auto copy = get_results_path() + "image_cache_logo.png";
+      fs::copy_file(path, copy, fs::copy_options::overwrite_existing);
+      auto copied = cache.load(copy).get();
+      REQUIRE(copied != nullptr);
+      fs::remove(copy);
+      CHECK(cache.find(copy) == copied);
+      CHECK(cache.load(copy).get() == copied);
+   }
+
+   // Over budget, least recently used first
+   cache.find(path);
+   cache.budget(cache.bytes_used() - 1);
+   CHECK(cache.find(path, {64, 64}) == nullptr);
+   CHECK(cache.find(path) == img);
+
+   cache.clear();
+   CHECK(cache.find(path) == nullptr);
+   CHECK(cache.bytes_used() == 0);
+}
+
+TEST_CASE("Image Memory")
+{
+   auto path = get_images_path() + "logo.png";
+   auto before = image_memory();
+   {
+      image img{path};
+      auto loaded = image_memory();
+      CHECK(loaded.images == before.images + 1);
+      CHECK(loaded.total_bytes() > before.total_bytes());
+   }
+   CHECK(image_memory().images == before.images);
+   CHECK(image_memory().total_bytes() == before.total_bytes());
+
+#if !defined(ARTIST_QUARTZ_2D) // Quartz purges its own image caches
+   // Purgeable images give up their pixels over the budget, least recently
+   // drawn first, and decode them again when needed
+   {
+      image thumb{path, extent{64, 64}};
+      image full{path};
+      auto raw = full.encode(image_format::raw);
+      auto bytes_of = [](image const& img)
+      {
+         return std::size_t(img.bitmap_size().x * img.bitmap_size().y) * 4;
+      };
+      auto thumb_bytes = bytes_of(thumb);
+      auto full_bytes = bytes_of(full);
+      thumb.purgeable(true);
+      full.purgeable(true);
+      CHECK(full.purgeable());
+
+      image pm{{8, 8}};
+      {
+         offscreen_image ctx{pm};
+         canvas cnv{ctx.context()};
+         cnv.draw(thumb, 0, 0);
+      }
+
+      // The caches count in the budget too: empty them first, so that
+      // only the images are evicted
+      surface_pool::clear();
+      raster_cache::clear();
+      text_cache::clear();
+
+      auto loaded = image_memory();
+
+      // Their pixels are kept by pixels_changed: they are not written
+      // unless the image is made an ordinary one first (see bytes)
+      thumb.pixels_changed();
+      full.pixels_changed();
+      CHECK(image_memory().bitmap_bytes == loaded.bitmap_bytes);
+      CHECK(full.purgeable());
+
+      image_memory_budget(loaded.total_bytes() - 1);
+      CHECK(image_memory().bitmap_bytes == loaded.bitmap_bytes - full_bytes);
+      image_memory_budget(1);
+      CHECK(image_memory().bitmap_bytes == loaded.bitmap_bytes - full_bytes - thumb_bytes);
+      image_memory_budget(0);
+
+      // Decoded again
+      CHECK(full.size() == extent{float(full.bitmap_size().x), float(full.bitmap_size().y)});
+      CHECK(full.encode(image_format::raw) == raw);
+      CHECK(image_memory().bitmap_bytes == loaded.bitmap_bytes - thumb_bytes);
+
+      // Reading the pixels makes it an ordinary image again
+      CHECK(full.bytes() != nullptr);
+      CHECK(!full.purgeable());
+      image_memory_budget(1);
+      CHECK(image_memory().bitmap_bytes == loaded.bitmap_bytes - thumb_bytes);
+      image_memory_budget(0);
+   }
+#endif
+
+   // Going over the budget drops the cache's least recently used images
+   image_cache cache{image_cache::default_budget, 1};
+   cache.load(path).get();
+   CHECK(cache.bytes_used() > 0);
+   image_memory_budget(1);
+   CHECK(cache.bytes_used() == 0);
+   CHECK(image_memory().evictions > before.evictions);
+   image_memory_budget(0);
+}
+
+TEST_CASE("Batch Renderer")
+{
+   // A display list, shared by all the jobs that use it
+   auto chart = std::make_shared<image>(extent{64, 48});
+   {
+      offscreen_image ctx{*chart};
+      canvas cnv{ctx.context()};
+      cnv.fill_style(colors::light_sky_blue);
+      cnv.add_rect(0, 0, 64, 48);
+      cnv.fill();
+   }
+
+   std::vector<batch_renderer::job> jobs;
+   for (int i = 0; i != 8; ++i)
+   {
+      batch_renderer::job j;
+      j.size = {64, 48};
+      j.display_list = chart;
+      j.scene = [i](canvas& cnv)
+      {
+         cnv.fill_style(colors::red);
+         cnv.add_rect(4, 4, 4.0f * i, 8);
+         cnv.fill();
+      };
+      jobs.push_back(std::move(j));
+   }
+   jobs[3].scene = [](canvas&) { throw std::runtime_error{"Error: bad scene"}; };
+
+   batch_renderer renderer{3};
+   CHECK(renderer.num_threads() == 3);
+
+   // The output is called on the worker threads: check the results here
+   std::vector<batch_renderer::result> results;
+   renderer.render(jobs,
+      [&](batch_renderer::result&& r) { results.push_back(std::move(r)); });
+
+   REQUIRE(results.size() == jobs.size());
+   std::sort(results.begin(), results.end(),
+      [](auto const& a, auto const& b) { return a.index < b.index; });
+   for (auto const& r : results)
+   {
+      if (r.index == 3)
+      {
+         CHECK(r.error);
+         continue;
+      }
+      REQUIRE(!r.error);
+      image decoded{r.encoded.data(), r.encoded.size()};
+      CHECK(decoded.size() == extent{64, 48});
+      CHECK(r.render_time.count() >= 0);
+      CHECK(r.encode_time.count() >= 0);
+   }
+
+   // The canvases of the first batch went back to the surface_pool: the
+   // second batch draws into the same buffers, without allocating
+   auto pooled = surface_pool::stats();
+   results.clear();
+   renderer.render(jobs,
+      [&](batch_renderer::result&& r) { results.push_back(std::move(r)); });
+   CHECK(results.size() == jobs.size());
+   CHECK(surface_pool::stats().misses == pooled.misses);
+   CHECK(surface_pool::stats().hits >= pooled.hits + jobs.size());
+}
+
+TEST_CASE("Surface Pool")
+{
+   surface_pool::clear();
+   auto before = surface_pool::stats();
+
+   std::uint8_t* data;
+   {
+      auto buf = surface_pool::acquire(100 * 100 * 4);
+      REQUIRE(buf);
+      CHECK(buf.size() >= 100 * 100 * 4);
+      CHECK(surface_pool::stats().bytes_in_use == before.bytes_in_use + buf.size());
+      data = buf.data();
+   }
+   CHECK(surface_pool::stats().bytes_pooled > 0);
+
+   // A slightly different size falls in the same bucket
+   {
+      auto buf = surface_pool::acquire(100 * 98 * 4);
+      CHECK(buf.data() == data);
+      CHECK(surface_pool::stats().hits == before.hits + 1);
+   }
+
+   // Other sizes are kept in buckets of their own
+   {
+      auto small = surface_pool::acquire(32 * 32 * 4);
+      auto large = surface_pool::acquire(400 * 400 * 4);
+      CHECK(small.data() != data);
+      CHECK(large.data() != data);
+   }
+   {
+      auto buf = surface_pool::acquire(100 * 100 * 4);
+      CHECK(buf.data() == data);
+   }
+
+   // Offscreen images, and encoding them, borrow and return their pixels
+   {
+      image img{extent{64, 48}};
+      {
+         offscreen_image ctx{img};
+         canvas cnv{ctx.context()};
+         cnv.fill_style(colors::red);
+         cnv.add_rect(0, 0, 64, 48);
+         cnv.fill();
+      }
+      img.encode(image_format::png);
+      img.encode(image_format::png);
+   }
+   CHECK(surface_pool::stats().bytes_in_use == before.bytes_in_use);
+
+   // So do raster canvases, and (on Skia) their layers
+   auto raster = detail::rasterize(extent{64, 48},
+      [](canvas& cnv)
+      {
+         auto in_use = surface_pool::stats().bytes_in_use;
+         cnv.begin_layer(rect{0, 0, 64, 48}, 0.5f);
+#if !defined(ARTIST_QUARTZ_2D) // Quartz allocates transparency layers itself
+         CHECK(surface_pool::stats().bytes_in_use > in_use);
+#endif
+         cnv.fill_style(colors::red);
+         cnv.add_rect(0, 0, 64, 48);
+         cnv.fill();
+         cnv.end_layer();
+         CHECK(surface_pool::stats().bytes_in_use == in_use);
+      }
+   );
+   CHECK(surface_pool::stats().bytes_in_use > before.bytes_in_use);
+
+   // The idle buffers count in the image memory budget: over it, the
+   // pool frees the least recently used first
+   raster_cache::clear();
+   text_cache::clear();
+   auto pooled = surface_pool::stats();
+   CHECK(image_memory().surface_pool_bytes == pooled.bytes_pooled);
+   {
+      auto buf = surface_pool::acquire(100 * 100 * 4);
+      CHECK(buf.data() == data);
+   }
+   image_memory_budget(image_memory().total_bytes() - 1);
+   CHECK(surface_pool::stats().bytes_pooled < pooled.bytes_pooled);
+   CHECK(surface_pool::stats().evictions > pooled.evictions);
+   {
+      auto buf = surface_pool::acquire(100 * 100 * 4);
+      CHECK(buf.data() == data);    // The most recently used is kept
+   }
+   image_memory_budget(1);
+   CHECK(surface_pool::stats().bytes_pooled == 0);
+   CHECK(image_memory().surface_pool_bytes == 0);
+   image_memory_budget(0);
+}
+
+TEST_CASE("Layers")
+{
+   image pm{{48, 16}};
+   {
+      offscreen_image ctx{pm};
+      canvas cnv{ctx.context()};
+
+      // Group opacity: the overlapping rects fade as one
+      cnv.begin_layer({0, 0, 16, 16}, 0.5f);
+      cnv.image_sampling(canvas::linear);
+      cnv.fill_style(colors::red);
+      cnv.fill_rect(0, 0, 12, 16);
+      cnv.fill_rect(4, 0, 12, 16);
+      cnv.end_layer();
+      CHECK(cnv.image_sampling() == canvas::nearest);
+
+      // Opaque source_over: no layer, but still clipped to the bounds
+      cnv.begin_layer({16, 0, 24, 16});
+      cnv.fill_style(colors::blue);
+      cnv.fill_rect(16, 0, 16, 16);
+      cnv.end_layer();
+
+      // The global alpha still applies to drawing within the layer, and
+      // the layer's opacity on top of it
+      cnv.global_alpha(0.5f);
+      cnv.begin_layer({32, 0, 16, 16}, 0.5f);
+      CHECK(cnv.global_alpha() == 0.5f);
+      cnv.fill_style(colors::red);
+      cnv.fill_rect(32, 0, 16, 16);
+      cnv.end_layer();
+      CHECK(cnv.global_alpha() == 0.5f);
+   }
+
+   auto raw = pm.encode(image_format::raw);
+   REQUIRE(raw.size() == 48 * 16 * 4);
+   auto alpha = [&](int x, int y) { return int(raw[(y * 48 + x) * 4 + 3]); };
+   CHECK(std::abs(alpha(2, 8) - 128) <= 1);
+   CHECK(std::abs(alpha(8, 8) - 128) <= 1);  // Not 192, as it would be without the layer
+   CHECK(alpha(20, 8) == 255);
+   CHECK(alpha(28, 8) == 0);
+   CHECK(std::abs(alpha(40, 8) - 64) <= 1);  // 0.5 within, times 0.5 for the layer
+}
+
+TEST_CASE("Raster Cache")
+{
+   raster_cache::clear();
+   raster_cache::min_frames(2);
+   auto before = raster_cache::stats();
+
+   int draws = 0;
+   auto content = [&](canvas& cnv)
+   {
+      ++draws;
+      cnv.fill_style(colors::red);
+      cnv.fill_rect(0, 0, 32, 16);
+   };
+
+   image pm{{32, 16}};
+   auto draw = [&](std::size_t key, float scale)
+   {
+      offscreen_image ctx{pm};
+      canvas cnv{ctx.context()};
+      cnv.scale(scale);
+      cnv.cached(key, {0, 0, 16, 16}, content);
+   };
+
+   auto frame = [&](float scale)
+   {
+      draw(42, scale);
+      raster_cache::next_frame();
+   };
+
+   frame(1);
+   frame(1);                  // Stable: rasterized
+   frame(1);                  // Blitted
+   CHECK(draws == 2);
+   auto after = raster_cache::stats();
+   CHECK(after.rasterizations == before.rasterizations + 1);
+   CHECK(after.hits == before.hits + 1);
+   CHECK(after.bytes == 16 * 16 * 4);
+
+   // The raster is clipped to the bounds
+   auto raw = pm.encode(image_format::raw);
+   REQUIRE(raw.size() == 32 * 16 * 4);
+   CHECK(raw[(8 * 32 + 8) * 4 + 3] == 255);
+   CHECK(raw[(8 * 32 + 24) * 4 + 3] == 0);
+
+   // Drawn more than once in a frame, content counts that frame once
+   draw(7, 1);
+   draw(7, 1);
+   raster_cache::next_frame();
+   CHECK(raster_cache::stats().rasters == 1);
+   draw(7, 1);                // The second frame: rasterized
+   raster_cache::next_frame();
+   CHECK(raster_cache::stats().rasters == 2);
+
+   // Content that skips a frame counts from the start again
+   draw(9, 1);
+   raster_cache::next_frame();
+   raster_cache::next_frame();   // Skipped: 9 is forgotten
+   CHECK(raster_cache::stats().entries == 2);
+   draw(9, 1);
+   raster_cache::next_frame();
+   CHECK(raster_cache::stats().entries == 3);
+   CHECK(raster_cache::stats().rasters == 2);
+
+   // A new scale drops the raster
+   auto drawn = draws;
+   frame(2);
+   CHECK(draws == drawn + 1);
+   CHECK(raster_cache::stats().rasters == 1);
+
+   // The rasters count in the image memory budget: over it, they are
+   // evicted, but their entries are kept. Their pixels go back to the
+   // surface_pool, which the budget then empties too.
+   CHECK(raster_cache::stats().entries == 2);
+   CHECK(image_memory().raster_cache_bytes == raster_cache::stats().bytes);
+   image_memory_budget(1);
+   CHECK(raster_cache::stats().rasters == 0);
+   CHECK(raster_cache::stats().entries == 2);
+   CHECK(raster_cache::stats().evictions == before.evictions + 1);
+   CHECK(image_memory().raster_cache_bytes == 0);
+   CHECK(surface_pool::stats().bytes_pooled == 0);
+   image_memory_budget(0);
+
+   raster_cache::min_frames(raster_cache::default_min_frames);
+   raster_cache::clear();
+}
+
+TEST_CASE("Text Cache")
+{
+   text_cache::clear();
+   raster_cache::clear();
+   surface_pool::clear();
+   auto before = text_cache::stats();
+
+   image pm{{64, 32}};
+   offscreen_image ctx{pm};
+   canvas cnv{ctx.context()};
+   cnv.font(font_descr{"Open Sans", 12});
+
+   // Shaped and measured once, then reused by every draw
+   auto m = cnv.measure_text("Label");
+   for (int i = 0; i != 10; ++i)
+      cnv.fill_text("Label", 0, 16);
+   CHECK(cnv.measure_text("Label").size.x == m.size.x);
+
+   auto after = text_cache::stats();
+   CHECK(after.misses == before.misses + 1);
+   CHECK(after.hits == before.hits + 11);
+   CHECK(after.entries == 1);
+
+   // Keyed by size too
+   cnv.font(font_descr{"Open Sans", 24});
+   CHECK(cnv.measure_text("Label").size.x > m.size.x);
+   CHECK(text_cache::stats().entries == 2);
+
+   // The shaped text counts, estimated, in the image memory budget
+   auto cached = text_cache::stats();
+   CHECK(cached.bytes > after.bytes);
+   CHECK(image_memory().text_cache_bytes == cached.bytes);
+
+   // Over it, the least recently used is dropped first
+   cnv.font(font_descr{"Open Sans", 12});
+   cnv.measure_text("Label");
+   image_memory_budget(image_memory().total_bytes() - 1);
+   CHECK(text_cache::stats().entries == 1);
+   CHECK(text_cache::stats().evictions == before.evictions + 1);
+   CHECK(image_memory().text_cache_bytes == text_cache::stats().bytes);
+   auto hits = text_cache::stats().hits;
+   cnv.measure_text("Label");
+   CHECK(text_cache::stats().hits == hits + 1);
+   image_memory_budget(0);
+   CHECK(text_cache::stats().hit_rate() > 0);
+}
+
+TEST_CASE("Shared HarfBuzz Fonts")
+{
+   // Layouts of the same typeface, made and flowed on several threads at
+   // once, share one HarfBuzz font, and lay out the same
+   std::string_view text = "The quick brown fox jumps over the lazy dog. "
+      "Pack my box with five dozen liquor jugs.";
+   auto layout_end = [&]
+   {
+      text_layout layout{font_descr{"Open Sans", 14}, text};
+      layout.flow(120);
+      return layout.caret_point(text.size());
+   };
+
+   auto expected = layout_end();
+   std::vector<point> ends(4);
+   std::vector<std::thread> threads;
+   for (auto& end : ends)
+      threads.emplace_back([&]{ end = layout_end(); });
+   for (auto& t : threads)
+      t.join();
+   for (auto const& end : ends)
+      CHECK(end == expected);
+}
+
+TEST_CASE("Text Layout Editing")
+{
+   // Paragraphs of the same word, flowed three words to a line. Edited
+   // layouts break their lines, and place the words, where the width of
+   // the word (measured on one line, without breaking) says they go.
+   font_descr font{"Open Sans", 14};
+   text_layout words{font, "word word\nword"};
+   words.flow(1000);
+   auto word_width = words.caret_point(4).x;
+   auto advance = words.caret_point(5).x;          // A word and a space
+   auto line_height = words.caret_point(10).y - words.caret_point(0).y;
+   REQUIRE(word_width > 0);
+   REQUIRE(line_height > 0);
+   auto width = 3 * advance + word_width / 2;
+
+   // The text of paragraphs of num_words each. Every word, with the space
+   // or '\n' after it, is 5 characters.
+   auto paragraphs = [](std::vector<int> const& num_words)
+   {
+      std::string text;
+      for (auto n : num_words)
+      {
+         if (!text.empty())
+            text += '\n';
+         for (int i = 0; i != n; ++i)
+            text += i? " word" : "word";
+      }
+      return text;
+   };
+
+   auto check_lines = [&](text_layout const& layout, std::vector<int> const& num_words)
+   {
+      auto text = paragraphs(num_words);    // ASCII
+      REQUIRE(layout.text() == std::u32string(text.begin(), text.end()));
+      auto top = layout.caret_point(0).y;
+      std::size_t index = 0;
+      std::size_t line = 0;
+      for (auto n : num_words)
+      {
+         for (int i = 0; i != n; ++i, index += 5)
+         {
+            auto p = layout.caret_point(index);
+            CHECK(std::abs(p.x - (i % 3) * advance) < 0.01f);
+            CHECK(std::abs(p.y - (top + (line + i / 3) * line_height)) < 0.01f);
+         }
+         line += (n + 2) / 3;
+      }
+      CHECK(layout.num_lines() == line);
+   };
+
+   text_layout layout{font, paragraphs({5, 2, 7})};
+   layout.flow(width);
+   check_lines(layout, {5, 2, 7});
+
+   layout.insert(25, "word ");      // At the start of the second paragraph
+   layout.flow(width);
+   check_lines(layout, {5, 3, 7});
+
+   layout.erase(0, 5);
+   layout.flow(width);
+   check_lines(layout, {4, 3, 7});
+
+   layout.erase(19, 1);             // Joins the first two paragraphs
+   layout.insert(19, " ");
+   layout.append("\nword word word word");
+   layout.flow(width);
+   check_lines(layout, {7, 7, 4});
+
+   layout.erase(0);
+   layout.flow(width);
+   CHECK(layout.text().empty());
+   CHECK(layout.num_lines() == 0);
+
+   // Queries between an edit and the next flow see no lines
+   text_layout edited{font, "word word"};
+   edited.flow(1000);
+   edited.erase(0, 5);
+   CHECK(edited.num_lines() == 0);
+   CHECK(edited.caret_index({20, 0}) == 0);
+   CHECK(edited.caret_point(2).x == 0);
+   CHECK(edited.caret_point(2).y == 0);
+   edited.insert(0, "word ");
+   CHECK(edited.num_lines() == 0);
+   edited.flow(1000);
+   CHECK(edited.num_lines() == 1);
+   CHECK(edited.caret_index({advance + 1, 0}) == 5);
+}
+
+TEST_CASE("Text Layout Caret Lookup")
+{
+   // Caret lookups in a large document: each paragraph starts a row at x
+   // = 0, below the one before
+   std::string_view para = "The quick brown fox jumps over the lazy dog.\n";
+   std::string text;
+   for (int i = 0; i != 5000; ++i)
+      text += para;
+
+   text_layout layout{font_descr{"Open Sans", 14}, text};
+   layout.flow(1000);
+   REQUIRE(layout.num_lines() == 5000);
+
+   float prev_y = -1;
+   for (std::size_t i = 0; i < text.size(); i += para.size() * 97)
+   {
+      auto p = layout.caret_point(i);
+      CHECK(p.x == 0);
+      CHECK(p.y > prev_y);
+      CHECK(layout.caret_index(p) == i);
+      prev_y = p.y;
+   }
+}